@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Append-only table mapping application names to small integer IDs.
+// Interning is rare (only on foreground changes) and takes a mutex; looking
+// up a name by ID is lock-free because slots are never modified once the
+// count that covers them has been published.
+class AppInternTable {
+private:
+    static const size_t MAX_APPS = 4096;
+
+    std::unique_ptr<std::string[]> names;
+    std::atomic<uint32_t> count;
+    std::unordered_map<std::string, uint16_t> ids;
+    std::mutex internMutex;
+
+public:
+    static const uint16_t UNKNOWN_APP_ID = 0;
+
+    AppInternTable() :
+        names(new std::string[MAX_APPS]),
+        count(1) {
+        names[UNKNOWN_APP_ID] = "Unknown";
+        ids[names[UNKNOWN_APP_ID]] = UNKNOWN_APP_ID;
+    }
+
+    AppInternTable(const AppInternTable&) = delete;
+    AppInternTable& operator=(const AppInternTable&) = delete;
+
+    // Returns the existing ID for name, or assigns the next free one.
+    // Once the table is full new names map to UNKNOWN_APP_ID.
+    uint16_t intern(const std::string& name) {
+        std::lock_guard<std::mutex> lock(internMutex);
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+
+        uint32_t next = count.load(std::memory_order_relaxed);
+        if (next >= MAX_APPS) return UNKNOWN_APP_ID;
+
+        names[next] = name;
+        count.store(next + 1, std::memory_order_release);
+        ids[name] = static_cast<uint16_t>(next);
+        return static_cast<uint16_t>(next);
+    }
+
+    // Safe from any thread for IDs returned by intern()
+    const std::string& name(uint16_t id) const {
+        if (id >= count.load(std::memory_order_acquire)) return names[UNKNOWN_APP_ID];
+        return names[id];
+    }
+
+    size_t size() const {
+        return count.load(std::memory_order_acquire);
+    }
+};
@@ -0,0 +1,1729 @@
+#pragma once
+
+#include <winsock2.h>  // Before windows.h, see NetworkSink.h
+#include <windows.h>
+#include <psapi.h>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <iomanip>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <limits>
+#include <cstring>
+#include <unordered_map>
+
+#include "BehavioralEvent.h"
+#include "AppInternTable.h"
+#include "EventHistory.h"
+#include "CsvFormat.h"
+#include "BinaryLog.h"
+#include "EventJournal.h"
+#include "LogRotation.h"
+#include "FileOutput.h"
+#include "CaptureIndex.h"
+#include "EventSink.h"
+#include "NetworkSink.h"
+#include "SinkPipeline.h"
+#include "ProcessCounter.h"
+#include "CaptureTelemetry.h"
+#include "ColumnarStats.h"
+#include "RawInputReader.h"
+#include "HookThread.h"
+#include "DisplayGeometry.h"
+#include "IdleMonitor.h"
+#include "MouseDecimator.h"
+#include "WheelCoalescer.h"
+#include "MouseKinematics.h"
+#include "FeatureExtractor.h"
+#include "SpscRing.h"
+#include "CaptureOptions.h"
+#include "CaptureProfile.h"
+
+#pragma comment(lib, "psapi.lib")
+
+// Point-in-time view returned by BehavioralCapture::getLiveStatistics()
+struct LiveStatistics {
+    unsigned long long recordedEvents = 0;
+    unsigned long long recordedByType[EVENT_TYPE_COUNT] = {};
+    unsigned long long droppedRecords = 0;  // Ring full
+    unsigned long long queueDepth = 0;
+    unsigned long long keptMoves = 0;
+    unsigned long long droppedMoves = 0;
+    unsigned long long firstRecentSequence = 0;  // Sequence number of recentEvents[0] since start()
+    std::vector<BehavioralEvent> recentEvents;   // Oldest first
+};
+
+// Buffered writer for performance optimization
+class BufferedWriter : public EventSink {
+private:
+    FileOutput file;
+    CsvBlock buffer;  // Rows are formatted in place, reused across flushes
+    std::mutex bufferMutex;
+    LatencyHistogram* flushTimes;
+    QpcClock clock;
+    IndexOptions indexOptions;
+    CaptureIndexWriter index;
+    size_t flushRows;  // Rows per write
+    const MonitorTableSource* monitors;
+
+public:
+    BufferedWriter() : flushTimes(nullptr), flushRows(100), monitors(nullptr) {}
+
+    // Optional: records the duration of every batch flush
+    void setFlushHistogram(LatencyHistogram* histogram) {
+        flushTimes = histogram;
+    }
+
+    // Optional: sparse time index next to the log, applies from the next open()
+    void setIndexOptions(const IndexOptions& options) {
+        indexOptions = options;
+    }
+
+    void setFlushRows(size_t rows) {
+        flushRows = rows > 0 ? rows : 1;
+    }
+
+    // Optional: fills the normalized and mm/s columns
+    void setMonitorSource(const MonitorTableSource* source) {
+        monitors = source;
+    }
+
+    bool open(const std::string& filename, WriterBackend writerBackend = WRITER_BACKEND_STREAM,
+        const OverlappedWriterOptions& overlappedOptions = OverlappedWriterOptions()) {
+        if (!file.open(filename, writerBackend, overlappedOptions)) return false;
+
+        if (file.isEmpty()) {
+            buffer.appendLine(CSV_HEADER, strlen(CSV_HEADER));
+            flush();
+        }
+        if (indexOptions.enabled && !index.open(filename, indexOptions)) {
+            file.close();
+            return false;
+        }
+        return true;
+    }
+
+    void write(const BehavioralEvent& event, const std::string& appName) override {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        if (index.entryDue()) {
+            index.addEntry(event.timestamp, file.getOffset() + buffer.size(), event.appId, appName);
+        }
+        index.countRecords(1);
+        buffer.appendRow(event, appName, monitors ? monitors->getTable() : nullptr);
+
+        if (buffer.rowCount() >= flushRows) {
+            flush();
+        }
+    }
+
+    // One write and one stream flush per batch instead of one per line
+    void flush() {
+        if (file.isOpen() && !buffer.empty()) {
+            const long long started = QpcClock::now();
+            file.write(buffer.bytes(), buffer.size());
+            buffer.clear();
+            file.flushBatch();
+            index.flush();
+            if (flushTimes) flushTimes->record(clock.toNs(QpcClock::now() - started));
+        }
+    }
+
+    void flushIfDue() override {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        file.flushIfDue();
+    }
+
+    void flushAll() override {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        flush();
+        file.flush();
+    }
+
+    void close() override {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        flush();
+        file.close();
+        index.close();
+    }
+
+    unsigned long long getBytesWritten() const override {
+        return file.getBytesWritten();
+    }
+};
+
+class BehavioralCapture : private RawInputSink {
+private:
+    EventHistory<BehavioralEvent> events;
+    std::atomic<unsigned long long> recordedEvents;  // Events passed to the writer, written by addEvent() only
+    std::atomic<unsigned long long> recordedByType[EVENT_TYPE_COUNT];  // Same, per EventType
+    HookThread hookThread;
+    DisplayGeometry displayGeometry;  // Monitor table read by the input path and the writers
+    BufferedWriter dataWriter;
+    BinaryLogWriter binaryWriter;
+    JournalWriter journalWriter;
+    NetworkSink networkSink;
+    SessionRingWriter sessionRing;  // Agent mode only
+    EventSink* eventLog;  // The writer of options.logFormat, null without an event log
+    std::string logFilename;
+    LogRotator rotator;  // Thread of the event log's pipeline lane only
+
+    // Pipeline lane of the event log: rotation around the format's writer
+    class EventLogSink : public EventSink {
+    private:
+        BehavioralCapture& capture;
+
+    public:
+        explicit EventLogSink(BehavioralCapture& owner) : capture(owner) {}
+
+        void write(const BehavioralEvent& event, const std::string& appName) override {
+            capture.writeEventLog(event, appName);
+        }
+
+        void flushIfDue() override {
+            capture.eventLog->flushIfDue();
+        }
+
+        void flushAll() override {
+            capture.eventLog->flushAll();
+        }
+
+        void close() override {
+            capture.eventLog->close();
+        }
+
+        unsigned long long getBytesWritten() const override {
+            return capture.getBytesWritten();
+        }
+    };
+    EventLogSink eventLogSink;
+    SinkPipeline pipeline;  // Everything addEvent() feeds, set up by start()
+    long long lastEventTime;
+    POINT lastMousePos;
+
+    // Cached context info to reduce system calls.
+    // Published as plain atomics so the hook path never takes a lock.
+    AppInternTable appNames;
+    ProcessCounter processCounter;  // Context thread only
+    std::atomic<uint16_t> cachedAppId;
+    std::atomic<uint16_t> cachedBackgroundCount;
+    std::chrono::steady_clock::time_point lastContextUpdate;
+
+    // Foreground change notifications and the PID -> app ID cache they use.
+    // The WinEvent callback runs on the thread pumping the low-level hooks,
+    // so it only posts the window; the context thread opens the process and
+    // is the only user of the cache after start().
+    struct ProcessCacheEntry {
+        uint16_t appId;
+        std::chrono::steady_clock::time_point resolvedAt;
+    };
+    HWINEVENTHOOK foregroundHook;
+    std::atomic<HWND> pendingForeground;  // Posted by ForegroundEventProc, NULL once taken
+    std::unordered_map<DWORD, ProcessCacheEntry> processCache;
+    const int PROCESS_CACHE_TTL_MS = 60000;     // Re-resolve periodically in case a PID is reused
+    const size_t PROCESS_CACHE_MAX_ENTRIES = 1024;
+
+    // Key-state table, input thread only: down timestamp (0 = up), the
+    // last up, the flight time of the current press, the autorepeats since
+    // and the last down or repeat, indexed by virtual-key code. A held key
+    // repeats well within KEY_STALE_MS, so an entry that went quiet for
+    // longer lost its KEY_UP (focus moved to the secure desktop, a hook
+    // timeout) and is dropped rather than paired.
+    // Flight runs from the up of the key pressed just before to this key's
+    // down. When that key is still held (rollover), its up is still to come:
+    // the press waits in flightPending, linked from that key's nextKey, and
+    // gets the (negative) flight when the up arrives.
+    struct KeyState {
+        long long downAt;
+        long long upAt;
+        long long lastSeenAt;
+        int32_t flightTime;
+        uint16_t repeats;
+        int16_t nextKey;     // Key pressed next while this one was down, -1 for none
+        bool flightPending;
+    };
+    KeyState keyStates[256];
+    int lastPressedKey;  // -1 before the first key down
+    std::atomic<unsigned long long> autorepeatDowns;
+    std::atomic<unsigned long long> staleKeyStates;
+    const long long KEY_STALE_MS = 5000;  // Autorepeat delay is at most 1 s, the slowest repeat ~400 ms
+
+    // Mouse-move decimation, consumer thread only. setDecimation() hands a
+    // new configuration over through pendingDecimation.
+    MouseDecimator decimator;
+    std::mutex decimationMutex;
+    DecimationOptions pendingDecimation;
+    std::atomic<bool> decimationChanged;
+    WheelCoalescer wheelCoalescer;  // Consumer thread only, after the decimator
+
+    // Kinematics and streaming feature stages, consumer thread only. Both
+    // run before decimation, so they see every move; the kinematics stage
+    // works on whole drained blocks.
+    KinematicsStage kinematics;
+    FeatureExtractor featureExtractor;
+    FeatureCsvWriter featureWriter;
+    std::string featureFilename;
+    std::atomic<unsigned long long> featureRows;
+
+    // Idle state: entered by the context thread, left by the next input
+    IdleMonitor idleMonitor;
+
+    // Background thread for context updates
+    std::atomic<bool> contextThreadRunning;
+    std::thread contextThread;
+    std::mutex contextWakeMutex;
+    std::condition_variable contextWake;  // Foreground change posted, or stopping
+
+    // Ring buffer between the hook callbacks and the drainer thread
+    CaptureOptions options;
+    std::unique_ptr<SpscRing<BehavioralEvent>> eventRing;
+    std::atomic<bool> drainThreadRunning;
+    std::thread drainThread;
+    const size_t DRAIN_BATCH_SIZE = 256;  // Records popped per pass
+    // Sync mode has no drainer: the context thread releases what the stages
+    // hold back once their deadlines pass and runs the pipeline's timed
+    // flushes, under the lock the hook path takes to process a record inline
+    std::mutex syncStageMutex;
+    const int SYNC_STAGE_FLUSH_MS = 50;
+
+    // Telemetry: hook callback durations, flush durations and counters,
+    // published to shared memory and/or a stats line by telemetryThread
+    QpcClock qpc;
+    LatencyHistogram mouseHookTimes;     // Hook thread only
+    LatencyHistogram keyboardHookTimes;  // Hook thread only
+    LatencyHistogram flushTimes;         // Writer thread only
+    TelemetryPublisher telemetryPublisher;
+    std::atomic<bool> telemetryThreadRunning;
+    std::thread telemetryThread;
+
+    // Raw input backend state, reader thread only. Timing is kept in QPC
+    // microseconds; logged timestamps stay wall-clock milliseconds derived
+    // from one QPC/system_clock anchor, so they never step backwards.
+    RawInputReader rawInput;
+    long long qpcAnchorTicks;
+    long long wallAnchorMs;
+    long long lastRawEventUs;
+    struct RawRecord {
+        long long qpcTicks;
+        bool isKeyboard;
+        RAWMOUSE mouse;
+        RAWKEYBOARD keyboard;
+    };
+    std::vector<RawRecord> rawBatch;  // The current GetRawInputBuffer() read, emitted at its end
+    POINT rawCursor;                  // Cursor after the previous batch
+    bool rawCursorValid;              // GetCursorPos is called once per batch
+    LatencyHistogram rawBatchTimes;
+    const BehavioralEvent* replayRecord;  // Input thread: the record replayEvent() is feeding in
+    bool replayHasMove;                   // Input thread: replayMoveUs holds the previous replayed move
+    long long replayMoveUs;               // Its reconstructed time, us (see replayMoveTime())
+    long long replayMoveTimestamp;
+
+    static inline BehavioralCapture* instance = nullptr;
+
+    static long long getCurrentTimestamp() {
+        auto now = std::chrono::system_clock::now();
+        auto duration = now.time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    }
+
+    // Get the executable name of a process
+    std::string getProcessName(DWORD processId) {
+        HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, processId);
+        if (hProcess == NULL) return "Unknown";
+
+        char processName[MAX_PATH];
+        if (GetModuleBaseNameA(hProcess, NULL, processName, MAX_PATH) == 0) {
+            CloseHandle(hProcess);
+            return "Unknown";
+        }
+
+        CloseHandle(hProcess);
+        return std::string(processName);
+    }
+
+    // App ID of the process owning hwnd; only opens the process on a cache miss
+    uint16_t resolveAppId(HWND hwnd) {
+        if (hwnd == NULL) return AppInternTable::UNKNOWN_APP_ID;
+
+        DWORD processId = 0;
+        GetWindowThreadProcessId(hwnd, &processId);
+
+        auto now = std::chrono::steady_clock::now();
+        auto it = processCache.find(processId);
+        if (it != processCache.end() &&
+            now - it->second.resolvedAt < std::chrono::milliseconds(PROCESS_CACHE_TTL_MS)) {
+            return it->second.appId;
+        }
+
+        if (processCache.size() >= PROCESS_CACHE_MAX_ENTRIES) {
+            processCache.clear();
+        }
+        uint16_t appId = appNames.intern(getProcessName(processId));
+        processCache[processId] = { appId, now };
+        return appId;
+    }
+
+    static void CALLBACK ForegroundEventProc(HWINEVENTHOOK hook, DWORD eventId, HWND hwnd,
+        LONG idObject, LONG idChild, DWORD eventThread, DWORD eventTime) {
+        if (instance && eventId == EVENT_SYSTEM_FOREGROUND && hwnd != NULL) {
+            instance->pendingForeground.store(hwnd, std::memory_order_release);
+            instance->wakeContextThread();
+        }
+    }
+
+    void wakeContextThread() {
+        { std::lock_guard<std::mutex> lock(contextWakeMutex); }
+        contextWake.notify_all();
+    }
+
+    // Subscribes to foreground changes; falls back to polling if that fails
+    void startForegroundTracking() {
+        if (options.foregroundTracking != FOREGROUND_TRACKING_EVENTS || options.recordedTime) return;
+
+        foregroundHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, NULL,
+            ForegroundEventProc, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+        if (foregroundHook == NULL) {
+            std::cerr << "Failed to install foreground event hook, falling back to polling." << std::endl;
+            options.foregroundTracking = FOREGROUND_TRACKING_POLL;
+            return;
+        }
+        cachedAppId.store(resolveAppId(GetForegroundWindow()), std::memory_order_relaxed);
+    }
+
+    // Must run on the thread that called startForegroundTracking()
+    void stopForegroundTracking() {
+        if (foregroundHook) {
+            UnhookWinEvent(foregroundHook);
+            foregroundHook = NULL;
+        }
+    }
+
+    // Count running processes (background applications)
+    int countBackgroundProcesses() {
+        return processCounter.count();
+    }
+
+    long long qpcToMicroseconds(long long qpcTicks) const {
+        return static_cast<long long>(qpc.toNs(qpcTicks - qpcAnchorTicks) / 1000);
+    }
+
+    // Background thread to update context information periodically
+    void contextUpdateThread() {
+        auto nextUpdate = std::chrono::steady_clock::now();
+        auto nextStageFlush = nextUpdate;
+        const bool flushStages = flushesStagesOnContextThread();
+        while (contextThreadRunning) {
+            if (idleMonitor.poll(getCurrentTimestamp())) {
+                // Nothing to track while away; the first input wakes this
+                // thread and the cache is refreshed straight away
+                if (flushStages) suspendSyncOutputs();
+                idleMonitor.waitWhileIdle(contextThreadRunning);
+                if (flushStages) resumeSyncOutputs();
+                nextUpdate = std::chrono::steady_clock::now();
+                continue;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (HWND foreground = pendingForeground.exchange(NULL, std::memory_order_acquire)) {
+                cachedAppId.store(resolveAppId(foreground), std::memory_order_relaxed);
+            }
+            // A replay carries the recorded context; sampling the host's
+            // foreground window would also intern its apps and shift the
+            // IDs replayEvent() assigns
+            if (now >= nextUpdate) {
+                if (!options.recordedTime) {
+                    if (options.foregroundTracking == FOREGROUND_TRACKING_POLL) {
+                        cachedAppId.store(resolveAppId(GetForegroundWindow()), std::memory_order_relaxed);
+                    }
+                    cachedBackgroundCount.store(clampToUint16(countBackgroundProcesses()), std::memory_order_relaxed);
+                }
+                lastContextUpdate = now;
+                nextUpdate = now + std::chrono::milliseconds(options.contextUpdateIntervalMs);
+            }
+            if (flushStages && now >= nextStageFlush) {
+                flushSyncStages();
+                nextStageFlush = now + std::chrono::milliseconds(SYNC_STAGE_FLUSH_MS);
+            }
+
+            // Until the next update, a foreground change or stop()
+            const auto wakeAt = flushStages ? (std::min)(nextUpdate, nextStageFlush) : nextUpdate;
+            std::unique_lock<std::mutex> lock(contextWakeMutex);
+            contextWake.wait_until(lock, wakeAt, [this] {
+                return !contextThreadRunning || pendingForeground.load(std::memory_order_relaxed) != NULL;
+            });
+        }
+    }
+
+    // moveTimeUs of a replayed move, which is only recorded to the ms: the
+    // step from the previous move is timed so the kinematics stage measures
+    // the recorded speed again, kept within the recorded ms of the two
+    // timestamps. Moves recorded with speed 0 (the first of a capture, or a
+    // speed that was not stored) are timed from the timestamps alone.
+    uint32_t replayMoveTime(const BehavioralEvent& recorded) {
+        const long long elapsedMs = recorded.timestamp - replayMoveTimestamp;
+        long long stepUs = elapsedMs * 1000;
+        if (replayHasMove && recorded.mouseSpeed > 0.0f && elapsedMs >= 0 && elapsedMs <= 1000) {
+            const double dx = static_cast<double>(recorded.x) - lastMousePos.x;
+            const double dy = static_cast<double>(recorded.y) - lastMousePos.y;
+            const long long fromSpeed = std::llround(std::sqrt(dx * dx + dy * dy) * 1000000.0 / recorded.mouseSpeed);
+            stepUs = (std::max)((std::max)(elapsedMs - 1, 0LL) * 1000 + 1, (std::min)(fromSpeed, (elapsedMs + 1) * 1000 - 1));
+        }
+        replayMoveUs = replayHasMove ? replayMoveUs + stepUs : recorded.timestamp * 1000;
+        replayHasMove = true;
+        replayMoveTimestamp = recorded.timestamp;
+        return static_cast<uint32_t>(replayMoveUs);
+    }
+
+    // Get cached context info (thread-safe, lock-free)
+    void getCachedContext(BehavioralEvent& event) {
+        if (replayRecord) {
+            event.appId = replayRecord->appId;
+            event.backgroundAppCount = replayRecord->backgroundAppCount;
+            return;
+        }
+        event.appId = cachedAppId.load(std::memory_order_relaxed);
+        event.backgroundAppCount = cachedBackgroundCount.load(std::memory_order_relaxed);
+    }
+
+    static uint16_t clampToUint16(long long value) {
+        if (value < 0) return 0;
+        if (value > (std::numeric_limits<uint16_t>::max)()) return (std::numeric_limits<uint16_t>::max)();
+        return static_cast<uint16_t>(value);
+    }
+
+    static uint32_t clampToUint32(long long value) {
+        if (value < 0) return 0;
+        if (value > (std::numeric_limits<uint32_t>::max)()) return (std::numeric_limits<uint32_t>::max)();
+        return static_cast<uint32_t>(value);
+    }
+
+    // Drainer thread: the only consumer of eventRing, does all formatting and I/O
+    void drainThreadProc() {
+        std::vector<BehavioralEvent> batch(DRAIN_BATCH_SIZE);
+        while (drainThreadRunning) {
+            if (drainRing(batch) == 0) {
+                if (!options.recordedTime) flushIdleStages(getCurrentTimestamp());
+                flushWritersIfDue();
+                // An open feature window is left to flushIdleStages() to close on time
+                if (idleMonitor.isIdle() && !featureExtractor.hasOpenWindow()) {
+                    suspendUntilInput();
+                    continue;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(options.drainIntervalMs));
+            }
+        }
+
+        // Hooks are already removed at this point, empty whatever is left
+        while (drainRing(batch) > 0) {}
+        flushPendingStages();
+    }
+
+    // Drainer, once the capture is idle: writes out everything held back or
+    // buffered, then sleeps (with the sink lanes) until the next input
+    void suspendUntilInput() {
+        flushPendingStages();
+        pipeline.suspend();
+        idleMonitor.waitWhileIdle(drainThreadRunning, [this] { return eventRing->size() != 0; });
+        pipeline.resume();
+    }
+
+    // Lets a time-based durability policy submit partial blocks while idle
+    void flushWritersIfDue() {
+        pipeline.flushIfDue();
+    }
+
+    size_t drainRing(std::vector<BehavioralEvent>& batch) {
+        size_t count = eventRing->popBatch(batch.data(), batch.size());
+        if (count == 0) return 0;
+        kinematics.process(batch.data(), count);
+        for (size_t i = 0; i < count; i++) {
+            consumeEvent(batch[i], kinematics.sampleFor(i));
+        }
+        return count;
+    }
+
+    static LRESULT CALLBACK MouseHookProc(int nCode, WPARAM wParam, LPARAM lParam) {
+        if (nCode >= 0 && instance) {
+            const long long started = QpcClock::now();
+            instance->processMouseEvent(wParam, lParam);
+            instance->mouseHookTimes.record(instance->qpc.toNs(QpcClock::now() - started));
+        }
+        return CallNextHookEx(instance->hookThread.getMouseHook(), nCode, wParam, lParam);
+    }
+
+    static LRESULT CALLBACK KeyboardHookProc(int nCode, WPARAM wParam, LPARAM lParam) {
+        if (nCode >= 0 && instance) {
+            const long long started = QpcClock::now();
+            instance->processKeyboardEvent(wParam, lParam);
+            instance->keyboardHookTimes.record(instance->qpc.toNs(QpcClock::now() - started));
+        }
+        return CallNextHookEx(instance->hookThread.getKeyboardHook(), nCode, wParam, lParam);
+    }
+
+    void processMouseEvent(WPARAM wParam, LPARAM lParam) {
+        MSLLHOOKSTRUCT* mouseStruct = (MSLLHOOKSTRUCT*)lParam;
+        BehavioralEvent event;
+        event.timestamp = replayRecord ? replayRecord->timestamp : getCurrentTimestamp();
+        event.timeSinceLast = clampToUint32(event.timestamp - lastEventTime);
+        event.x = mouseStruct->pt.x;
+        event.y = mouseStruct->pt.y;
+        event.monitor = replayRecord ? replayRecord->monitor : displayGeometry.monitorAt(event.x, event.y);
+        event.wheelDelta = 0;
+
+        // Get cached context
+        getCachedContext(event);
+
+        switch (wParam) {
+        case WM_MOUSEMOVE:
+            // Every move is submitted, the decimation stage decides what is stored.
+            // Consecutive moves are often <1 ms apart, so the kinematics stage
+            // measures speed over QPC time stamped here.
+            if (mouseStruct->pt.x != lastMousePos.x || mouseStruct->pt.y != lastMousePos.y) {
+                event.type = MOUSE_MOVE;
+                event.moveTimeUs = replayRecord ? replayMoveTime(*replayRecord)
+                    : static_cast<uint32_t>(qpcToMicroseconds(QpcClock::now()));
+                lastMousePos = mouseStruct->pt;
+                submitEvent(event);
+            }
+            break;
+
+        case WM_LBUTTONDOWN:
+            event.type = MOUSE_LEFT_DOWN;
+            event.mouseSpeed = 0.0f;
+            submitEvent(event);
+            break;
+
+        case WM_LBUTTONUP:
+            event.type = MOUSE_LEFT_UP;
+            event.mouseSpeed = 0.0f;
+            submitEvent(event);
+            break;
+
+        case WM_RBUTTONDOWN:
+            event.type = MOUSE_RIGHT_DOWN;
+            event.mouseSpeed = 0.0f;
+            submitEvent(event);
+            break;
+
+        case WM_RBUTTONUP:
+            event.type = MOUSE_RIGHT_UP;
+            event.mouseSpeed = 0.0f;
+            submitEvent(event);
+            break;
+
+        case WM_MOUSEWHEEL:
+            event.type = MOUSE_WHEEL;
+            event.wheelDelta = GET_WHEEL_DELTA_WPARAM(mouseStruct->mouseData);
+            event.mouseSpeed = 0.0f;
+            submitEvent(event);
+            break;
+        }
+    }
+
+    void processKeyboardEvent(WPARAM wParam, LPARAM lParam) {
+        KBDLLHOOKSTRUCT* keyStruct = (KBDLLHOOKSTRUCT*)lParam;
+        BehavioralEvent event;
+        event.timestamp = replayRecord ? replayRecord->timestamp : getCurrentTimestamp();
+        event.timeSinceLast = clampToUint32(event.timestamp - lastEventTime);
+        event.x = 0;
+        event.y = 0;
+        event.keyCode = static_cast<uint8_t>(keyStruct->vkCode);
+        event.wheelDelta = 0;
+        event.mouseSpeed = 0.0f;
+
+        // Get cached context
+        getCachedContext(event);
+
+        if (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN) {
+            event.type = KEY_DOWN;
+        }
+        else if (wParam == WM_KEYUP || wParam == WM_SYSKEYUP) {
+            event.type = KEY_UP;
+        }
+        else {
+            return;
+        }
+
+        if (event.type == KEY_DOWN) checkQuitKey(event.keyCode);
+        if (pairKeyEvent(event)) submitEvent(event);
+    }
+
+    // Input thread: lets the owner's message loop end on the quit key
+    void checkQuitKey(uint8_t keyCode) {
+        if (options.quitKey != 0 && keyCode == options.quitKey && options.quitThreadId != 0) {
+            PostThreadMessageA(options.quitThreadId, WM_QUIT, 0, 0);
+        }
+    }
+
+    static int32_t clampToInt32(long long value) {
+        if (value <= (std::numeric_limits<int32_t>::min)()) return (std::numeric_limits<int32_t>::min)() + 1;
+        if (value > (std::numeric_limits<int32_t>::max)()) return (std::numeric_limits<int32_t>::max)();
+        return static_cast<int32_t>(value);
+    }
+
+    // Input thread: O(1) pairing of key downs and ups through keyStates.
+    // A KEY_UP gets its dwell and flight time; a KEY_DOWN for a key that is
+    // already down is autorepeat and returns false: it is only counted, and
+    // the run ends up as the repeatCount of the key's KEY_UP. A key released
+    // while the key pressed before it is still held has no flight
+    // (KEY_TIMING_NONE), that key's up is not known yet.
+    bool pairKeyEvent(BehavioralEvent& event) {
+        KeyState& key = keyStates[event.keyCode];
+        // Replayed repeats all carry their KEY_UP's timestamp, so a replay has no stale entries
+        if (key.downAt != 0 && !replayRecord && event.timestamp - key.lastSeenAt > KEY_STALE_MS) {
+            key.downAt = 0;
+            key.repeats = 0;
+            key.nextKey = -1;
+            key.flightPending = false;
+            staleKeyStates.store(staleKeyStates.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        if (event.type == KEY_DOWN) {
+            if (key.downAt != 0) {
+                key.lastSeenAt = event.timestamp;
+                if (key.repeats < (std::numeric_limits<uint16_t>::max)()) key.repeats++;
+                autorepeatDowns.store(autorepeatDowns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+            key.downAt = event.timestamp;
+            key.lastSeenAt = event.timestamp;
+            key.repeats = 0;
+            key.nextKey = -1;
+            key.flightTime = KEY_TIMING_NONE;
+            key.flightPending = false;
+            if (lastPressedKey >= 0) {
+                KeyState& previous = keyStates[lastPressedKey];
+                if (previous.downAt != 0) {
+                    previous.nextKey = static_cast<int16_t>(event.keyCode);
+                    key.flightPending = true;
+                }
+                else if (previous.upAt != 0) {
+                    key.flightTime = clampToInt32(event.timestamp - previous.upAt);
+                }
+            }
+            lastPressedKey = event.keyCode;
+            return true;
+        }
+
+        if (key.downAt != 0) {
+            event.dwellTime = clampToInt32(event.timestamp - key.downAt);
+            event.flightTime = key.flightPending ? KEY_TIMING_NONE : key.flightTime;
+        }
+        else {
+            // Pressed before the capture started, or its down went stale
+            event.dwellTime = KEY_TIMING_NONE;
+            event.flightTime = KEY_TIMING_NONE;
+        }
+        if (key.nextKey >= 0) {
+            // The key pressed next went down before this up: negative flight
+            KeyState& next = keyStates[key.nextKey];
+            if (next.downAt != 0 && next.flightPending) {
+                next.flightTime = clampToInt32(next.downAt - event.timestamp);
+                next.flightPending = false;
+            }
+        }
+        event.repeatCount = key.repeats;
+        key.repeats = 0;
+        key.downAt = 0;
+        key.upAt = event.timestamp;
+        key.nextKey = -1;
+        key.flightPending = false;
+        return true;
+    }
+
+    // Hook thread: hand the record to the drainer, or process it inline in sync mode
+    void submitEvent(const BehavioralEvent& event) {
+        lastEventTime = event.timestamp;
+
+        if (options.mode == CAPTURE_MODE_RING) {
+            eventRing->tryPush(event);  // Full ring drops the record, never blocks
+            idleMonitor.onInput(event.timestamp);  // After the push, see IdleMonitor
+        }
+        else {
+            idleMonitor.onInput(event.timestamp);
+            std::lock_guard<std::mutex> lock(syncStageMutex);
+            BehavioralEvent block = event;
+            kinematics.process(&block, 1);
+            consumeEvent(block, kinematics.sampleFor(0));
+        }
+    }
+
+    // Whether the context thread runs the idle pass the drainer runs in ring mode
+    bool flushesStagesOnContextThread() const {
+        return options.mode == CAPTURE_MODE_SYNC && !options.recordedTime;
+    }
+
+    // Context thread, sync mode: a held move or an open wheel burst is
+    // written once its deadline passes, not when the next input arrives
+    void flushSyncStages() {
+        std::lock_guard<std::mutex> lock(syncStageMutex);
+        flushIdleStages(getCurrentTimestamp());
+        flushWritersIfDue();
+    }
+
+    // Context thread, sync mode, going idle: the last input before a pause
+    // is written out, not left in a partial batch, and the sink lanes sleep
+    void suspendSyncOutputs() {
+        std::lock_guard<std::mutex> lock(syncStageMutex);
+        flushIdleStages(getCurrentTimestamp());
+        pipeline.suspend();
+    }
+
+    void resumeSyncOutputs() {
+        std::lock_guard<std::mutex> lock(syncStageMutex);
+        pipeline.resume();
+    }
+
+    // Consumer thread: feature and decimation stages in front of addEvent(),
+    // after the kinematics stage has filled in the block's speeds
+    void consumeEvent(const BehavioralEvent& event, const KinematicSample* motion) {
+        if (options.recordedTime) {
+            // Replay: what the idle pass would have released before this record arrived
+            flushIdleStages(event.timestamp);
+        }
+        if (featureExtractor.isEnabled()) {
+            featureExtractor.add(event, motion, [this](const FeatureVector& row) { writeFeatureRow(row); });
+            featureWriter.flush();  // No-op unless the record closed a window
+        }
+
+        if (decimationChanged.load(std::memory_order_acquire)) {
+            applyPendingDecimation();
+        }
+        decimator.process(event, [this](const BehavioralEvent& kept) { coalesceWheel(kept); });
+    }
+
+    void coalesceWheel(const BehavioralEvent& event) {
+        wheelCoalescer.process(event, [this](const BehavioralEvent& merged) { addEvent(merged); });
+    }
+
+    void writeFeatureRow(const FeatureVector& row) {
+        featureWriter.write(row, appNames.name(row.appId));
+        featureRows.store(featureRows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Drainer idle pass: releases held-back moves and closes an elapsed window
+    void flushIdleStages(long long nowMs) {
+        decimator.flushIdle(nowMs, [this](const BehavioralEvent& kept) { coalesceWheel(kept); });
+        wheelCoalescer.flushIdle(nowMs, [this](const BehavioralEvent& merged) { addEvent(merged); });
+        if (featureExtractor.isEnabled()) {
+            featureExtractor.flushIdle(nowMs, [this](const FeatureVector& row) { writeFeatureRow(row); });
+            featureWriter.flush();
+        }
+    }
+
+    // End of capture: everything still held by a stage is written out
+    void flushPendingStages() {
+        flushDecimator();
+        wheelCoalescer.flush([this](const BehavioralEvent& merged) { addEvent(merged); });
+        if (featureExtractor.isEnabled()) {
+            featureExtractor.flush([this](const FeatureVector& row) { writeFeatureRow(row); });
+            featureWriter.flush();
+        }
+    }
+
+    // Every output start() may have opened; each close is a no-op when closed
+    void closeOutputs() {
+        dataWriter.close();
+        binaryWriter.close();
+        journalWriter.close();
+        networkSink.close();
+        sessionRing.close();
+        featureWriter.close();
+        rotator.close();
+    }
+
+    // <name>.features.csv next to the event log
+    static std::string defaultFeatureFilename(const std::string& logFilename) {
+        const size_t slash = logFilename.find_last_of("\\/");
+        const size_t dot = logFilename.find_last_of('.');
+        const bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+        return (hasExtension ? logFilename.substr(0, dot) : logFilename) + ".features.csv";
+    }
+
+    void applyPendingDecimation() {
+        flushDecimator();  // Pending moves are decided by the policy that saw them
+        std::lock_guard<std::mutex> lock(decimationMutex);
+        decimator.configure(pendingDecimation);
+        decimationChanged.store(false, std::memory_order_relaxed);
+    }
+
+    void flushDecimator() {
+        decimator.flush([this](const BehavioralEvent& kept) { coalesceWheel(kept); });
+    }
+
+    BehavioralEvent makeRawEvent(EventType type, long long microseconds) {
+        BehavioralEvent event;
+        event.timestamp = wallAnchorMs + microseconds / 1000;
+        event.timeSinceLast = clampToUint32((microseconds - lastRawEventUs) / 1000);
+        event.x = 0;
+        event.y = 0;
+        event.keyCode = 0;
+        event.wheelDelta = 0;
+        event.mouseSpeed = 0.0f;
+        event.type = static_cast<uint8_t>(type);
+        getCachedContext(event);
+        return event;
+    }
+
+    void submitRawEvent(const BehavioralEvent& event, long long microseconds) {
+        lastRawEventUs = microseconds;
+        submitEvent(event);
+    }
+
+    // A MOUSE_MOVE at pos, stamped with the record's QPC time, which the
+    // kinematics stage measures its speed over
+    void submitRawMove(const POINT& pos, long long qpcTicks) {
+        if (pos.x == lastMousePos.x && pos.y == lastMousePos.y) return;
+
+        const long long microseconds = qpcToMicroseconds(qpcTicks);
+        BehavioralEvent event = makeRawEvent(MOUSE_MOVE, microseconds);
+        event.x = pos.x;
+        event.y = pos.y;
+        event.monitor = displayGeometry.monitorAt(pos.x, pos.y);
+        event.moveTimeUs = static_cast<uint32_t>(microseconds);
+        lastMousePos = pos;
+        submitRawEvent(event, microseconds);
+    }
+
+    void submitRawMouseButton(EventType type, const POINT& pos, long long qpcTicks, int wheelDelta = 0) {
+        const long long microseconds = qpcToMicroseconds(qpcTicks);
+        BehavioralEvent event = makeRawEvent(type, microseconds);
+        event.x = pos.x;
+        event.y = pos.y;
+        event.monitor = displayGeometry.monitorAt(pos.x, pos.y);
+        event.wheelDelta = static_cast<int16_t>(wheelDelta);
+        submitRawEvent(event, microseconds);
+    }
+
+    // Pixels per raw count on one axis of a batch: the cursor's displacement
+    // over the batch's summed motion, which folds in sensitivity and pointer
+    // acceleration. One to one where the two disagree (motion that cancels
+    // out, the cursor held at a screen edge).
+    static double rawAxisScale(long long pixels, long long counts) {
+        if (counts == 0) return 1.0;
+        const double scale = static_cast<double>(pixels) / static_cast<double>(counts);
+        return scale >= 0.125 && scale <= 16.0 ? scale : 1.0;
+    }
+
+    // Absolute motion (tablets, remote sessions): 0..65535 across the
+    // primary monitor or, with MOUSE_VIRTUAL_DESKTOP, the whole desktop
+    static POINT rawAbsolutePosition(const RAWMOUSE& mouse) {
+        const bool virtualDesktop = (mouse.usFlags & MOUSE_VIRTUAL_DESKTOP) != 0;
+        const long long left = virtualDesktop ? GetSystemMetrics(SM_XVIRTUALSCREEN) : 0;
+        const long long top = virtualDesktop ? GetSystemMetrics(SM_YVIRTUALSCREEN) : 0;
+        const long long width = GetSystemMetrics(virtualDesktop ? SM_CXVIRTUALSCREEN : SM_CXSCREEN);
+        const long long height = GetSystemMetrics(virtualDesktop ? SM_CYVIRTUALSCREEN : SM_CYSCREEN);
+        POINT pos;
+        pos.x = static_cast<LONG>(left + mouse.lLastX * width / 65536);
+        pos.y = static_cast<LONG>(top + mouse.lLastY * height / 65536);
+        return pos;
+    }
+
+    // Raw input reports generic VK_SHIFT/VK_CONTROL/VK_MENU; the hook path
+    // sees the left/right variants, so map them the same way
+    static UINT rawVirtualKey(const RAWKEYBOARD& keyboard) {
+        const bool extended = (keyboard.Flags & RI_KEY_E0) != 0;
+        switch (keyboard.VKey) {
+        case VK_SHIFT:
+            return MapVirtualKeyA(keyboard.MakeCode, MAPVK_VSC_TO_VK_EX);
+        case VK_CONTROL:
+            return extended ? VK_RCONTROL : VK_LCONTROL;
+        case VK_MENU:
+            return extended ? VK_RMENU : VK_LMENU;
+        default:
+            return keyboard.VKey;
+        }
+    }
+
+    void submitRawKey(const RAWKEYBOARD& keyboard, long long qpcTicks) {
+        if (keyboard.VKey == 0xFF) return;  // Fake key that is part of an escape sequence
+
+        const long long microseconds = qpcToMicroseconds(qpcTicks);
+        BehavioralEvent event = makeRawEvent(
+            (keyboard.Flags & RI_KEY_BREAK) ? KEY_UP : KEY_DOWN, microseconds);
+        event.keyCode = static_cast<uint8_t>(rawVirtualKey(keyboard));
+        if (event.type == KEY_DOWN) checkQuitKey(event.keyCode);
+        if (pairKeyEvent(event)) submitRawEvent(event, microseconds);
+    }
+
+    void onRawMouse(const RAWMOUSE& mouse, long long qpcTicks) override {
+        RawRecord record;
+        record.qpcTicks = qpcTicks;
+        record.isKeyboard = false;
+        record.mouse = mouse;
+        rawBatch.push_back(record);
+    }
+
+    void onRawKeyboard(const RAWKEYBOARD& keyboard, long long qpcTicks) override {
+        RawRecord record;
+        record.qpcTicks = qpcTicks;
+        record.isKeyboard = true;
+        record.keyboard = keyboard;
+        rawBatch.push_back(record);
+    }
+
+    // Emits the batch in order. Each relative record moves the cursor by
+    // its own counts, scaled so the batch ends where GetCursorPos() says
+    // the cursor is; every move gets its record's own time.
+    void onRawBatchEnd(long long qpcTicks) override {
+        POINT end;
+        if (!GetCursorPos(&end)) end = lastMousePos;
+        const POINT start = rawCursorValid ? rawCursor : end;
+
+        long long countsX = 0, countsY = 0;
+        for (const RawRecord& record : rawBatch) {
+            if (!record.isKeyboard && !(record.mouse.usFlags & MOUSE_MOVE_ABSOLUTE)) {
+                countsX += record.mouse.lLastX;
+                countsY += record.mouse.lLastY;
+            }
+        }
+        const double scaleX = rawAxisScale(end.x - start.x, countsX);
+        const double scaleY = rawAxisScale(end.y - start.y, countsY);
+
+        POINT pos = start;
+        long long movedX = 0, movedY = 0;
+        for (const RawRecord& record : rawBatch) {
+            if (record.isKeyboard) {
+                submitRawKey(record.keyboard, record.qpcTicks);
+                continue;
+            }
+            const RAWMOUSE& mouse = record.mouse;
+            if (mouse.usFlags & MOUSE_MOVE_ABSOLUTE) {
+                pos = rawAbsolutePosition(mouse);
+                submitRawMove(pos, record.qpcTicks);
+            }
+            else if (mouse.lLastX != 0 || mouse.lLastY != 0) {
+                movedX += mouse.lLastX;
+                movedY += mouse.lLastY;
+                pos.x = start.x + static_cast<LONG>(std::lround(movedX * scaleX));
+                pos.y = start.y + static_cast<LONG>(std::lround(movedY * scaleY));
+                submitRawMove(pos, record.qpcTicks);
+            }
+
+            // Motion first, then the button that followed it
+            const USHORT buttons = mouse.usButtonFlags;
+            if (buttons == 0) continue;
+            if (buttons & RI_MOUSE_LEFT_BUTTON_DOWN) submitRawMouseButton(MOUSE_LEFT_DOWN, pos, record.qpcTicks);
+            if (buttons & RI_MOUSE_LEFT_BUTTON_UP) submitRawMouseButton(MOUSE_LEFT_UP, pos, record.qpcTicks);
+            if (buttons & RI_MOUSE_RIGHT_BUTTON_DOWN) submitRawMouseButton(MOUSE_RIGHT_DOWN, pos, record.qpcTicks);
+            if (buttons & RI_MOUSE_RIGHT_BUTTON_UP) submitRawMouseButton(MOUSE_RIGHT_UP, pos, record.qpcTicks);
+            if (buttons & RI_MOUSE_WHEEL) {
+                submitRawMouseButton(MOUSE_WHEEL, pos, record.qpcTicks, static_cast<SHORT>(mouse.usButtonData));
+            }
+        }
+        rawBatch.clear();
+        rawCursor = end;
+        rawCursorValid = true;
+        rawBatchTimes.record(qpc.toNs(QpcClock::now() - qpcTicks));
+    }
+
+    void addEvent(const BehavioralEvent& event) {
+        // Store in memory (oldest event is overwritten once full)
+        events.push_back(event);
+        recordedEvents.store(recordedEvents.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (event.type < EVENT_TYPE_COUNT) {
+            std::atomic<unsigned long long>& typeCount = recordedByType[event.type];
+            typeCount.store(typeCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        if (!pipeline.hasSinks()) return;
+
+        // Hand over to the file and other sinks (non-blocking)
+        pipeline.push(event);
+    }
+
+    void writeEventLog(const BehavioralEvent& event, const std::string& appName) {
+        if (rotator.isEnabled() && rotator.isDue(event, getBytesWritten())) {
+            rotateEventLog();
+        }
+        eventLog->write(event, appName);
+        if (rotator.isEnabled()) rotator.track(event);
+    }
+
+    bool openEventLog() {
+        dataWriter.setIndexOptions(options.index);
+        dataWriter.setFlushRows(options.csvFlushRows);
+        binaryWriter.setIndexOptions(options.index);
+        binaryWriter.setBlockEvents(options.binaryBlockEvents);
+        if (options.logFormat == LOG_FORMAT_BINARY) {
+            eventLog = &binaryWriter;
+            return binaryWriter.open(logFilename, appNames, options.writerBackend, options.overlappedWriter);
+        }
+        if (options.logFormat == LOG_FORMAT_JOURNAL) {
+            eventLog = &journalWriter;
+            return journalWriter.open(logFilename, appNames, options.journal);
+        }
+        eventLog = &dataWriter;
+        return dataWriter.open(logFilename, options.writerBackend, options.overlappedWriter);
+    }
+
+    // Closes the active log, turns it into a segment and starts a fresh
+    // file (new CSV header, or .bclog header and dictionary)
+    void rotateEventLog() {
+        if (options.logFormat == LOG_FORMAT_BINARY) {
+            binaryWriter.close();
+        }
+        else {
+            dataWriter.close();
+        }
+        rotator.rotate(getBytesWritten());
+        if (!openEventLog()) {
+            std::cerr << "Failed to open file: " << logFilename << std::endl;
+        }
+    }
+
+public:
+    BehavioralCapture() :
+        recordedEvents(0),
+        eventLog(nullptr),
+        eventLogSink(*this),
+        foregroundHook(NULL),
+        pendingForeground(NULL),
+        lastEventTime(0),
+        lastPressedKey(-1),
+        autorepeatDowns(0),
+        staleKeyStates(0),
+        decimationChanged(false),
+        featureRows(0),
+        contextThreadRunning(false),
+        drainThreadRunning(false),
+        telemetryThreadRunning(false),
+        qpcAnchorTicks(0),
+        wallAnchorMs(0),
+        lastRawEventUs(0),
+        rawCursorValid(false),
+        replayRecord(nullptr),
+        replayHasMove(false),
+        replayMoveUs(0),
+        replayMoveTimestamp(0),
+        cachedAppId(AppInternTable::UNKNOWN_APP_ID),
+        cachedBackgroundCount(0) {
+        instance = this;
+        lastMousePos.x = 0;
+        lastMousePos.y = 0;
+        memset(keyStates, 0, sizeof(keyStates));
+        for (int i = 0; i < 256; i++) {
+            keyStates[i].nextKey = -1;
+        }
+        for (int i = 0; i < EVENT_TYPE_COUNT; i++) {
+            recordedByType[i] = 0;
+        }
+    }
+
+    ~BehavioralCapture() {
+        stop();
+    }
+
+    bool start(const std::string& filename = "behavioral_data.csv",
+        const CaptureOptions& captureOptions = CaptureOptions()) {
+        options = captureOptions;
+        logFilename = filename;
+        eventLog = nullptr;
+        dataWriter.setMonitorSource(&displayGeometry);
+        binaryWriter.setMonitorSource(&displayGeometry);
+        journalWriter.setMonitorSource(&displayGeometry);
+        networkSink.setMonitorSource(&displayGeometry);
+        sessionRing.setMonitorSource(&displayGeometry);
+        if (options.sessionRing.enabled) {
+            // CaptureService writes the log and counts processes for every session
+            options.writeEventLog = false;
+            options.processCountProvider = PROCESS_COUNT_NONE;
+        }
+        if (options.logFormat == LOG_FORMAT_JOURNAL && options.rotation.maxBytes > 0) {
+            // The journal rolls its own segments
+            options.journal.segmentSlots = options.rotation.maxBytes / JOURNAL_SLOT_BYTES;
+        }
+        if (options.writeEventLog) {
+            if (!openEventLog()) {
+                std::cerr << "Failed to open file: "
+                    << (options.logFormat == LOG_FORMAT_JOURNAL ? journalSegmentPath(filename, 0) : filename) << std::endl;
+                return false;
+            }
+        }
+        const bool rotate = options.writeEventLog && options.logFormat != LOG_FORMAT_JOURNAL;
+        if (!rotator.open(filename, rotate ? options.rotation : RotationOptions(), getBytesWritten())) {
+            std::cerr << "Failed to read manifest for: " << filename << std::endl;
+            closeOutputs();
+            return false;
+        }
+        if (options.network.isEnabled()) {
+            if (!networkSink.open(options.network, filename)) {
+                std::cerr << "Failed to open network spool for: " << filename << std::endl;
+                closeOutputs();
+                return false;
+            }
+        }
+        if (options.sessionRing.enabled && !sessionRing.open(options.sessionRing)) {
+            std::cerr << "Failed to open session ring: " << sessionRing.getError() << std::endl;
+            closeOutputs();
+            return false;
+        }
+
+        featureExtractor.configure(options.features);
+        kinematics.configure(options.features.kinematicsSampleMs, options.features.strokeGapMs,
+            featureExtractor.isEnabled());
+        if (featureExtractor.isEnabled()) {
+            featureFilename = options.featureFile.empty() ? defaultFeatureFilename(filename) : options.featureFile;
+            if (!featureWriter.open(featureFilename)) {
+                std::cerr << "Failed to open file: " << featureFilename << std::endl;
+                closeOutputs();
+                return false;
+            }
+        }
+        // Before the hooks, which look records up in the table
+        if (options.monitorGeometry && !displayGeometry.start()) {
+            std::cerr << "Failed to enumerate monitors, monitor columns will stay empty" << std::endl;
+            options.monitorGeometry = false;
+        }
+
+        pipeline.start(options.pipeline, appNames);
+        // A rotation closes, renames and reopens the log; in sync mode the
+        // consumer is the hook thread, so the log keeps a lane of its own
+        if (eventLog) pipeline.addSink(&eventLogSink, "event log", rotator.isEnabled() && options.mode == CAPTURE_MODE_SYNC);
+        if (options.network.isEnabled()) pipeline.addSink(&networkSink, "network");
+        if (sessionRing.isOpen()) pipeline.addSink(&sessionRing, "session ring");
+        events.reset(options.historyCapacity);
+        decimator.configure(options.decimation);
+        wheelCoalescer.configure(options.wheelCoalescing);
+        decimationChanged = false;
+        dataWriter.setFlushHistogram(&flushTimes);
+        binaryWriter.setFlushHistogram(&flushTimes);
+        journalWriter.setFlushHistogram(&flushTimes);
+
+        // Foreground tracking mode is settled before the context thread reads it
+        startForegroundTracking();
+
+        // Start context update thread
+        idleMonitor.start(options.idle);
+        options.processCountProvider = processCounter.init(options.processCountProvider);
+        contextThreadRunning = true;
+        contextThread = std::thread(&BehavioralCapture::contextUpdateThread, this);
+
+        // Start drainer thread before any hook can produce records
+        if (options.mode == CAPTURE_MODE_RING) {
+            eventRing.reset(new SpscRing<BehavioralEvent>(options.ringCapacity));
+            drainThreadRunning = true;
+            drainThread = std::thread(&BehavioralCapture::drainThreadProc, this);
+        }
+
+        startTelemetry();
+
+        qpcAnchorTicks = QpcClock::now();
+        wallAnchorMs = getCurrentTimestamp();
+        lastRawEventUs = 0;
+        rawBatch.clear();
+        rawBatch.reserve(256);
+        rawCursorValid = false;
+
+        // Install hooks (or start the raw input reader)
+        if (options.installHooks && !installInputHooks()) {
+            stopForegroundTracking();
+            stopWorkerThreads();
+            idleMonitor.stop();
+            pipeline.stop();
+            closeOutputs();
+            displayGeometry.stop();
+            return false;
+        }
+
+        lastEventTime = getCurrentTimestamp();
+
+        std::cout << "Behavioral capture started (optimized mode)." << std::endl;
+        if (options.mode == CAPTURE_MODE_RING) {
+            std::cout << "- Capture mode: lock-free ring (" << eventRing->getCapacity()
+                << " records), drainer thread does formatting and I/O" << std::endl;
+        }
+        else {
+            std::cout << "- Capture mode: synchronous (formatting and I/O on hook thread)" << std::endl;
+        }
+        if (options.inputBackend == INPUT_BACKEND_RAW_INPUT) {
+            std::cout << "- Input: Raw Input (buffered reads, QPC timing)" << std::endl;
+        }
+        else if (options.installHooks && hookThread.isDedicated()) {
+            std::cout << "- Input: low-level hooks on a dedicated thread (priority " << options.hookThread.priority
+                << (hookThread.isInMmcssTask() ? ", MMCSS task " + options.hookThread.mmcssTask : std::string())
+                << ")" << std::endl;
+        }
+        else {
+            std::cout << "- Input: low-level hooks" << std::endl;
+        }
+        if (options.monitorGeometry) {
+            std::cout << "- Monitor geometry: " << displayGeometry.describe()
+                << (displayGeometry.isWatching() ? ", refreshed on display changes" : ", not refreshed") << std::endl;
+        }
+        std::cout << "- Idle mode: " << idleMonitor.describe()
+            << (options.idle.sessionEvents && !idleMonitor.isWatchingSession() ? " (session events unavailable)" : "")
+            << (options.mode == CAPTURE_MODE_SYNC ? ", pauses context polling only (sync mode)" : "") << std::endl;
+        std::cout << "- Mouse movement decimation: " << decimator.describe() << std::endl;
+        std::cout << "- Wheel coalescing: " << wheelCoalescer.describe()
+            << ", key autorepeat runs folded into the key up" << std::endl;
+        std::cout << "- Context update interval: " << options.contextUpdateIntervalMs << "ms" << std::endl;
+        std::cout << "- Foreground tracking: "
+            << (options.foregroundTracking == FOREGROUND_TRACKING_EVENTS ? "WinEvent notifications" : "polling")
+            << std::endl;
+        std::cout << "- Process counting: "
+            << (options.processCountProvider == PROCESS_COUNT_NTQUERY ? "NtQuerySystemInformation"
+                : options.processCountProvider == PROCESS_COUNT_TOOLHELP ? "Toolhelp snapshot" : "off (done by the service)")
+            << std::endl;
+        if (telemetryPublisher.isOpen()) {
+            std::cout << "- Live telemetry: " << options.telemetrySharedMemoryName << " (every "
+                << options.telemetryIntervalMs << "ms)" << std::endl;
+        }
+        std::cout << "- In-memory history: last " << events.capacity() << " events" << std::endl;
+        if (featureExtractor.isEnabled()) {
+            std::cout << "- Feature extraction: " << options.features.windowMs << "ms windows per application -> "
+                << featureFilename << std::endl;
+        }
+        if (options.writeEventLog && options.logFormat == LOG_FORMAT_JOURNAL) {
+            std::cout << "- Memory-mapped journal (" << options.journal.segmentSlots << " records per segment"
+                << (options.journal.flushIntervalMs > 0 ? ", flushed every " + std::to_string(options.journal.flushIntervalMs) + "ms" : "")
+                << ")" << std::endl;
+            std::cout << "Data will be saved to: " << journalSegmentPath(filename, 0) << " and following segments" << std::endl;
+        }
+        else if (options.writeEventLog) {
+            std::cout << "- Buffered writing enabled ("
+                << (options.logFormat == LOG_FORMAT_BINARY ? "binary log" : "CSV") << ", "
+                << (options.writerBackend == WRITER_BACKEND_OVERLAPPED ? "overlapped I/O" : "stream I/O") << ")" << std::endl;
+            std::cout << "Data will be saved to: " << filename << std::endl;
+            if (rotator.isEnabled()) {
+                std::cout << "- Rotation:";
+                if (options.rotation.maxBytes > 0) std::cout << " every " << options.rotation.maxBytes / (1024 * 1024) << " MB";
+                if (options.rotation.intervalMinutes > 0) std::cout << " every " << options.rotation.intervalMinutes << " min";
+                std::cout << (options.rotation.compress ? ", closed segments compressed in the background" : "")
+                    << ", manifest " << rotator.getManifest().getPath() << std::endl;
+            }
+        }
+        else if (sessionRing.isOpen()) {
+            std::cout << "- Session agent: records go to CaptureService through " << sessionRing.getName()
+                << " (" << sessionRing.getCapacity() << " slots)" << std::endl;
+        }
+        else {
+            std::cout << "- Event log disabled, only features are written" << std::endl;
+        }
+        if (options.network.isEnabled()) {
+            std::cout << "- Streaming to " << options.network.host << ":" << options.network.port << " in batches of "
+                << options.network.batchEvents << " events, spooled locally while offline (up to "
+                << options.network.maxSpoolBytes / (1024 * 1024) << " MB)" << std::endl;
+        }
+        if (pipeline.hasSinks() && options.pipeline.enabled) {
+            std::cout << "- Sink pipeline: batches of " << options.pipeline.batchEvents << " events, "
+                << options.pipeline.queueBatches << " batches queued per sink, one writer thread per sink" << std::endl;
+        }
+        else if (pipeline.hasSinks()) {
+            std::cout << "- Sink pipeline: off, sinks are written on the consumer thread";
+            if (rotator.isEnabled() && options.mode == CAPTURE_MODE_SYNC) {
+                std::cout << " (the rotating event log keeps its writer thread, waited for when its queue is full)";
+            }
+            std::cout << std::endl;
+        }
+
+        return true;
+    }
+
+    bool installInputHooks() {
+        if (options.inputBackend == INPUT_BACKEND_RAW_INPUT) {
+            if (!rawInput.start(this)) {
+                std::cerr << "Failed to register raw input devices!" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        return hookThread.start(MouseHookProc, KeyboardHookProc, options.hookThread);
+    }
+
+    // Copies every live counter into the shared-memory block layout
+    void fillTelemetry(TelemetryBlock& block) {
+        block.updatedAtMs = static_cast<uint64_t>(getCurrentTimestamp());
+        block.mouseCallbacks = mouseHookTimes.getCount();
+        block.keyboardCallbacks = keyboardHookTimes.getCount();
+        block.mouseHookP50Ns = mouseHookTimes.percentile(0.50);
+        block.mouseHookP99Ns = mouseHookTimes.percentile(0.99);
+        block.mouseHookMaxNs = mouseHookTimes.getMax();
+        block.keyboardHookP50Ns = keyboardHookTimes.percentile(0.50);
+        block.keyboardHookP99Ns = keyboardHookTimes.percentile(0.99);
+        block.keyboardHookMaxNs = keyboardHookTimes.getMax();
+        block.sampledOutMoves = decimator.getDroppedMoves();
+        block.keptMoves = decimator.getKeptMoves();
+        block.recordedEvents = getRecordedEventCount();
+        block.droppedRecords = getDroppedRecordCount();
+        block.queueDepth = eventRing ? eventRing->size() : 0;
+        block.queueHighWater = getRingHighWaterMark();
+        block.flushCount = flushTimes.getCount();
+        block.flushP50Ns = flushTimes.percentile(0.50);
+        block.flushP99Ns = flushTimes.percentile(0.99);
+        block.flushMaxNs = flushTimes.getMax();
+        block.bytesWritten = getBytesWritten();
+        for (int i = 0; i < EVENT_TYPE_COUNT; i++) {
+            block.recordedByType[i] = recordedByType[i].load(std::memory_order_relaxed);
+        }
+        mouseHookTimes.copyBuckets(block.mouseHookBuckets);
+        keyboardHookTimes.copyBuckets(block.keyboardHookBuckets);
+        flushTimes.copyBuckets(block.flushBuckets);
+    }
+
+    void printStatsLine(const TelemetryBlock& block) {
+        std::cout << "[stats] events=" << block.recordedEvents
+            << " mouse_hook_p50/p99/max_us=" << block.mouseHookP50Ns / 1000.0 << "/"
+            << block.mouseHookP99Ns / 1000.0 << "/" << block.mouseHookMaxNs / 1000.0
+            << " key_hook_p50/p99/max_us=" << block.keyboardHookP50Ns / 1000.0 << "/"
+            << block.keyboardHookP99Ns / 1000.0 << "/" << block.keyboardHookMaxNs / 1000.0
+            << " moves_kept/dropped=" << block.keptMoves << "/" << block.sampledOutMoves
+            << " queue=" << block.queueDepth << "/" << block.queueHighWater
+            << " dropped=" << block.droppedRecords
+            << " flush_p99_us=" << block.flushP99Ns / 1000.0
+            << " bytes=" << block.bytesWritten << std::endl;
+    }
+
+    // Publishes telemetry every telemetryIntervalMs and prints a stats line
+    // every statsLineIntervalMs; sleeps in short steps so stop() is prompt.
+    // While idle it publishes once more and then sleeps until the next input.
+    void telemetryThreadProc() {
+        auto nextPublish = std::chrono::steady_clock::now();
+        auto nextStatsLine = nextPublish + std::chrono::milliseconds(options.statsLineIntervalMs);
+        TelemetryBlock snapshot;
+
+        while (telemetryThreadRunning) {
+            auto now = std::chrono::steady_clock::now();
+            if (telemetryPublisher.isOpen() && now >= nextPublish) {
+                telemetryPublisher.publish([this](TelemetryBlock& block) { fillTelemetry(block); });
+                nextPublish = now + std::chrono::milliseconds(options.telemetryIntervalMs);
+            }
+            if (options.statsLineIntervalMs > 0 && now >= nextStatsLine) {
+                fillTelemetry(snapshot);
+                printStatsLine(snapshot);
+                nextStatsLine = now + std::chrono::milliseconds(options.statsLineIntervalMs);
+            }
+            if (idleMonitor.isIdle()) {
+                // The counters stand still while idle: publish them once, then no wakeups
+                telemetryPublisher.publish([this](TelemetryBlock& block) { fillTelemetry(block); });
+                idleMonitor.waitWhileIdle(telemetryThreadRunning);
+                nextPublish = std::chrono::steady_clock::now();
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        // Final values for a scraper that reads after the capture stopped
+        telemetryPublisher.publish([this](TelemetryBlock& block) { fillTelemetry(block); });
+    }
+
+    void startTelemetry() {
+        if (!options.telemetrySharedMemoryName.empty() &&
+            !telemetryPublisher.open(options.telemetrySharedMemoryName)) {
+            if (telemetryPublisher.wasNameInUse()) {
+                std::cerr << "Telemetry shared memory " << options.telemetrySharedMemoryName
+                    << " is in use by another capture, live telemetry is off" << std::endl;
+            }
+            else {
+                std::cerr << "Failed to create telemetry shared memory: " << options.telemetrySharedMemoryName << std::endl;
+            }
+        }
+        if (telemetryPublisher.isOpen() || options.statsLineIntervalMs > 0) {
+            telemetryThreadRunning = true;
+            telemetryThread = std::thread(&BehavioralCapture::telemetryThreadProc, this);
+        }
+    }
+
+    // Joins the drainer (after it empties the ring) and the context thread
+    void stopWorkerThreads() {
+        if (drainThreadRunning) {
+            drainThreadRunning = false;
+            idleMonitor.wakeAll();
+            if (drainThread.joinable()) {
+                drainThread.join();
+            }
+        }
+
+        if (contextThreadRunning) {
+            contextThreadRunning = false;
+            idleMonitor.wakeAll();
+            wakeContextThread();
+            if (contextThread.joinable()) {
+                contextThread.join();
+            }
+        }
+
+        if (telemetryThreadRunning) {
+            telemetryThreadRunning = false;
+            idleMonitor.wakeAll();
+            if (telemetryThread.joinable()) {
+                telemetryThread.join();
+            }
+        }
+    }
+
+    void stop() {
+        hookThread.stop();
+        rawInput.stop();
+        stopForegroundTracking();
+
+        stopWorkerThreads();
+        idleMonitor.stop();
+        flushPendingStages();  // Sync mode leaves held-back records to stop()
+        pipeline.stop();  // Sinks write out their queues before they are closed
+
+        // Flush remaining data
+        closeOutputs();
+        displayGeometry.stop();  // After the writers, the last readers of its tables
+
+        std::cout << "Behavioral capture stopped." << std::endl;
+    }
+
+    void printStatistics() {
+        std::cout << "\n=== Capture Statistics ===" << std::endl;
+        std::cout << "Settings:\n" << describeCaptureSettings(options, "  ") << std::flush;
+        // Works from a concurrent snapshot, so it may also run while capturing
+        EventColumns columns;
+        const std::vector<BehavioralEvent> snapshot = getEventsSnapshot();
+        columns.assign(snapshot);
+        const ColumnStats stats = computeColumnStats(columns);
+
+        std::cout << "Total events captured: " << snapshot.size() << std::endl;
+
+        std::cout << "Mouse movements: " << stats.countByType[MOUSE_MOVE] << std::endl;
+        std::cout << "Mouse clicks: " << stats.countByType[MOUSE_LEFT_DOWN] + stats.countByType[MOUSE_RIGHT_DOWN] << std::endl;
+        std::cout << "Key presses: " << stats.countByType[KEY_DOWN] << std::endl;
+
+        if (stats.speedCount > 0) {
+            std::cout << "Average mouse speed: " << std::fixed << std::setprecision(2)
+                << stats.speedMean << " px/s (std " << std::sqrt(stats.speedVariance)
+                << ", min " << stats.speedMin << ", max " << stats.speedMax << ")" << std::endl;
+        }
+        std::cout << "Mouse distance traveled: " << std::fixed << std::setprecision(0)
+            << stats.distancePx << " px" << std::endl;
+        std::cout << "Statistics kernels: " << simdLevelName(detectSimdLevel()) << std::endl;
+
+        if (!snapshot.empty()) {
+            std::cout << "Last active application: " << appNames.name(snapshot.back().appId) << std::endl;
+            std::cout << "Background processes: " << snapshot.back().backgroundAppCount << std::endl;
+        }
+
+        if (eventRing) {
+            std::cout << "Ring buffer high-water mark: " << eventRing->getHighWaterMark()
+                << " / " << eventRing->getCapacity() << std::endl;
+            std::cout << "Dropped records (ring full): " << eventRing->getDroppedCount() << std::endl;
+        }
+
+        if (options.inputBackend == INPUT_BACKEND_RAW_INPUT) {
+            std::cout << "Raw input batches: " << rawInput.getBatchCount()
+                << " (" << rawInput.getRecordCount() << " records)" << std::endl;
+        }
+        std::cout << "Autorepeat key downs coalesced into key ups: " << autorepeatDowns.load() << std::endl;
+        if (staleKeyStates.load() > 0) {
+            std::cout << "Key downs dropped after a lost key up: " << staleKeyStates.load() << std::endl;
+        }
+        std::cout << "Wheel messages merged into bursts: " << wheelCoalescer.getMergedMessages()
+            << " (" << wheelCoalescer.getEmittedBursts() << " wheel records written)" << std::endl;
+        if (options.monitorGeometry) {
+            std::cout << "Display changes (monitor table rebuilds): " << displayGeometry.getDisplayChanges() << std::endl;
+        }
+        if (idleMonitor.isEnabled()) {
+            std::cout << "Idle periods: " << idleMonitor.getIdlePeriods() << " (" << idleMonitor.getIdleTotalMs() / 1000
+                << " s in total, " << idleMonitor.getSessionChanges() << " session lock/connect changes)" << std::endl;
+        }
+        if (kinematics.getBlocks() > 0) {
+            std::cout << "Mouse kinematics: " << kinematics.getMoves() << " moves in " << kinematics.getBlocks()
+                << " blocks (" << simdLevelName(kinematics.getSimdLevel()) << " kernels)" << std::endl;
+        }
+        std::cout << "Mouse moves kept / dropped by decimation: " << decimator.getKeptMoves()
+            << " / " << decimator.getDroppedMoves() << std::endl;
+        if (featureExtractor.isEnabled()) {
+            std::cout << "Feature rows written: " << featureRows.load() << std::endl;
+        }
+        std::cout << std::setprecision(1);
+        if (mouseHookTimes.getCount() > 0) {
+            std::cout << "Mouse hook latency: p50 " << mouseHookTimes.percentile(0.50) / 1000.0
+                << " us, p99 " << mouseHookTimes.percentile(0.99) / 1000.0
+                << " us, max " << mouseHookTimes.getMax() / 1000.0 << " us" << std::endl;
+        }
+        if (keyboardHookTimes.getCount() > 0) {
+            std::cout << "Keyboard hook latency: p50 " << keyboardHookTimes.percentile(0.50) / 1000.0
+                << " us, p99 " << keyboardHookTimes.percentile(0.99) / 1000.0
+                << " us, max " << keyboardHookTimes.getMax() / 1000.0 << " us" << std::endl;
+        }
+        if (rawBatchTimes.getCount() > 0) {
+            std::cout << "Raw input batch processing: p50 " << rawBatchTimes.percentile(0.50) / 1000.0
+                << " us, p99 " << rawBatchTimes.percentile(0.99) / 1000.0 << " us" << std::endl;
+        }
+        if (flushTimes.getCount() > 0) {
+            std::cout << "Writer flushes: " << flushTimes.getCount() << ", p99 "
+                << flushTimes.percentile(0.99) / 1000.0 << " us" << std::endl;
+        }
+        std::cout << "Bytes written: " << getBytesWritten() << std::endl;
+        if (options.logFormat == LOG_FORMAT_JOURNAL) {
+            std::cout << "Journal segments: " << journalWriter.getSegmentCount()
+                << ", events dropped: " << journalWriter.getDroppedEvents() << std::endl;
+        }
+        if (rotator.isEnabled()) {
+            std::cout << "Log segments rotated: " << rotator.getRotatedCount()
+                << ", compressed: " << rotator.getCompressedCount()
+                << " (" << rotator.getCompressionFailures() << " failed), manifest: "
+                << rotator.getManifest().getPath() << std::endl;
+        }
+        if (options.network.isEnabled()) {
+            std::cout << "Network: " << networkSink.getSentFrames() << " frames, "
+                << networkSink.getBytesWritten() << " bytes sent for " << networkSink.getEncodedBytes()
+                << " encoded, " << networkSink.getConnectCount() << " connections, "
+                << networkSink.getResentFrames() << " resent after reconnecting"
+                << (networkSink.isConnected() ? " (connected)" : "") << ", " << networkSink.getSpooledFrames()
+                << " spooled, " << networkSink.getDroppedFrames() << " dropped" << std::endl;
+        }
+        if (options.sessionRing.enabled) {
+            std::cout << "Session ring: " << sessionRing.getBytesWritten() << " bytes published, "
+                << sessionRing.getDroppedRecords() << " records dropped (ring full)" << std::endl;
+        }
+        for (const SinkLaneStats& lane : pipeline.getLaneStats()) {
+            std::cout << "Sink " << lane.name << ": " << lane.writtenEvents << " events written, "
+                << lane.droppedEvents << " dropped (" << lane.droppedBatches << " batches), queue "
+                << lane.queueDepth << "/" << options.pipeline.queueBatches << " (high water " << lane.queueHighWater
+                << "), max lag " << lane.maxLagNs / 1000000.0 << " ms" << std::endl;
+        }
+    }
+
+    size_t getRingHighWaterMark() const {
+        return eventRing ? eventRing->getHighWaterMark() : 0;
+    }
+
+    unsigned long long getDroppedRecordCount() const {
+        return eventRing ? eventRing->getDroppedCount() : 0;
+    }
+
+    // Only safe on the consumer thread or once capture has stopped;
+    // use getEventsSnapshot() or getLiveStatistics() while capturing
+    const EventHistory<BehavioralEvent>& getEvents() const {
+        return events;
+    }
+
+    // Contiguous copy of the history, oldest first; safe while capturing
+    std::vector<BehavioralEvent> getEventsSnapshot() const {
+        std::vector<BehavioralEvent> snapshot;
+        events.copyRecent(snapshot, events.capacity());
+        return snapshot;
+    }
+
+    // Counters plus the most recent events, readable from any thread at any
+    // time without blocking the hook or consumer threads
+    LiveStatistics getLiveStatistics(size_t recentCount) const {
+        LiveStatistics live;
+        live.recordedEvents = getRecordedEventCount();
+        for (int i = 0; i < EVENT_TYPE_COUNT; i++) {
+            live.recordedByType[i] = recordedByType[i].load(std::memory_order_relaxed);
+        }
+        live.droppedRecords = getDroppedRecordCount();
+        live.queueDepth = eventRing ? eventRing->size() : 0;
+        live.keptMoves = decimator.getKeptMoves();
+        live.droppedMoves = decimator.getDroppedMoves();
+        live.firstRecentSequence = events.copyRecent(live.recentEvents, recentCount);
+        return live;
+    }
+
+    // Column-wise copy of the history for the vectorized statistics; safe
+    // while capturing
+    EventColumns getEventColumns() const {
+        EventColumns columns;
+        columns.assign(getEventsSnapshot());
+        return columns;
+    }
+
+    ColumnStats computeStatistics() const {
+        return computeColumnStats(getEventColumns());
+    }
+
+    // Feed a synthetic hook event through the same path as the real hook
+    // callbacks (benchmarks and replay, usually with installHooks = false)
+    void injectMouseEvent(WPARAM message, const MSLLHOOKSTRUCT& data) {
+        processMouseEvent(message, reinterpret_cast<LPARAM>(&data));
+    }
+
+    void injectKeyboardEvent(WPARAM message, const KBDLLHOOKSTRUCT& data) {
+        processKeyboardEvent(message, reinterpret_cast<LPARAM>(&data));
+    }
+
+    // Replay (CaptureReplay): feeds a recorded event through the hook path,
+    // its timestamp, application and background count standing in for the
+    // clock and the cached context; recorded.appId must come from
+    // internAppName(). Deterministic with options.recordedTime. A KEY_UP's
+    // autorepeat run is fed as key downs first, so the stored record gets
+    // the same repeat count.
+    void replayEvent(const BehavioralEvent& recorded) {
+        replayRecord = &recorded;
+        MSLLHOOKSTRUCT mouse = {};
+        mouse.pt.x = recorded.x;
+        mouse.pt.y = recorded.y;
+        KBDLLHOOKSTRUCT key = {};
+        key.vkCode = recorded.keyCode;
+
+        switch (recorded.type) {
+        case MOUSE_MOVE:
+            processMouseEvent(WM_MOUSEMOVE, reinterpret_cast<LPARAM>(&mouse));
+            break;
+        case MOUSE_LEFT_DOWN:
+            processMouseEvent(WM_LBUTTONDOWN, reinterpret_cast<LPARAM>(&mouse));
+            break;
+        case MOUSE_LEFT_UP:
+            processMouseEvent(WM_LBUTTONUP, reinterpret_cast<LPARAM>(&mouse));
+            break;
+        case MOUSE_RIGHT_DOWN:
+            processMouseEvent(WM_RBUTTONDOWN, reinterpret_cast<LPARAM>(&mouse));
+            break;
+        case MOUSE_RIGHT_UP:
+            processMouseEvent(WM_RBUTTONUP, reinterpret_cast<LPARAM>(&mouse));
+            break;
+        case MOUSE_WHEEL:
+            mouse.mouseData = static_cast<DWORD>(static_cast<uint16_t>(recorded.wheelDelta)) << 16;
+            processMouseEvent(WM_MOUSEWHEEL, reinterpret_cast<LPARAM>(&mouse));
+            break;
+        case KEY_DOWN:
+            processKeyboardEvent(WM_KEYDOWN, reinterpret_cast<LPARAM>(&key));
+            break;
+        case KEY_UP:
+            for (uint16_t i = 0; i < recorded.repeatCount; i++) {
+                processKeyboardEvent(WM_KEYDOWN, reinterpret_cast<LPARAM>(&key));
+            }
+            processKeyboardEvent(WM_KEYUP, reinterpret_cast<LPARAM>(&key));
+            break;
+        }
+        replayRecord = nullptr;
+    }
+
+    // Capture's app ID for a recorded name, for replayEvent()
+    uint16_t internAppName(const std::string& name) {
+        return appNames.intern(name);
+    }
+
+    unsigned long long getRecordedEventCount() const {
+        return recordedEvents.load(std::memory_order_relaxed);
+    }
+
+    // Changes the decimation policy while capturing; the consumer thread
+    // picks it up with the next record
+    void setDecimation(const DecimationOptions& decimation) {
+        std::lock_guard<std::mutex> lock(decimationMutex);
+        pendingDecimation = decimation;
+        options.decimation = decimation;
+        decimationChanged.store(true, std::memory_order_release);
+    }
+
+    unsigned long long getKeptMoveCount() const {
+        return decimator.getKeptMoves();
+    }
+
+    unsigned long long getDroppedMoveCount() const {
+        return decimator.getDroppedMoves();
+    }
+
+    // Bytes handed to the log file so far, including the header
+    unsigned long long getBytesWritten() const {
+        if (options.logFormat == LOG_FORMAT_BINARY) return binaryWriter.getBytesWritten();
+        if (options.logFormat == LOG_FORMAT_JOURNAL) return journalWriter.getBytesWritten();
+        return dataWriter.getBytesWritten();
+    }
+
+    // Resolves BehavioralEvent::appId
+    const std::string& getAppName(uint16_t appId) const {
+        return appNames.name(appId);
+    }
+};
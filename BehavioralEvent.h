@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+// Event types
+enum EventType {
+    MOUSE_MOVE,
+    MOUSE_LEFT_DOWN,
+    MOUSE_LEFT_UP,
+    MOUSE_RIGHT_DOWN,
+    MOUSE_RIGHT_UP,
+    MOUSE_WHEEL,
+    KEY_DOWN,
+    KEY_UP
+};
+
+const int EVENT_TYPE_COUNT = KEY_UP + 1;
+
+// dwellTime/flightTime of a KEY_UP whose key down was not seen
+const int32_t KEY_TIMING_NONE = INT32_MIN;
+
+// Compact, trivially copyable event record (32 bytes, no heap).
+// The active application is stored as an ID into AppInternTable.
+// Key records have no position, so KEY_UP reuses those slots for its
+// timing: dwellTime is how long the key was held, flightTime the time from
+// the up of the key pressed before it to this key's down (negative when
+// that key was released after this one went down), and repeatCount the
+// autorepeat key downs folded into it while it was held.
+// Mouse records have no key code; that byte holds the index of the monitor
+// under the cursor in the capture's MonitorTable.
+// MOUSE_MOVE records travel from the hook to the kinematics stage with the
+// QPC time of the move (moveTimeUs) in place of its speed; the stage fills
+// in mouseSpeed before any other stage sees the record.
+struct BehavioralEvent {
+    long long timestamp;          // ms since epoch
+    union { int32_t x; int32_t dwellTime; };   // Mouse: cursor x, KEY_UP: ms held down
+    union { int32_t y; int32_t flightTime; };  // Mouse: cursor y, KEY_UP: ms since previous key's up
+    union { float mouseSpeed; uint32_t moveTimeUs; };  // Pixels per second (hook side: us since capture start, wrapping)
+    uint32_t timeSinceLast;       // ms since previous event
+    uint16_t appId;               // AppInternTable ID of the active application
+    uint16_t backgroundAppCount;
+    union { int16_t wheelDelta; uint16_t repeatCount; };  // MOUSE_WHEEL: delta, KEY_UP: autorepeats
+    union { uint8_t keyCode; uint8_t monitor; };  // Key: virtual-key code, mouse: MonitorTable index
+    uint8_t type;                 // EventType
+};
+
+static_assert(sizeof(BehavioralEvent) == 32, "BehavioralEvent should stay 32 bytes");
@@ -0,0 +1,752 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BehavioralEvent.h"
+#include "AppInternTable.h"
+#include "MonitorTable.h"
+#include "FileOutput.h"
+#include "CaptureTelemetry.h"
+#include "CaptureIndex.h"
+#include "EventSink.h"
+
+// Compact binary capture log (.bclog).
+//
+// File layout:
+//   header   "BCAP", uint16 version, uint16 flags (little-endian)
+//   blocks   uint8 block type, uint32 payload length, payload
+//
+// Every block is length-prefixed so readers skip block types they do not
+// know. Events blocks are self-contained (absolute base timestamp, deltas
+// relative to the previous record in the same block); app dictionary
+// blocks always precede the first events block that uses their IDs, and a
+// monitor table block precedes the first events block recorded with it.
+//
+// Events block payload:
+//   varint count, varint base timestamp, then per record:
+//   uint8 header     bits 0-3 type, bit 4 app changed, bit 5 background
+//                    count changed, bit 6 explicit time_since_last,
+//                    bit 7 non-zero speed
+//   zigzag varint    timestamp delta
+//   [varint]         time_since_last, when it differs from the delta
+//   [varint]         app ID / background count, when changed
+//   mouse events     zigzag varint dx, dy from the previous mouse event
+//   mouse (type 5)   uint8 monitor index (0xFF = unknown)
+//   MOUSE_WHEEL      zigzag varint wheel delta
+//   key events       uint8 virtual-key code
+//   KEY_UP (type 3)  varint dwell, varint flight: 0 = unknown, else zigzag + 1
+//   KEY_UP (type 4)  varint autorepeat count, after the timing
+//   [varint]         speed in 0.01 px/s, the CSV export precision
+//
+// Writers emit type 5 events blocks (type 4 plus the monitor of mouse
+// records; type 4 added the KEY_UP repeat count to type 3). Type 2 to 4
+// blocks from older files are still read; older readers skip the newer
+// types.
+//
+// App dictionary block payload:
+//   varint count, then per entry: varint app ID, varint length, name bytes
+//
+// Monitor table block payload (the whole table, replacing any earlier one):
+//   varint generation, varint count, then per monitor: zigzag varint left,
+//   top, varint width, height, dpi
+//
+// Session block payload, in logs that multiplex several Windows sessions
+// (CaptureService): varint session ID, varint length, user name bytes.
+// The events blocks up to the next session block belong to that session;
+// like the monitor table it is repeated at every index entry.
+
+const char BINARY_LOG_MAGIC[4] = { 'B', 'C', 'A', 'P' };
+const uint16_t BINARY_LOG_VERSION = 1;
+const size_t BINARY_LOG_HEADER_SIZE = 8;
+const size_t BINARY_BLOCK_HEADER_SIZE = 5;
+const uint32_t BINARY_MAX_BLOCK_PAYLOAD = 64u << 20;  // Longer lengths are corruption, see BINARY_MAX_BLOCK_EVENTS
+const size_t BINARY_MAX_BLOCK_EVENTS = 1 << 20;       // At most ~45 bytes a record, well inside the payload cap
+
+enum BinaryBlockType {
+    BLOCK_APP_DICTIONARY = 1,
+    BLOCK_EVENTS = 2,
+    BLOCK_EVENTS_KEY_TIMING = 3,
+    BLOCK_EVENTS_KEY_REPEATS = 4,
+    BLOCK_EVENTS_MONITORS = 5,
+    BLOCK_MONITOR_TABLE = 6,
+    BLOCK_SESSION = 7
+};
+
+enum BinaryRecordFlags {
+    RECORD_TYPE_MASK = 0x0F,
+    RECORD_APP_CHANGED = 0x10,
+    RECORD_BACKGROUND_CHANGED = 0x20,
+    RECORD_EXPLICIT_TIME_SINCE_LAST = 0x40,
+    RECORD_HAS_SPEED = 0x80
+};
+
+// Varint/zigzag helpers shared by the writer and reader
+struct BinaryCodec {
+    static void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    static void putSigned(std::vector<uint8_t>& out, int64_t value) {
+        putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    static void putUint16(std::vector<uint8_t>& out, uint16_t value) {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    static void putUint32(std::vector<uint8_t>& out, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    static void putUint64(std::vector<uint8_t>& out, uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    // Readers advance pos and return false on truncated input
+    static bool getVarint(const uint8_t* data, size_t size, size_t& pos, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && pos < size; shift += 7) {
+            uint8_t byte = data[pos++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+    static bool getSigned(const uint8_t* data, size_t size, size_t& pos, int64_t& value) {
+        uint64_t raw;
+        if (!getVarint(data, size, pos, raw)) return false;
+        value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+        return true;
+    }
+
+    // KEY_UP dwell/flight, with 0 reserved for KEY_TIMING_NONE
+    static void putKeyTiming(std::vector<uint8_t>& out, int32_t value) {
+        if (value == KEY_TIMING_NONE) {
+            out.push_back(0);
+            return;
+        }
+        const int64_t wide = value;
+        putVarint(out, ((static_cast<uint64_t>(wide) << 1) ^ static_cast<uint64_t>(wide >> 63)) + 1);
+    }
+
+    static bool getKeyTiming(const uint8_t* data, size_t size, size_t& pos, int32_t& value) {
+        uint64_t raw;
+        if (!getVarint(data, size, pos, raw)) return false;
+        if (raw == 0) {
+            value = KEY_TIMING_NONE;
+            return true;
+        }
+        raw--;
+        value = static_cast<int32_t>(static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1));
+        return true;
+    }
+
+    static uint16_t readUint16(const uint8_t* data) {
+        return static_cast<uint16_t>(data[0] | (data[1] << 8));
+    }
+
+    static uint32_t readUint32(const uint8_t* data) {
+        return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+            (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    static uint64_t readUint64(const uint8_t* data) {
+        return static_cast<uint64_t>(readUint32(data)) | (static_cast<uint64_t>(readUint32(data + 4)) << 32);
+    }
+
+    static void putBlockHeader(uint8_t* header, BinaryBlockType type, size_t payloadSize) {
+        const uint32_t length = static_cast<uint32_t>(payloadSize);
+        header[0] = static_cast<uint8_t>(type);
+        for (int i = 0; i < 4; i++) {
+            header[1 + i] = static_cast<uint8_t>(length >> (8 * i));
+        }
+    }
+
+    static bool isMouseType(uint8_t type) {
+        return type <= MOUSE_WHEEL;
+    }
+
+    static bool isKeyType(uint8_t type) {
+        return type == KEY_DOWN || type == KEY_UP;
+    }
+
+    static bool isEventsBlock(uint8_t blockType) {
+        return blockType >= BLOCK_EVENTS && blockType <= BLOCK_EVENTS_MONITORS;
+    }
+
+    static void encodeMonitorTable(const MonitorTable& table, std::vector<uint8_t>& block) {
+        putVarint(block, table.generation);
+        putVarint(block, table.monitors.size());
+        for (const MonitorInfo& monitor : table.monitors) {
+            putSigned(block, monitor.left);
+            putSigned(block, monitor.top);
+            putVarint(block, static_cast<uint32_t>(monitor.width));
+            putVarint(block, static_cast<uint32_t>(monitor.height));
+            putVarint(block, monitor.dpi);
+        }
+    }
+
+    static bool decodeMonitorTable(const uint8_t* data, size_t size, MonitorTable& table) {
+        size_t pos = 0;
+        uint64_t generation, count;
+        if (!getVarint(data, size, pos, generation) ||
+            !getVarint(data, size, pos, count) ||
+            count > MAX_MONITORS) {
+            return false;
+        }
+        table.generation = static_cast<uint32_t>(generation);
+        table.monitors.clear();
+        for (uint64_t i = 0; i < count; i++) {
+            int64_t left, top;
+            uint64_t width, height, dpi;
+            if (!getSigned(data, size, pos, left) || !getSigned(data, size, pos, top) ||
+                !getVarint(data, size, pos, width) || !getVarint(data, size, pos, height) ||
+                !getVarint(data, size, pos, dpi)) {
+                return false;
+            }
+            table.monitors.push_back(MonitorTable::makeMonitor(static_cast<int32_t>(left), static_cast<int32_t>(top),
+                static_cast<int32_t>(width), static_cast<int32_t>(height), static_cast<uint32_t>(dpi)));
+        }
+        return true;
+    }
+
+    // Appends the payload of a BLOCK_EVENTS_MONITORS block for events
+    // (at least one)
+    static void encodeEvents(const std::vector<BehavioralEvent>& events, std::vector<uint8_t>& block) {
+        putVarint(block, events.size());
+        long long previousTimestamp = events.front().timestamp;
+        putVarint(block, static_cast<uint64_t>(previousTimestamp));
+
+        int32_t previousX = 0, previousY = 0;
+        uint16_t previousApp = 0, previousBackground = 0;
+        for (const auto& event : events) {
+            const long long delta = event.timestamp - previousTimestamp;
+            const uint64_t centiSpeed = static_cast<uint64_t>(std::llround(event.mouseSpeed * 100.0));
+
+            uint8_t header = event.type & RECORD_TYPE_MASK;
+            if (event.appId != previousApp) header |= RECORD_APP_CHANGED;
+            if (event.backgroundAppCount != previousBackground) header |= RECORD_BACKGROUND_CHANGED;
+            if (static_cast<long long>(event.timeSinceLast) != delta) header |= RECORD_EXPLICIT_TIME_SINCE_LAST;
+            if (centiSpeed != 0) header |= RECORD_HAS_SPEED;
+
+            block.push_back(header);
+            putSigned(block, delta);
+            if (header & RECORD_EXPLICIT_TIME_SINCE_LAST) putVarint(block, event.timeSinceLast);
+            if (header & RECORD_APP_CHANGED) putVarint(block, event.appId);
+            if (header & RECORD_BACKGROUND_CHANGED) putVarint(block, event.backgroundAppCount);
+
+            if (isMouseType(event.type)) {
+                putSigned(block, static_cast<int64_t>(event.x) - previousX);
+                putSigned(block, static_cast<int64_t>(event.y) - previousY);
+                previousX = event.x;
+                previousY = event.y;
+                block.push_back(event.monitor);
+            }
+            if (event.type == MOUSE_WHEEL) putSigned(block, event.wheelDelta);
+            if (isKeyType(event.type)) block.push_back(event.keyCode);
+            if (event.type == KEY_UP) {
+                putKeyTiming(block, event.dwellTime);
+                putKeyTiming(block, event.flightTime);
+                putVarint(block, event.repeatCount);
+            }
+            if (header & RECORD_HAS_SPEED) putVarint(block, centiSpeed);
+
+            previousTimestamp = event.timestamp;
+            previousApp = event.appId;
+            previousBackground = event.backgroundAppCount;
+        }
+    }
+
+    // Decodes the payload of an events block of blockType, appending to out
+    // (anything with push_back(const BehavioralEvent&)); returns nullptr or the problem
+    template <typename Output>
+    static const char* decodeEvents(const uint8_t* data, size_t size, uint8_t blockType, Output& out) {
+        const bool hasKeyTiming = blockType >= BLOCK_EVENTS_KEY_TIMING;
+        const bool hasRepeatCount = blockType >= BLOCK_EVENTS_KEY_REPEATS;
+        const bool hasMonitor = blockType >= BLOCK_EVENTS_MONITORS;
+        size_t pos = 0;
+        uint64_t count, base;
+        if (!getVarint(data, size, pos, count) ||
+            !getVarint(data, size, pos, base)) {
+            return "Truncated events block";
+        }
+
+        long long previousTimestamp = static_cast<long long>(base);
+        int32_t previousX = 0, previousY = 0;
+        uint16_t previousApp = 0, previousBackground = 0;
+
+        for (uint64_t i = 0; i < count; i++) {
+            if (pos >= size) return "Truncated event record";
+            const uint8_t header = data[pos++];
+
+            BehavioralEvent event = {};
+            event.type = header & RECORD_TYPE_MASK;
+
+            int64_t delta;
+            uint64_t value;
+            if (!getSigned(data, size, pos, delta)) return "Truncated event record";
+            event.timestamp = previousTimestamp + delta;
+            event.timeSinceLast = static_cast<uint32_t>(delta);
+
+            if (header & RECORD_EXPLICIT_TIME_SINCE_LAST) {
+                if (!getVarint(data, size, pos, value)) return "Truncated event record";
+                event.timeSinceLast = static_cast<uint32_t>(value);
+            }
+            event.appId = previousApp;
+            if (header & RECORD_APP_CHANGED) {
+                if (!getVarint(data, size, pos, value)) return "Truncated event record";
+                event.appId = static_cast<uint16_t>(value);
+            }
+            event.backgroundAppCount = previousBackground;
+            if (header & RECORD_BACKGROUND_CHANGED) {
+                if (!getVarint(data, size, pos, value)) return "Truncated event record";
+                event.backgroundAppCount = static_cast<uint16_t>(value);
+            }
+
+            if (isMouseType(event.type)) {
+                int64_t dx, dy;
+                if (!getSigned(data, size, pos, dx) ||
+                    !getSigned(data, size, pos, dy)) {
+                    return "Truncated event record";
+                }
+                event.x = static_cast<int32_t>(previousX + dx);
+                event.y = static_cast<int32_t>(previousY + dy);
+                previousX = event.x;
+                previousY = event.y;
+                event.monitor = MONITOR_NONE;
+                if (hasMonitor) {
+                    if (pos >= size) return "Truncated event record";
+                    event.monitor = data[pos++];
+                }
+            }
+            if (event.type == MOUSE_WHEEL) {
+                int64_t wheel;
+                if (!getSigned(data, size, pos, wheel)) return "Truncated event record";
+                event.wheelDelta = static_cast<int16_t>(wheel);
+            }
+            if (isKeyType(event.type)) {
+                if (pos >= size) return "Truncated event record";
+                event.keyCode = data[pos++];
+            }
+            if (event.type == KEY_UP) {
+                event.dwellTime = KEY_TIMING_NONE;
+                event.flightTime = KEY_TIMING_NONE;
+                if (hasKeyTiming &&
+                    (!getKeyTiming(data, size, pos, event.dwellTime) ||
+                     !getKeyTiming(data, size, pos, event.flightTime))) {
+                    return "Truncated event record";
+                }
+                if (hasRepeatCount) {
+                    if (!getVarint(data, size, pos, value)) return "Truncated event record";
+                    event.repeatCount = static_cast<uint16_t>(value);
+                }
+            }
+            if (header & RECORD_HAS_SPEED) {
+                if (!getVarint(data, size, pos, value)) return "Truncated event record";
+                event.mouseSpeed = static_cast<float>(value / 100.0);
+            }
+
+            previousTimestamp = event.timestamp;
+            previousApp = event.appId;
+            previousBackground = event.backgroundAppCount;
+            out.push_back(event);
+        }
+        return nullptr;
+    }
+};
+
+// Encodes events into blocks and appends them to a .bclog file
+class BinaryLogWriter : public EventSink {
+private:
+    FileOutput file;
+    const AppInternTable* appNames;
+    std::vector<BehavioralEvent> pending;
+    std::vector<uint8_t> block;
+    std::vector<bool> appWritten;  // App IDs already emitted in this file session
+    std::mutex writerMutex;
+    LatencyHistogram* flushTimes;
+    QpcClock clock;
+    IndexOptions indexOptions;
+    CaptureIndexWriter index;
+    size_t eventsPerBlock;
+    const MonitorTableSource* monitors;
+    uint32_t monitorsWritten;  // Generation of the last monitor table block, 0 = none this session
+    bool sessionTagged;        // setSession() was called, events carry a session
+    uint32_t sessionId;
+    std::string sessionUser;
+    bool sessionWritten;       // The current session's block is in the file
+
+    void writeBlock(BinaryBlockType type, const std::vector<uint8_t>& payload) {
+        uint8_t header[BINARY_BLOCK_HEADER_SIZE];
+        BinaryCodec::putBlockHeader(header, type, payload.size());
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+    }
+
+    // Emits dictionary entries for any app IDs the pending events introduce
+    void writeNewAppNames() {
+        std::vector<uint16_t> newIds;
+        for (const auto& event : pending) {
+            if (event.appId >= appWritten.size()) appWritten.resize(event.appId + 1, false);
+            if (!appWritten[event.appId]) {
+                appWritten[event.appId] = true;
+                newIds.push_back(event.appId);
+            }
+        }
+        if (newIds.empty()) return;
+
+        block.clear();
+        BinaryCodec::putVarint(block, newIds.size());
+        for (uint16_t id : newIds) {
+            const std::string& name = appNames->name(id);
+            BinaryCodec::putVarint(block, id);
+            BinaryCodec::putVarint(block, name.size());
+            block.insert(block.end(), name.begin(), name.end());
+            if (index.isOpen()) index.addAppName(id, name);
+        }
+        writeBlock(BLOCK_APP_DICTIONARY, block);
+    }
+
+    // A new table is written when it changes, and again at every index
+    // entry so a reader that seeks there has one
+    void writeMonitorTable(bool indexEntry) {
+        const MonitorTable* table = monitors ? monitors->getTable() : nullptr;
+        if (!table || (table->generation == monitorsWritten && !indexEntry)) return;
+        block.clear();
+        BinaryCodec::encodeMonitorTable(*table, block);
+        writeBlock(BLOCK_MONITOR_TABLE, block);
+        monitorsWritten = table->generation;
+    }
+
+    void writeSession(bool indexEntry) {
+        if (!sessionTagged || (sessionWritten && !indexEntry)) return;
+        block.clear();
+        BinaryCodec::putVarint(block, sessionId);
+        BinaryCodec::putVarint(block, sessionUser.size());
+        block.insert(block.end(), sessionUser.begin(), sessionUser.end());
+        writeBlock(BLOCK_SESSION, block);
+        sessionWritten = true;
+    }
+
+    void writeEventsBlock() {
+        block.clear();
+        BinaryCodec::encodeEvents(pending, block);
+        writeBlock(BLOCK_EVENTS_MONITORS, block);
+    }
+
+    void flushLocked() {
+        if (!file.isOpen() || pending.empty()) return;
+        const long long started = QpcClock::now();
+        writeNewAppNames();
+        const bool indexEntry = index.entryDue();
+        if (indexEntry) {
+            const BehavioralEvent& first = pending.front();
+            index.addEntry(first.timestamp, file.getOffset(), first.appId, appNames->name(first.appId));
+        }
+        writeSession(indexEntry);
+        writeMonitorTable(indexEntry);
+        index.countRecords(pending.size());
+        writeEventsBlock();
+        pending.clear();
+        file.flushBatch();
+        index.flush();
+        if (flushTimes) flushTimes->record(clock.toNs(QpcClock::now() - started));
+    }
+
+public:
+    BinaryLogWriter() :
+        appNames(nullptr),
+        flushTimes(nullptr),
+        eventsPerBlock(256),
+        monitors(nullptr),
+        monitorsWritten(0),
+        sessionTagged(false),
+        sessionId(0),
+        sessionWritten(false) {}
+
+    // Optional: records the duration of every block flush
+    void setFlushHistogram(LatencyHistogram* histogram) {
+        flushTimes = histogram;
+    }
+
+    // Optional: sparse time index next to the log, applies from the next open()
+    void setIndexOptions(const IndexOptions& options) {
+        indexOptions = options;
+    }
+
+    // Optional: monitor geometry recorded next to the events
+    void setMonitorSource(const MonitorTableSource* source) {
+        monitors = source;
+    }
+
+    // Multiplexed logs: events written from now on belong to Windows session
+    // id, recorded with the session's monitor table. Seals the pending block
+    // when the session changes.
+    void setSession(uint32_t id, const std::string& user, const MonitorTableSource* source) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        if (sessionTagged && id == sessionId && source == monitors) return;
+        flushLocked();
+        sessionTagged = true;
+        sessionId = id;
+        sessionUser = user;
+        sessionWritten = false;
+        monitors = source;
+        monitorsWritten = 0;  // Generations of different sessions are unrelated
+    }
+
+    // Events per block (and so per write), applies from the next open()
+    void setBlockEvents(size_t events) {
+        eventsPerBlock = events > 0 ? (std::min)(events, BINARY_MAX_BLOCK_EVENTS) : 1;
+    }
+
+    bool open(const std::string& filename, const AppInternTable& names,
+        WriterBackend backend = WRITER_BACKEND_STREAM,
+        const OverlappedWriterOptions& overlappedOptions = OverlappedWriterOptions()) {
+        appNames = &names;
+        if (!file.open(filename, backend, overlappedOptions)) return false;
+
+        if (file.isEmpty()) {
+            std::vector<uint8_t> header(BINARY_LOG_MAGIC, BINARY_LOG_MAGIC + 4);
+            BinaryCodec::putUint16(header, BINARY_LOG_VERSION);
+            BinaryCodec::putUint16(header, 0);
+            file.write(reinterpret_cast<const char*>(header.data()), header.size());
+        }
+        pending.reserve(eventsPerBlock);
+        appWritten.clear();  // A new session re-emits its dictionary, monitor table and session
+        monitorsWritten = 0;
+        sessionWritten = false;
+        if (indexOptions.enabled && !index.open(filename, indexOptions)) {
+            file.close();
+            return false;
+        }
+        return true;
+    }
+
+    // App names come from the AppInternTable passed to open()
+    void write(const BehavioralEvent& event, const std::string&) override {
+        write(event);
+    }
+
+    void write(const BehavioralEvent& event) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        pending.push_back(event);
+
+        if (pending.size() >= eventsPerBlock) {
+            flushLocked();
+        }
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        flushLocked();
+    }
+
+    // Idle-time check for a time-based durability policy (pending events stay in memory)
+    void flushIfDue() override {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        file.flushIfDue();
+    }
+
+    // Seals the partial block
+    void flushAll() override {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        flushLocked();
+        file.flush();
+    }
+
+    void close() override {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        flushLocked();
+        file.close();
+        index.close();
+    }
+
+    bool isOpen() const {
+        return file.isOpen();
+    }
+
+    unsigned long long getBytesWritten() const override {
+        return file.getBytesWritten();
+    }
+};
+
+// Sequential reader for .bclog files, used by the CSV export tool
+class BinaryLogReader {
+private:
+    std::ifstream file;
+    std::unordered_map<uint16_t, std::string> appNames;
+    MonitorTable monitorTable;
+    bool hasMonitorTable;
+    bool hasSession;
+    uint32_t sessionId;
+    std::string sessionUser;
+    std::vector<uint8_t> payload;
+    std::vector<BehavioralEvent> decoded;
+    size_t decodedPos;
+    std::string error;
+    const std::string unknownApp = "Unknown";
+
+    bool fail(const std::string& message) {
+        error = message;
+        return false;
+    }
+
+    bool decodeAppDictionary() {
+        const uint8_t* data = payload.data();
+        const size_t size = payload.size();
+        size_t pos = 0;
+        uint64_t count;
+        if (!BinaryCodec::getVarint(data, size, pos, count)) return fail("Truncated app dictionary");
+
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t id, length;
+            if (!BinaryCodec::getVarint(data, size, pos, id) ||
+                !BinaryCodec::getVarint(data, size, pos, length) ||
+                length > size - pos) {
+                return fail("Truncated app dictionary entry");
+            }
+            appNames[static_cast<uint16_t>(id)] = std::string(reinterpret_cast<const char*>(data + pos), length);
+            pos += length;
+        }
+        return true;
+    }
+
+    bool decodeSession() {
+        const uint8_t* data = payload.data();
+        const size_t size = payload.size();
+        size_t pos = 0;
+        uint64_t id, length;
+        if (!BinaryCodec::getVarint(data, size, pos, id) ||
+            !BinaryCodec::getVarint(data, size, pos, length) ||
+            length > size - pos) {
+            return fail("Truncated session block");
+        }
+        hasSession = true;
+        sessionId = static_cast<uint32_t>(id);
+        sessionUser.assign(reinterpret_cast<const char*>(data + pos), static_cast<size_t>(length));
+        return true;
+    }
+
+    bool decodeEvents(uint8_t blockType) {
+        decoded.clear();
+        decodedPos = 0;
+        if (const char* problem = BinaryCodec::decodeEvents(payload.data(), payload.size(), blockType, decoded)) {
+            return fail(problem);
+        }
+        return true;
+    }
+
+    // Loads the next block; returns false at end of file or on error
+    bool readBlock() {
+        uint8_t header[BINARY_BLOCK_HEADER_SIZE];
+        if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+            if (file.gcount() != 0) return fail("Truncated block header");
+            return false;
+        }
+
+        const uint32_t length = BinaryCodec::readUint32(header + 1);
+        if (length > BINARY_MAX_BLOCK_PAYLOAD) return fail("Corrupt block length " + std::to_string(length));
+        payload.resize(length);
+        if (length > 0 && !file.read(reinterpret_cast<char*>(payload.data()), length)) {
+            return fail("Truncated block payload");
+        }
+
+        if (header[0] == BLOCK_APP_DICTIONARY) return decodeAppDictionary();
+        if (header[0] == BLOCK_MONITOR_TABLE) {
+            hasMonitorTable = BinaryCodec::decodeMonitorTable(payload.data(), payload.size(), monitorTable);
+            return hasMonitorTable || fail("Truncated monitor table");
+        }
+        if (header[0] == BLOCK_SESSION) return decodeSession();
+        if (BinaryCodec::isEventsBlock(header[0])) return decodeEvents(header[0]);
+        return true;  // Unknown block type from a newer writer, skip it
+    }
+
+public:
+    BinaryLogReader() : hasMonitorTable(false), hasSession(false), sessionId(0), decodedPos(0) {}
+
+    bool open(const std::string& filename) {
+        file.open(filename, std::ios::binary);
+        if (!file.is_open()) return fail("Cannot open " + filename);
+
+        uint8_t header[BINARY_LOG_HEADER_SIZE];
+        if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+            std::memcmp(header, BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC)) != 0) {
+            return fail("Not a binary capture log");
+        }
+        if (BinaryCodec::readUint16(header + 4) > BINARY_LOG_VERSION) {
+            return fail("Unsupported binary log version");
+        }
+        return true;
+    }
+
+    // Returns the next event, or false at end of file (check getError())
+    bool next(BehavioralEvent& event) {
+        while (decodedPos >= decoded.size()) {
+            decoded.clear();
+            decodedPos = 0;
+            if (!readBlock()) return false;
+        }
+        event = decoded[decodedPos++];
+        return true;
+    }
+
+    // Continues at a block boundary, e.g. an offset from the capture index
+    bool seek(unsigned long long offset) {
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(offset));
+        decoded.clear();
+        decodedPos = 0;
+        return file.good() || fail("Cannot seek to " + std::to_string(offset));
+    }
+
+    // Names learned elsewhere (the capture index) for blocks read after a seek
+    void addAppName(uint16_t id, const std::string& name) {
+        appNames[id] = name;
+    }
+
+    const std::string& appName(uint16_t id) const {
+        auto it = appNames.find(id);
+        return it != appNames.end() ? it->second : unknownApp;
+    }
+
+    // The monitor table of the events returned last, null before the first
+    // one (or in logs written before monitors were recorded)
+    const MonitorTable* monitors() const {
+        return hasMonitorTable ? &monitorTable : nullptr;
+    }
+
+    // Session of the events returned last, false in single-session logs
+    bool hasSessions() const {
+        return hasSession;
+    }
+
+    uint32_t session() const {
+        return sessionId;
+    }
+
+    const std::string& sessionUserName() const {
+        return sessionUser;
+    }
+
+    const std::string& getError() const {
+        return error;
+    }
+};
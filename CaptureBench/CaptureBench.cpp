@@ -0,0 +1,214 @@
+#include <winsock2.h>  // Before windows.h, see NetworkSink.h
+#include <windows.h>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "BehavioralCapture.h"
+
+// Capture pipeline benchmark.
+// Drives processMouseEvent/processKeyboardEvent with synthetic hook structs
+// (no real hooks installed) and reports per-event hook latency percentiles,
+// throughput, heap allocations per event and bytes written per event.
+
+static std::atomic<unsigned long long> allocationCount(0);
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+enum Scenario {
+    SCENARIO_MOUSE,   // 1 kHz gaming mouse sweep with occasional clicks
+    SCENARIO_TYPING,  // Bursts of key down/up pairs
+    SCENARIO_MIXED    // Mouse stream with typing bursts interleaved
+};
+
+struct SyntheticEvent {
+    bool isMouse;
+    WPARAM message;
+    MSLLHOOKSTRUCT mouse;
+    KBDLLHOOKSTRUCT key;
+};
+
+static std::vector<SyntheticEvent> makeScenario(Scenario scenario, size_t count) {
+    std::vector<SyntheticEvent> stream;
+    stream.reserve(count);
+    int x = 960, y = 540, dx = 3, dy = 2;
+    unsigned int step = 0;
+
+    while (stream.size() < count) {
+        step++;
+        bool typingTurn = scenario == SCENARIO_TYPING || (scenario == SCENARIO_MIXED && (step % 200) >= 150);
+
+        SyntheticEvent event = {};
+        if (!typingTurn) {
+            // Bounce around the screen, clicking every 500 samples
+            x += dx;
+            y += dy;
+            if (x < 0 || x >= 1920) dx = -dx;
+            if (y < 0 || y >= 1080) dy = -dy;
+            event.isMouse = true;
+            event.mouse.pt.x = x;
+            event.mouse.pt.y = y;
+            event.message = WM_MOUSEMOVE;
+            if (step % 500 == 0) event.message = WM_LBUTTONDOWN;
+            if (step % 500 == 1) event.message = WM_LBUTTONUP;
+            if (step % 997 == 0) {
+                event.message = WM_MOUSEWHEEL;
+                event.mouse.mouseData = static_cast<DWORD>(120 << 16);
+            }
+            stream.push_back(event);
+        }
+        else {
+            // One keystroke = down + up
+            event.isMouse = false;
+            event.key.vkCode = 0x41 + step % 26;
+            event.message = WM_KEYDOWN;
+            stream.push_back(event);
+            event.message = WM_KEYUP;
+            if (stream.size() < count) stream.push_back(event);
+        }
+    }
+    return stream;
+}
+
+static long long percentile(const std::vector<long long>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1));
+    return sorted[index];
+}
+
+int main(int argc, char* argv[]) {
+    Scenario scenario = SCENARIO_MIXED;
+    size_t eventCount = 1000000;
+    bool realtime = false;
+    int realtimeRateHz = 1000;
+    CaptureOptions options;
+    options.installHooks = false;
+    options.foregroundTracking = FOREGROUND_TRACKING_POLL;  // No message pump in the benchmark
+    options.telemetrySharedMemoryName += "." + std::to_string(GetCurrentProcessId());  // Not a live capture's block
+    std::string outputFile = "capture_bench.csv";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--scenario" && i + 1 < argc) {
+            std::string name = argv[++i];
+            scenario = name == "mouse" ? SCENARIO_MOUSE : name == "typing" ? SCENARIO_TYPING : SCENARIO_MIXED;
+        }
+        else if (arg == "--events" && i + 1 < argc) {
+            eventCount = static_cast<size_t>(std::atoll(argv[++i]));
+        }
+        else if (arg == "--realtime") {
+            realtime = true;  // Pace events at --rate Hz instead of injecting flat out
+        }
+        else if (arg == "--rate" && i + 1 < argc) {
+            realtimeRateHz = std::atoi(argv[++i]);
+        }
+        else if (arg == "--sync") {
+            options.mode = CAPTURE_MODE_SYNC;
+        }
+        else if (arg == "--binary") {
+            options.logFormat = LOG_FORMAT_BINARY;
+            outputFile = "capture_bench.bclog";
+        }
+        else if (arg == "--overlapped") {
+            options.writerBackend = WRITER_BACKEND_OVERLAPPED;
+        }
+        else if (arg == "--decimate" && i + 1 < argc) {
+            std::string policy = argv[++i];
+            if (!parseDecimationPolicy(policy, options.decimation.policy)) {
+                std::cerr << "Unknown decimation policy: " << policy << std::endl;
+            }
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            outputFile = argv[++i];
+        }
+    }
+
+    const std::vector<SyntheticEvent> stream = makeScenario(scenario, eventCount);
+    std::vector<long long> latencies(stream.size());
+    std::remove(outputFile.c_str());
+
+    LARGE_INTEGER frequency, begin, end, injectStart, injectEnd;
+    QueryPerformanceFrequency(&frequency);
+    const double ticksToNs = 1e9 / static_cast<double>(frequency.QuadPart);
+    const long long ticksPerEvent = frequency.QuadPart / (realtimeRateHz > 0 ? realtimeRateHz : 1000);
+
+    BehavioralCapture capture;
+    if (!capture.start(outputFile, options)) {
+        std::cerr << "Failed to start capture pipeline!" << std::endl;
+        return 1;
+    }
+    const unsigned long long bytesAtStart = capture.getBytesWritten();  // File header
+    const unsigned long long allocationsAtStart = allocationCount.load();
+
+    QueryPerformanceCounter(&injectStart);
+    for (size_t i = 0; i < stream.size(); i++) {
+        const SyntheticEvent& event = stream[i];
+        if (realtime) {
+            LARGE_INTEGER now;
+            do {
+                QueryPerformanceCounter(&now);
+            } while (now.QuadPart - injectStart.QuadPart < static_cast<long long>(i) * ticksPerEvent);
+        }
+
+        QueryPerformanceCounter(&begin);
+        if (event.isMouse) {
+            capture.injectMouseEvent(event.message, event.mouse);
+        }
+        else {
+            capture.injectKeyboardEvent(event.message, event.key);
+        }
+        QueryPerformanceCounter(&end);
+        latencies[i] = end.QuadPart - begin.QuadPart;
+    }
+    QueryPerformanceCounter(&injectEnd);
+
+    capture.stop();  // Drains the ring and flushes the writer
+    LARGE_INTEGER drained;
+    QueryPerformanceCounter(&drained);
+
+    const unsigned long long allocations = allocationCount.load() - allocationsAtStart;
+    const unsigned long long stored = capture.getRecordedEventCount();
+    const unsigned long long bytes = capture.getBytesWritten() - bytesAtStart;
+    const double injectSeconds = (injectEnd.QuadPart - injectStart.QuadPart) / static_cast<double>(frequency.QuadPart);
+    const double totalSeconds = (drained.QuadPart - injectStart.QuadPart) / static_cast<double>(frequency.QuadPart);
+
+    std::sort(latencies.begin(), latencies.end());
+
+    const char* scenarioName = scenario == SCENARIO_MOUSE ? "mouse" : scenario == SCENARIO_TYPING ? "typing" : "mixed";
+    std::cout << "\n=== Capture Benchmark ===" << std::endl;
+    std::cout << "Scenario: " << scenarioName << (realtime ? " (paced)" : " (max speed)")
+        << ", " << stream.size() << " hook events" << std::endl;
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "Hook latency: p50 " << percentile(latencies, 0.50) * ticksToNs
+        << " ns, p99 " << percentile(latencies, 0.99) * ticksToNs
+        << " ns, p999 " << percentile(latencies, 0.999) * ticksToNs
+        << " ns, max " << latencies.back() * ticksToNs << " ns" << std::endl;
+    std::cout << "Throughput: " << stream.size() / injectSeconds << " hook events/sec, "
+        << stored / totalSeconds << " stored events/sec end-to-end" << std::endl;
+    std::cout << std::setprecision(3);
+    std::cout << "Allocations per hook event: " << static_cast<double>(allocations) / stream.size() << std::endl;
+    std::cout << std::setprecision(1);
+    std::cout << "Stored events: " << stored << " (dropped by ring: " << capture.getDroppedRecordCount() << ")" << std::endl;
+    std::cout << "Mouse moves kept / dropped by decimation: " << capture.getKeptMoveCount()
+        << " / " << capture.getDroppedMoveCount() << std::endl;
+    std::cout << "Bytes written per stored event: " << (stored ? static_cast<double>(bytes) / stored : 0.0) << std::endl;
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <winsock2.h>  // Before windows.h, see NetworkSink.h
+#include <windows.h>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+
+#include "NetworkSink.h"
+#include "BinaryLog.h"
+
+// Collector for NetworkSink streams (BehavioralCapture --collector).
+// Every machine's frames are decompressed and appended to
+// <directory>/<computer name>.bclog, which CaptureExport, CaptureQuery and
+// CaptureLoad read like any local binary log. Each frame is acknowledged
+// once written; a frame the agent sends again after a reconnect is
+// acknowledged but not written twice.
+
+static std::mutex outputMutex;  // Keeps each frame's blocks and each console line together
+static std::map<uint64_t, uint64_t> lastSequences;  // Per stream ID, under outputMutex
+
+// Computer name reduced to characters that are safe in a file name
+static std::string safeFileName(const std::string& name) {
+    std::string result;
+    for (char c : name) {
+        const bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+        result += safe ? c : '_';
+    }
+    return result.empty() ? "unknown" : result;
+}
+
+static void serveConnection(SOCKET connection, std::string directory) {
+    uint8_t hello[NETWORK_HELLO_SIZE];
+    if (!receiveAll(connection, hello, sizeof(hello)) ||
+        memcmp(hello, NETWORK_HELLO_MAGIC, sizeof(NETWORK_HELLO_MAGIC)) != 0 ||
+        BinaryCodec::readUint16(hello + 4) != NETWORK_PROTOCOL_VERSION) {
+        closesocket(connection);
+        return;
+    }
+    std::string computer(BinaryCodec::readUint16(hello + 6), '\0');
+    const uint64_t stream = BinaryCodec::readUint64(hello + 8);
+    if (!computer.empty() && !receiveAll(connection, reinterpret_cast<uint8_t*>(&computer[0]), computer.size())) {
+        closesocket(connection);
+        return;
+    }
+
+    const std::string path = directory + safeFileName(computer) + ".bclog";
+    std::ofstream output;
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        output.open(path, std::ios::binary | std::ios::app);
+        if (output.is_open() && output.tellp() == 0) {
+            std::vector<uint8_t> header(BINARY_LOG_MAGIC, BINARY_LOG_MAGIC + 4);
+            BinaryCodec::putUint16(header, BINARY_LOG_VERSION);
+            BinaryCodec::putUint16(header, 0);
+            output.write(reinterpret_cast<const char*>(header.data()), header.size());
+        }
+        if (!output.is_open()) {
+            std::cerr << "Failed to open file: " << path << std::endl;
+            closesocket(connection);
+            return;
+        }
+        std::cout << computer << " connected, appending to " << path << std::endl;
+    }
+
+    // Tells the agent where to resume
+    uint64_t lastSequence;
+    {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        lastSequence = lastSequences[stream];
+    }
+    std::vector<uint8_t> reply;
+    BinaryCodec::putUint64(reply, lastSequence);
+    if (!sendAll(connection, reply.data(), reply.size())) {
+        closesocket(connection);
+        return;
+    }
+
+    FrameDecompressor decompressor;
+    std::vector<uint8_t> packed, payload;
+    unsigned long long frames = 0, duplicates = 0, wireBytes = 0, payloadBytes = 0;
+    const char* problem = nullptr;
+    for (;;) {
+        uint8_t header[NETWORK_SEQUENCE_SIZE + NETWORK_FRAME_HEADER_SIZE];
+        if (!receiveAll(connection, header, sizeof(header))) break;  // Disconnected
+        const uint64_t sequence = BinaryCodec::readUint64(header);
+        const uint32_t originalSize = BinaryCodec::readUint32(header + NETWORK_SEQUENCE_SIZE);
+        const uint32_t packedSize = BinaryCodec::readUint32(header + NETWORK_SEQUENCE_SIZE + 4);
+        if (originalSize > NETWORK_MAX_FRAME_BYTES || packedSize > NETWORK_MAX_FRAME_BYTES) {
+            problem = "oversized frame";
+            break;
+        }
+        packed.resize(packedSize);
+        if (!receiveAll(connection, packed.data(), packed.size())) {
+            problem = "truncated frame";
+            break;
+        }
+        if (!decompressor.decompress(packed.data(), packed.size(), originalSize, payload)) {
+            problem = "corrupt frame";
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            uint64_t& written = lastSequences[stream];
+            if (sequence > written) {
+                output.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+                output.flush();
+                if (!output.good()) {
+                    problem = "write failed";
+                    break;
+                }
+                written = sequence;
+                frames++;
+                payloadBytes += originalSize;
+            }
+            else {
+                duplicates++;
+            }
+        }
+        wireBytes += sizeof(header) + packedSize;
+
+        std::vector<uint8_t> ack;
+        BinaryCodec::putUint64(ack, sequence);
+        if (!sendAll(connection, ack.data(), ack.size())) break;
+    }
+    closesocket(connection);
+    output.close();
+
+    std::lock_guard<std::mutex> lock(outputMutex);
+    std::cout << computer << " disconnected" << (problem ? std::string(" (") + problem + ")" : std::string())
+        << ": " << frames << " frames (" << duplicates << " resent duplicates skipped), " << wireBytes
+        << " bytes received, " << payloadBytes << " decoded" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    unsigned short port = NetworkOptions().port;
+    std::string directory;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            port = static_cast<unsigned short>(std::atoi(argv[++i]));
+        }
+        else if (arg == "--dir" && i + 1 < argc) {
+            directory = argv[++i];
+            if (!directory.empty() && directory.back() != '\\' && directory.back() != '/') directory += '\\';
+        }
+        else {
+            std::cerr << "Usage: CaptureCollector [--port N] [--dir output_directory]" << std::endl;
+            return 1;
+        }
+    }
+
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        std::cerr << "Failed to initialize Winsock" << std::endl;
+        return 1;
+    }
+
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (listener == INVALID_SOCKET ||
+        bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        std::cerr << "Failed to listen on port " << port << std::endl;
+        WSACleanup();
+        return 1;
+    }
+    std::cout << "Collecting on port " << port << " into " << (directory.empty() ? "the current directory" : directory) << std::endl;
+
+    for (;;) {
+        SOCKET connection = accept(listener, NULL, NULL);
+        if (connection == INVALID_SOCKET) break;
+        std::thread(serveConnection, connection, directory).detach();
+    }
+    closesocket(listener);
+    WSACleanup();
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <limits>
+#include <type_traits>
+#include <cstddef>
+
+#include "BinaryLog.h"
+#include "EventJournal.h"
+#include "LogRotation.h"
+#include "CsvFormat.h"
+
+// Writes the events of reader (BinaryLogReader or JournalReader) for which
+// keep() holds as CSV. session(), when given, fills a leading session column.
+template <typename Reader, typename Keep, typename Session = std::nullptr_t>
+int exportEvents(Reader& reader, const std::string& outputFile, Keep keep, Session session = nullptr) {
+    std::ofstream output(outputFile, std::ios::binary);
+    if (!output.is_open()) {
+        std::cerr << "Failed to open file: " << outputFile << std::endl;
+        return 1;
+    }
+
+    constexpr bool sessionColumn = !std::is_same<Session, std::nullptr_t>::value;
+    CsvBlock block;
+    const std::string header = std::string(sessionColumn ? "session," : "") + CSV_HEADER;
+    block.appendLine(header.data(), header.size());
+
+    BehavioralEvent event;
+    unsigned long long count = 0;
+    while (reader.next(event)) {
+        if (!keep()) continue;
+        if constexpr (sessionColumn) block.appendLeadingField(session());
+        block.appendRow(event, reader.appName(event.appId), reader.monitors());
+        count++;
+
+        if (block.rowCount() >= 4096) {
+            output.write(block.bytes(), block.size());
+            block.clear();
+        }
+    }
+    output.write(block.bytes(), block.size());
+    output.close();
+
+    if (!reader.getError().empty()) {
+        std::cerr << "Stopped after " << count << " events: " << reader.getError() << std::endl;
+        return 1;
+    }
+
+    std::cout << "Exported " << count << " events to " << outputFile << std::endl;
+    return 0;
+}
+
+// Expands a binary capture log (.bclog) or an event journal (.bcj, all
+// segments of it) back into the CSV schema written by BehavioralCapture, so
+// existing pipelines can consume any format. A compressed rotated segment
+// (.bcz) is decompressed next to itself first. --session N keeps one
+// Windows session of a CaptureService log; without it such a log gets a
+// leading session column.
+int main(int argc, char* argv[]) {
+    std::vector<std::string> paths;
+    long long sessionFilter = -1;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--session" && i + 1 < argc) {
+            const char* text = argv[++i];
+            char* end = nullptr;
+            const unsigned long long value = std::strtoull(text, &end, 10);
+            if (!*text || *text == '-' || *end || value > (std::numeric_limits<uint32_t>::max)()) {
+                std::cerr << "Invalid session: " << text << std::endl;
+                return 1;
+            }
+            sessionFilter = static_cast<long long>(value);
+        }
+        else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty() || paths.size() > 2) {
+        std::cerr << "Usage: CaptureExport <input.bclog | journal.bcj | segment.bcz> [output.csv] [--session N]" << std::endl;
+        return 1;
+    }
+
+    std::string inputFile = paths[0];
+    const size_t suffixLength = strlen(COMPRESSED_SEGMENT_EXTENSION);
+    if (inputFile.size() > suffixLength &&
+        inputFile.compare(inputFile.size() - suffixLength, suffixLength, COMPRESSED_SEGMENT_EXTENSION) == 0) {
+        const std::string expanded = inputFile.substr(0, inputFile.size() - suffixLength);
+        if (!decompressFile(inputFile, expanded)) {
+            std::cerr << "Failed to decompress " << inputFile << std::endl;
+            return 1;
+        }
+        std::cout << "Decompressed " << inputFile << " to " << expanded << std::endl;
+
+        std::string stem, extension;
+        splitExtension(expanded, stem, extension);
+        if (extension != ".bclog") return 0;  // A CSV segment needs no export
+        inputFile = expanded;
+    }
+    std::string outputFile;
+    if (paths.size() >= 2) {
+        outputFile = paths[1];
+    }
+    else {
+        size_t dot = inputFile.find_last_of('.');
+        outputFile = (dot == std::string::npos ? inputFile : inputFile.substr(0, dot)) + ".csv";
+    }
+
+    const bool journal = inputFile.size() > 4 && inputFile.compare(inputFile.size() - 4, 4, ".bcj") == 0;
+    if (journal) {
+        JournalReader reader;
+        if (!reader.open(inputFile)) {
+            std::cerr << "Failed to open " << inputFile << ": " << reader.getError() << std::endl;
+            return 1;
+        }
+        if (sessionFilter >= 0) {
+            std::cerr << "A journal holds a single session, --session applies to CaptureService logs" << std::endl;
+            return 1;
+        }
+        return exportEvents(reader, outputFile, [] { return true; });
+    }
+
+    BinaryLogReader reader;
+    if (!reader.open(inputFile)) {
+        std::cerr << "Failed to open " << inputFile << ": " << reader.getError() << std::endl;
+        return 1;
+    }
+    if (sessionFilter < 0) {
+        // Session blocks come before the first events block of each session
+        BinaryLogReader probe;
+        BehavioralEvent first;
+        if (probe.open(inputFile) && probe.next(first) && probe.hasSessions()) {
+            return exportEvents(reader, outputFile, [] { return true; }, [&] { return reader.session(); });
+        }
+    }
+    return exportEvents(reader, outputFile, [&] {
+        return sessionFilter < 0 || (reader.hasSessions() && reader.session() == static_cast<uint32_t>(sessionFilter));
+    });
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Sparse time index written next to a CSV or binary log (<log>.idx).
+//
+// File layout:
+//   header   "BCIX", uint16 version, uint16 reserved (little-endian)
+//   records  uint8 kind, then
+//     INDEX_RECORD_ENTRY     int64 timestamp, uint64 file offset, uint16 app ID
+//     INDEX_RECORD_APP_NAME  uint16 app ID, uint16 length, name bytes
+//
+// An entry points at the start of a CSV row (every `interval` rows) or of a
+// binary events block (the first block after each `interval` records), so a
+// reader can start decoding right there. App names are recorded the first
+// time an entry or block uses an ID, which lets a binary reader that seeks
+// past the log's dictionary blocks still resolve names.
+//
+// Entries are in file order; lookups assume event timestamps do not go
+// backwards within one log, which holds for the capture clock.
+
+const char CAPTURE_INDEX_MAGIC[4] = { 'B', 'C', 'I', 'X' };
+const uint16_t CAPTURE_INDEX_VERSION = 1;
+const size_t CAPTURE_INDEX_HEADER_SIZE = 8;
+const char* const CAPTURE_INDEX_EXTENSION = ".idx";
+
+enum CaptureIndexRecordKind {
+    INDEX_RECORD_ENTRY = 1,
+    INDEX_RECORD_APP_NAME = 2
+};
+
+struct IndexOptions {
+    bool enabled = false;
+    unsigned int interval = 1024;  // Records between entries
+};
+
+struct CaptureIndexEntry {
+    long long timestamp;
+    unsigned long long offset;
+    uint16_t appId;
+};
+
+// Appends entries while a log is written; owned by the log writer and used
+// under its lock
+class CaptureIndexWriter {
+private:
+    std::ofstream file;
+    IndexOptions options;
+    unsigned long long recordsSinceEntry;
+    std::vector<bool> appWritten;
+    std::vector<char> record;
+
+    void put(const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        record.insert(record.end(), bytes, bytes + size);
+    }
+
+    template <typename T>
+    void putLittleEndian(T value) {
+        for (size_t i = 0; i < sizeof(T); i++) {
+            record.push_back(static_cast<char>(static_cast<uint64_t>(value) >> (8 * i)));
+        }
+    }
+
+    void addAppNameRecord(uint16_t appId, const std::string& appName) {
+        const size_t length = appName.size() < 0xFFFF ? appName.size() : 0xFFFF;
+        record.push_back(static_cast<char>(INDEX_RECORD_APP_NAME));
+        putLittleEndian<uint16_t>(appId);
+        putLittleEndian<uint16_t>(static_cast<uint16_t>(length));
+        put(appName.data(), length);
+    }
+
+public:
+    CaptureIndexWriter() : recordsSinceEntry(0) {}
+
+    // logFilename is the log itself; the index goes to <logFilename>.idx
+    bool open(const std::string& logFilename, const IndexOptions& indexOptions) {
+        options = indexOptions;
+        if (options.interval == 0) options.interval = 1;
+        file.open(logFilename + CAPTURE_INDEX_EXTENSION, std::ios::app | std::ios::binary);
+        if (!file.is_open()) return false;
+
+        file.seekp(0, std::ios::end);
+        if (file.tellp() == 0) {
+            file.write(CAPTURE_INDEX_MAGIC, sizeof(CAPTURE_INDEX_MAGIC));
+            const char version[4] = { static_cast<char>(CAPTURE_INDEX_VERSION), static_cast<char>(CAPTURE_INDEX_VERSION >> 8), 0, 0 };
+            file.write(version, sizeof(version));
+        }
+        recordsSinceEntry = options.interval;  // First record of the session gets an entry
+        appWritten.clear();
+        return true;
+    }
+
+    bool isOpen() const {
+        return file.is_open();
+    }
+
+    // Call once per record before it is written; true when the caller
+    // should add an entry at the record's offset
+    bool entryDue() const {
+        return file.is_open() && recordsSinceEntry >= options.interval;
+    }
+
+    void countRecords(unsigned long long count) {
+        recordsSinceEntry += count;
+    }
+
+    // appName is only written the first time this session sees appId
+    void addEntry(long long timestamp, unsigned long long offset, uint16_t appId, const std::string& appName) {
+        record.clear();
+        if (appId >= appWritten.size()) appWritten.resize(appId + 1, false);
+        if (!appWritten[appId]) {
+            appWritten[appId] = true;
+            addAppNameRecord(appId, appName);
+        }
+        record.push_back(static_cast<char>(INDEX_RECORD_ENTRY));
+        putLittleEndian<uint64_t>(static_cast<uint64_t>(timestamp));
+        putLittleEndian<uint64_t>(offset);
+        putLittleEndian<uint16_t>(appId);
+        file.write(record.data(), record.size());
+        recordsSinceEntry = 0;
+    }
+
+    // Names an app ID that appears between entries (binary blocks)
+    void addAppName(uint16_t appId, const std::string& appName) {
+        if (appId < appWritten.size() && appWritten[appId]) return;
+        if (appId >= appWritten.size()) appWritten.resize(appId + 1, false);
+        appWritten[appId] = true;
+        record.clear();
+        addAppNameRecord(appId, appName);
+        file.write(record.data(), record.size());
+    }
+
+    void flush() {
+        if (file.is_open()) file.flush();
+    }
+
+    void close() {
+        if (file.is_open()) file.close();
+    }
+};
+
+// Loaded index with binary search by time
+class CaptureIndex {
+private:
+    std::vector<CaptureIndexEntry> entries;
+    std::unordered_map<uint16_t, std::string> appNames;
+    std::string error;
+
+    template <typename T>
+    static T readLittleEndian(const uint8_t* data) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < sizeof(T); i++) {
+            value |= static_cast<uint64_t>(data[i]) << (8 * i);
+        }
+        return static_cast<T>(value);
+    }
+
+    bool fail(const std::string& message) {
+        error = message;
+        return false;
+    }
+
+public:
+    // Reads <logFilename>.idx; a truncated last record (crash) is ignored
+    bool load(const std::string& logFilename) {
+        entries.clear();
+        appNames.clear();
+        const std::string path = logFilename + CAPTURE_INDEX_EXTENSION;
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return fail("Cannot open " + path);
+
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() < CAPTURE_INDEX_HEADER_SIZE || memcmp(data.data(), CAPTURE_INDEX_MAGIC, sizeof(CAPTURE_INDEX_MAGIC)) != 0) {
+            return fail("Not a capture index: " + path);
+        }
+        if (readLittleEndian<uint16_t>(data.data() + 4) > CAPTURE_INDEX_VERSION) {
+            return fail("Unsupported capture index version: " + path);
+        }
+
+        size_t pos = CAPTURE_INDEX_HEADER_SIZE;
+        while (pos < data.size()) {
+            const uint8_t kind = data[pos];
+            if (kind == INDEX_RECORD_ENTRY) {
+                if (data.size() - pos < 19) break;
+                CaptureIndexEntry entry;
+                entry.timestamp = static_cast<long long>(readLittleEndian<uint64_t>(data.data() + pos + 1));
+                entry.offset = readLittleEndian<uint64_t>(data.data() + pos + 9);
+                entry.appId = readLittleEndian<uint16_t>(data.data() + pos + 17);
+                entries.push_back(entry);
+                pos += 19;
+            }
+            else if (kind == INDEX_RECORD_APP_NAME) {
+                if (data.size() - pos < 5) break;
+                const uint16_t id = readLittleEndian<uint16_t>(data.data() + pos + 1);
+                const size_t length = readLittleEndian<uint16_t>(data.data() + pos + 3);
+                if (data.size() - pos - 5 < length) break;
+                appNames[id] = std::string(reinterpret_cast<const char*>(data.data() + pos + 5), length);
+                pos += 5 + length;
+            }
+            else {
+                return fail("Corrupt capture index: " + path);
+            }
+        }
+        return true;
+    }
+
+    // Offset of the last entry before fromMs, so every event from fromMs on
+    // lies after it; false when no entry is earlier (the caller starts at the
+    // beginning of the log)
+    bool findStart(long long fromMs, unsigned long long& offset) const {
+        auto it = std::lower_bound(entries.begin(), entries.end(), fromMs,
+            [](const CaptureIndexEntry& entry, long long value) { return entry.timestamp < value; });
+        if (it == entries.begin()) return false;
+        offset = (it - 1)->offset;
+        return true;
+    }
+
+    const std::vector<CaptureIndexEntry>& getEntries() const {
+        return entries;
+    }
+
+    const std::unordered_map<uint16_t, std::string>& getAppNames() const {
+        return appNames;
+    }
+
+    const std::string& getError() const {
+        return error;
+    }
+};
@@ -0,0 +1,67 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <set>
+#include <cstdlib>
+
+#include "CaptureLoader.h"
+
+// Loads CSV or binary capture files into columns with CaptureLoader and
+// reports load throughput, e.g. to size the reprocessing of a fleet's logs.
+int main(int argc, char* argv[]) {
+    std::vector<std::string> files;
+    unsigned int threads = 0;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<unsigned int>(std::atoi(argv[++i]));
+        }
+        else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        std::cerr << "Usage: CaptureLoad <capture.csv | capture.bclog>... [--threads N]" << std::endl;
+        return 1;
+    }
+
+    CaptureLoader loader(threads);
+    CaptureTable table;
+    unsigned long long totalBytes = 0, totalEvents = 0;
+    double totalSeconds = 0;
+    int failures = 0;
+
+    std::cout << std::fixed << std::setprecision(1);
+    for (const auto& file : files) {
+        const bool loaded = loader.load(file, table);
+        const LoadStats& stats = loader.getStats();
+        if (!loaded) {
+            std::cerr << file << ": " << loader.getError() << std::endl;
+            failures++;
+            continue;
+        }
+
+        std::cout << file << ": " << stats.events << " events, " << table.appNames.size() << " apps, "
+                  << stats.bytes / (1024.0 * 1024.0) << " MB in " << stats.seconds * 1000.0 << " ms ("
+                  << stats.megabytesPerSecond() << " MB/s, " << stats.threads << " threads, "
+                  << stats.chunks << " chunks)";
+        if (table.hasSessions) {
+            std::cout << ", " << std::set<uint32_t>(table.session.begin(), table.session.end()).size() << " sessions";
+        }
+        if (stats.skippedRows > 0) std::cout << ", " << stats.skippedRows << " lines skipped";
+        if (stats.truncated) std::cout << ", truncated";
+        std::cout << std::endl;
+
+        totalBytes += stats.bytes;
+        totalEvents += stats.events;
+        totalSeconds += stats.seconds;
+    }
+
+    if (files.size() > 1) {
+        std::cout << "Total: " << totalEvents << " events, " << totalBytes / (1024.0 * 1024.0) << " MB in "
+                  << totalSeconds * 1000.0 << " ms ("
+                  << (totalSeconds > 0 ? totalBytes / (1024.0 * 1024.0) / totalSeconds : 0.0) << " MB/s)" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,637 @@
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "BehavioralEvent.h"
+#include "BinaryLog.h"
+#include "CaptureTelemetry.h"
+
+// Bulk loader for offline analysis of capture files.
+//
+// The whole file is memory-mapped and decoded on every core into one
+// column per BehavioralEvent field:
+//   CSV     split into chunks at newline boundaries; a counting pass sizes
+//           the table, a parsing pass writes each chunk's rows in place
+//   binary  one serial walk over the block headers, then events blocks are
+//           decoded in parallel (each block is self-contained)
+// App names are interned per chunk and merged afterwards, so appId is an
+// index into CaptureTable::appNames, not the IDs of the capturing process.
+
+// Column-oriented copy of a capture. x/y hold dwellTime/flightTime and
+// wheelDelta holds repeatCount for KEY_UP rows, and keyCode holds the
+// monitor index for mouse rows, as in BehavioralEvent. session holds the
+// Windows session of each row of a CaptureService log, 0 elsewhere.
+struct CaptureTable {
+    std::vector<long long> timestamp;
+    std::vector<uint8_t> type;
+    std::vector<int32_t> x;
+    std::vector<int32_t> y;
+    std::vector<float> mouseSpeed;
+    std::vector<uint32_t> timeSinceLast;
+    std::vector<uint16_t> appId;
+    std::vector<uint16_t> backgroundAppCount;
+    std::vector<int16_t> wheelDelta;
+    std::vector<uint8_t> keyCode;
+    std::vector<uint32_t> session;
+    std::vector<std::string> appNames;  // Indexed by appId; binary logs start with "Unknown"
+    bool hasSessions = false;           // The log carried session blocks
+
+    size_t size() const { return type.size(); }
+
+    void resize(size_t count) {
+        timestamp.resize(count);
+        type.resize(count);
+        x.resize(count);
+        y.resize(count);
+        mouseSpeed.resize(count);
+        timeSinceLast.resize(count);
+        appId.resize(count);
+        backgroundAppCount.resize(count);
+        wheelDelta.resize(count);
+        keyCode.resize(count);
+        session.resize(count);
+    }
+
+    void clear() {
+        resize(0);
+        appNames.clear();
+        hasSessions = false;
+    }
+
+    void set(size_t row, const BehavioralEvent& event) {
+        timestamp[row] = event.timestamp;
+        type[row] = event.type;
+        x[row] = event.x;
+        y[row] = event.y;
+        mouseSpeed[row] = event.mouseSpeed;
+        timeSinceLast[row] = event.timeSinceLast;
+        appId[row] = event.appId;
+        backgroundAppCount[row] = event.backgroundAppCount;
+        wheelDelta[row] = event.wheelDelta;
+        keyCode[row] = event.keyCode;
+    }
+
+    BehavioralEvent get(size_t row) const {
+        BehavioralEvent event = {};
+        event.timestamp = timestamp[row];
+        event.type = type[row];
+        event.x = x[row];
+        event.y = y[row];
+        event.mouseSpeed = mouseSpeed[row];
+        event.timeSinceLast = timeSinceLast[row];
+        event.appId = appId[row];
+        event.backgroundAppCount = backgroundAppCount[row];
+        event.wheelDelta = wheelDelta[row];
+        event.keyCode = keyCode[row];
+        return event;
+    }
+
+    const std::string& appName(size_t row) const {
+        return appNames[appId[row]];
+    }
+
+    // Moves count rows from `from` down to `to` (to <= from)
+    void moveRows(size_t to, size_t from, size_t count) {
+        if (to == from || count == 0) return;
+        moveColumn(timestamp, to, from, count);
+        moveColumn(type, to, from, count);
+        moveColumn(x, to, from, count);
+        moveColumn(y, to, from, count);
+        moveColumn(mouseSpeed, to, from, count);
+        moveColumn(timeSinceLast, to, from, count);
+        moveColumn(appId, to, from, count);
+        moveColumn(backgroundAppCount, to, from, count);
+        moveColumn(wheelDelta, to, from, count);
+        moveColumn(keyCode, to, from, count);
+        moveColumn(session, to, from, count);
+    }
+
+private:
+    template <typename T>
+    static void moveColumn(std::vector<T>& column, size_t to, size_t from, size_t count) {
+        memmove(column.data() + to, column.data() + from, count * sizeof(T));
+    }
+};
+
+struct LoadStats {
+    unsigned long long bytes = 0;
+    unsigned long long events = 0;
+    unsigned long long skippedRows = 0;  // CSV header and malformed lines
+    unsigned int threads = 0;
+    size_t chunks = 0;                   // CSV chunks or binary events blocks
+    bool truncated = false;              // Binary log cut mid-block (crash); complete blocks were kept
+    double seconds = 0;
+
+    double megabytesPerSecond() const {
+        return seconds > 0 ? bytes / (1024.0 * 1024.0) / seconds : 0;
+    }
+};
+
+// Read-only mapping of a whole file
+class MappedFile {
+private:
+    HANDLE file;
+    HANDLE mapping;
+    const uint8_t* view;
+    size_t length;
+
+public:
+    MappedFile() : file(INVALID_HANDLE_VALUE), mapping(NULL), view(nullptr), length(0) {}
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+            NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            close();
+            return false;
+        }
+        length = static_cast<size_t>(size.QuadPart);
+        if (length == 0) return true;  // Nothing to map
+
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            view = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (view == nullptr) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (view) {
+            UnmapViewOfFile(view);
+            view = nullptr;
+        }
+        if (mapping != NULL) {
+            CloseHandle(mapping);
+            mapping = NULL;
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+        }
+        length = 0;
+    }
+
+    const uint8_t* data() const { return view; }
+    size_t size() const { return length; }
+};
+
+class CaptureLoader {
+private:
+    unsigned int threadCount;
+    LoadStats stats;
+    std::string error;
+    QpcClock clock;
+
+    const size_t MIN_CSV_CHUNK_BYTES = 1024 * 1024;
+
+    bool fail(const std::string& message) {
+        error = message;
+        return false;
+    }
+
+    // Runs work(i) for i in [0, count) on up to threadCount threads
+    template <typename Work>
+    void parallelFor(size_t count, Work work) {
+        const unsigned int workers = static_cast<unsigned int>(std::min<size_t>(threadCount, count));
+        if (workers <= 1) {
+            for (size_t i = 0; i < count; i++) work(i);
+            return;
+        }
+
+        std::atomic<size_t> nextItem(0);
+        auto worker = [&]() {
+            for (size_t i = nextItem.fetch_add(1); i < count; i = nextItem.fetch_add(1)) work(i);
+        };
+        std::vector<std::thread> pool;
+        pool.reserve(workers - 1);
+        for (unsigned int t = 1; t < workers; t++) pool.emplace_back(worker);
+        worker();
+        for (auto& thread : pool) thread.join();
+    }
+
+    struct CsvChunk {
+        size_t begin;
+        size_t end;
+        size_t firstRow;  // Where this chunk's rows go in the table
+        size_t lines;
+        size_t rows;      // Lines that parsed
+        std::vector<std::string> appNames;  // Chunk-local app IDs
+    };
+
+    static bool parseInteger(const char*& p, const char* end, long long& value) {
+        const bool negative = p < end && *p == '-';
+        if (negative) p++;
+        if (p == end || *p < '0' || *p > '9') return false;
+        long long result = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            result = result * 10 + (*p++ - '0');
+        }
+        value = negative ? -result : result;
+        return true;
+    }
+
+    // Integer field followed by a comma (or the end of the line when last)
+    static bool integerField(const char*& p, const char* end, long long& value, bool last = false) {
+        if (!parseInteger(p, end, value)) return false;
+        if (p < end && *p == ',') {
+            p++;
+            return true;
+        }
+        return last && p == end;
+    }
+
+    // Fixed-point decimal as written by CsvBlock ("1716.15")
+    static bool parseDecimal(const char*& p, const char* end, float& value) {
+        long long whole;
+        if (!parseInteger(p, end, whole)) return false;
+        double result = static_cast<double>(whole < 0 ? -whole : whole);
+        if (p < end && *p == '.') {
+            p++;
+            double scale = 0.1;
+            while (p < end && *p >= '0' && *p <= '9') {
+                result += (*p++ - '0') * scale;
+                scale *= 0.1;
+            }
+        }
+        value = static_cast<float>(whole < 0 ? -result : result);
+        return true;
+    }
+
+    // Optional key timing column: empty means KEY_TIMING_NONE
+    static bool timingField(const char*& p, const char* end, int32_t& value) {
+        value = KEY_TIMING_NONE;
+        if (p == end) return true;  // Column absent (pre key-timing logs)
+        if (*p == ',') {
+            p++;
+            return true;
+        }
+        long long parsed;
+        if (!integerField(p, end, parsed, true)) return false;
+        value = static_cast<int32_t>(parsed);
+        return true;
+    }
+
+    // Optional integer column: value is left alone when it is absent or empty
+    static bool optionalField(const char*& p, const char* end, long long& value) {
+        if (p == end) return true;
+        if (*p == ',') {
+            p++;
+            return true;
+        }
+        return integerField(p, end, value, true);
+    }
+
+    // One data row into event; app name returned as a range of the line
+    static bool parseCsvRow(const char* p, const char* end, BehavioralEvent& event,
+                            const char*& appBegin, const char*& appEnd) {
+        long long timestamp, type, x, y, keyCode, wheelDelta, timeSinceLast, background;
+        if (!integerField(p, end, timestamp) || !integerField(p, end, type) ||
+            !integerField(p, end, x) || !integerField(p, end, y) ||
+            !integerField(p, end, keyCode) || !integerField(p, end, wheelDelta) ||
+            !integerField(p, end, timeSinceLast)) {
+            return false;
+        }
+        if (type < 0 || type >= EVENT_TYPE_COUNT) return false;
+
+        appBegin = p;
+        const char* comma = static_cast<const char*>(memchr(p, ',', end - p));
+        if (!comma) return false;
+        appEnd = comma;
+        p = comma + 1;
+
+        if (!integerField(p, end, background)) return false;
+        float speed;
+        if (!parseDecimal(p, end, speed)) return false;
+
+        event = {};
+        event.timestamp = timestamp;
+        event.type = static_cast<uint8_t>(type);
+        event.x = static_cast<int32_t>(x);
+        event.y = static_cast<int32_t>(y);
+        event.keyCode = static_cast<uint8_t>(keyCode);
+        event.wheelDelta = static_cast<int16_t>(wheelDelta);
+        event.timeSinceLast = static_cast<uint32_t>(timeSinceLast);
+        event.backgroundAppCount = static_cast<uint16_t>(background);
+        event.mouseSpeed = speed;
+
+        if (p == end) {
+            if (event.type == KEY_UP) event.dwellTime = event.flightTime = KEY_TIMING_NONE;
+            if (event.type <= MOUSE_WHEEL) event.monitor = MONITOR_NONE;
+            return true;
+        }
+        if (*p++ != ',') return false;
+        int32_t dwell, flight;
+        if (!timingField(p, end, dwell) || !timingField(p, end, flight)) return false;
+        long long repeats = 0, monitor = MONITOR_NONE;  // Columns absent (older logs) or empty
+        if (!optionalField(p, end, repeats) || !optionalField(p, end, monitor)) return false;
+        if (event.type == KEY_UP) {
+            event.dwellTime = dwell;
+            event.flightTime = flight;
+            event.repeatCount = static_cast<uint16_t>(repeats);
+        }
+        else if (event.type <= MOUSE_WHEEL) {
+            event.monitor = static_cast<uint8_t>(monitor);
+        }
+        return true;  // The normalized columns are derived from the monitor, not loaded
+    }
+
+    static size_t countLines(const char* begin, const char* end) {
+        size_t lines = 0;
+        for (const char* p = begin; p < end; p++) {
+            p = static_cast<const char*>(memchr(p, '\n', end - p));
+            if (!p) return lines + 1;  // Last line without a newline
+            lines++;
+        }
+        return lines;
+    }
+
+    void parseCsvChunk(const char* text, CsvChunk& chunk, CaptureTable& table) {
+        std::unordered_map<std::string, uint16_t> localIds;
+        std::string name;
+        size_t row = chunk.firstRow;
+        const char* p = text + chunk.begin;
+        const char* chunkEnd = text + chunk.end;
+
+        while (p < chunkEnd) {
+            const char* newline = static_cast<const char*>(memchr(p, '\n', chunkEnd - p));
+            const char* lineEnd = newline ? newline : chunkEnd;
+            const char* next = newline ? newline + 1 : chunkEnd;
+            if (lineEnd > p && lineEnd[-1] == '\r') lineEnd--;
+
+            BehavioralEvent event;
+            const char* appBegin;
+            const char* appEnd;
+            if (parseCsvRow(p, lineEnd, event, appBegin, appEnd)) {
+                name.assign(appBegin, appEnd);
+                auto it = localIds.find(name);
+                if (it == localIds.end()) {
+                    it = localIds.emplace(name, static_cast<uint16_t>(chunk.appNames.size())).first;
+                    chunk.appNames.push_back(name);
+                }
+                event.appId = it->second;
+                table.set(row++, event);
+            }
+            p = next;
+        }
+        chunk.rows = row - chunk.firstRow;
+    }
+
+    bool loadCsv(const char* text, size_t size, CaptureTable& table) {
+        // Chunk boundaries just past a newline
+        const size_t target = std::max<size_t>(1, std::min<size_t>(threadCount * 4, size / MIN_CSV_CHUNK_BYTES + 1));
+        std::vector<CsvChunk> chunks;
+        size_t begin = 0;
+        for (size_t k = 1; k <= target && begin < size; k++) {
+            size_t end = k == target ? size : (std::max)(begin, size / target * k);
+            if (end < size) {
+                const char* newline = static_cast<const char*>(memchr(text + end, '\n', size - end));
+                end = newline ? static_cast<size_t>(newline - text) + 1 : size;
+            }
+            CsvChunk chunk = {};
+            chunk.begin = begin;
+            chunk.end = end;
+            chunks.push_back(chunk);
+            begin = end;
+        }
+        stats.chunks = chunks.size();
+
+        parallelFor(chunks.size(), [&](size_t k) {
+            chunks[k].lines = countLines(text + chunks[k].begin, text + chunks[k].end);
+        });
+        size_t lines = 0;
+        for (auto& chunk : chunks) {
+            chunk.firstRow = lines;
+            lines += chunk.lines;
+        }
+        table.resize(lines);
+
+        parallelFor(chunks.size(), [&](size_t k) {
+            parseCsvChunk(text, chunks[k], table);
+        });
+
+        // Merge the chunk dictionaries, then remap and close the gaps left
+        // by skipped lines
+        std::unordered_map<std::string, uint16_t> globalIds;
+        std::vector<std::vector<uint16_t>> remap(chunks.size());
+        for (size_t k = 0; k < chunks.size(); k++) {
+            for (const auto& name : chunks[k].appNames) {
+                auto it = globalIds.find(name);
+                if (it == globalIds.end()) {
+                    if (table.appNames.size() > 0xFFFF) return fail("More than 65536 distinct apps");
+                    it = globalIds.emplace(name, static_cast<uint16_t>(table.appNames.size())).first;
+                    table.appNames.push_back(name);
+                }
+                remap[k].push_back(it->second);
+            }
+        }
+        parallelFor(chunks.size(), [&](size_t k) {
+            const std::vector<uint16_t>& ids = remap[k];
+            for (size_t row = chunks[k].firstRow; row < chunks[k].firstRow + chunks[k].rows; row++) {
+                table.appId[row] = ids[table.appId[row]];
+            }
+        });
+
+        size_t rows = 0;
+        for (const auto& chunk : chunks) {
+            table.moveRows(rows, chunk.firstRow, chunk.rows);
+            rows += chunk.rows;
+        }
+        table.resize(rows);
+        stats.skippedRows = lines - rows;
+        return true;
+    }
+
+    struct EventsBlock {
+        size_t offset;     // Payload start in the file
+        size_t length;
+        uint8_t type;
+        size_t firstRow;
+        size_t dictionary;  // Index into the app ID snapshots
+        uint32_t session;   // From the last session block before it
+    };
+
+    // Writes decoded events straight into the table, translating app IDs
+    struct TableRows {
+        CaptureTable* table;
+        size_t row;
+        const std::vector<uint16_t>* ids;
+        uint16_t unknownApp;
+        uint32_t session;
+
+        void push_back(BehavioralEvent event) {
+            event.appId = event.appId < ids->size() ? (*ids)[event.appId] : unknownApp;
+            table->session[row] = session;
+            table->set(row++, event);
+        }
+    };
+
+    bool loadBinary(const uint8_t* data, size_t size, CaptureTable& table) {
+        if (size < BINARY_LOG_HEADER_SIZE || memcmp(data, BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC)) != 0) {
+            return fail("Not a binary capture log");
+        }
+        if (BinaryCodec::readUint16(data + 4) > BINARY_LOG_VERSION) {
+            return fail("Unsupported binary log version");
+        }
+
+        // Dictionaries are scoped to a writer session, so each events block
+        // keeps the file-ID -> table-ID mapping in force where it was written
+        std::unordered_map<std::string, uint16_t> globalIds;
+        auto intern = [&](const std::string& name) {
+            auto it = globalIds.find(name);
+            if (it == globalIds.end()) {
+                it = globalIds.emplace(name, static_cast<uint16_t>(table.appNames.size())).first;
+                table.appNames.push_back(name);
+            }
+            return it->second;
+        };
+        const uint16_t unknownApp = intern("Unknown");
+        std::vector<std::vector<uint16_t>> dictionaries(1);
+        bool dictionaryUsed = false;
+
+        std::vector<EventsBlock> blocks;
+        size_t rows = 0;
+        uint32_t session = 0;
+        size_t pos = BINARY_LOG_HEADER_SIZE;
+        while (pos < size) {
+            if (size - pos < BINARY_BLOCK_HEADER_SIZE) {
+                stats.truncated = true;
+                break;
+            }
+            const uint8_t type = data[pos];
+            const uint32_t length = BinaryCodec::readUint32(data + pos + 1);
+            const size_t payload = pos + BINARY_BLOCK_HEADER_SIZE;
+            if (size - payload < length) {
+                stats.truncated = true;
+                break;
+            }
+            pos = payload + length;
+
+            if (type == BLOCK_APP_DICTIONARY) {
+                if (dictionaryUsed) {
+                    dictionaries.push_back(dictionaries.back());
+                    dictionaryUsed = false;
+                }
+                std::vector<uint16_t>& ids = dictionaries.back();
+                size_t at = 0;
+                uint64_t count;
+                if (!BinaryCodec::getVarint(data + payload, length, at, count)) return fail("Truncated app dictionary");
+                for (uint64_t i = 0; i < count; i++) {
+                    uint64_t id, nameLength;
+                    if (!BinaryCodec::getVarint(data + payload, length, at, id) ||
+                        !BinaryCodec::getVarint(data + payload, length, at, nameLength) ||
+                        nameLength > length - at || id > 0xFFFF) {
+                        return fail("Truncated app dictionary entry");
+                    }
+                    if (id >= ids.size()) ids.resize(static_cast<size_t>(id) + 1, unknownApp);
+                    ids[static_cast<size_t>(id)] = intern(std::string(reinterpret_cast<const char*>(data + payload + at),
+                        static_cast<size_t>(nameLength)));
+                    at += static_cast<size_t>(nameLength);
+                }
+            }
+            else if (type == BLOCK_SESSION) {
+                size_t at = 0;
+                uint64_t id, userLength;
+                if (!BinaryCodec::getVarint(data + payload, length, at, id) ||
+                    !BinaryCodec::getVarint(data + payload, length, at, userLength) ||
+                    userLength > length - at) {
+                    return fail("Truncated session block");
+                }
+                session = static_cast<uint32_t>(id);
+                table.hasSessions = true;
+            }
+            else if (BinaryCodec::isEventsBlock(type)) {
+                size_t at = 0;
+                uint64_t count;
+                if (!BinaryCodec::getVarint(data + payload, length, at, count)) return fail("Truncated events block");
+                if (count > length) return fail("Corrupt events block");  // Every record takes at least one byte
+                EventsBlock block;
+                block.offset = payload;
+                block.length = length;
+                block.type = type;
+                block.firstRow = rows;
+                block.dictionary = dictionaries.size() - 1;
+                block.session = session;
+                blocks.push_back(block);
+                dictionaryUsed = true;
+                rows += static_cast<size_t>(count);
+            }
+            // Unknown block types from a newer writer are skipped
+        }
+        if (table.appNames.size() > 0x10000) return fail("More than 65536 distinct apps");
+        stats.chunks = blocks.size();
+        table.resize(rows);
+
+        std::atomic<const char*> problem(nullptr);
+        parallelFor(blocks.size(), [&](size_t k) {
+            const EventsBlock& block = blocks[k];
+            TableRows out = { &table, block.firstRow, &dictionaries[block.dictionary], unknownApp, block.session };
+            if (const char* message = BinaryCodec::decodeEvents(data + block.offset, block.length, block.type, out)) {
+                problem.store(message, std::memory_order_relaxed);
+            }
+        });
+        if (const char* message = problem.load()) return fail(message);
+        return true;
+    }
+
+public:
+    // threads = 0 uses every core
+    explicit CaptureLoader(unsigned int threads = 0) :
+        threadCount(threads > 0 ? threads : (std::max)(1u, std::thread::hardware_concurrency())) {}
+
+    // Replaces table with the contents of a CSV or binary (.bclog) capture;
+    // the format is taken from the file's magic, not its name
+    bool load(const std::string& filename, CaptureTable& table) {
+        table.clear();
+        stats = LoadStats();
+        stats.threads = threadCount;
+        error.clear();
+        const long long started = QpcClock::now();
+
+        MappedFile file;
+        if (!file.open(filename)) return fail("Cannot open " + filename);
+        stats.bytes = file.size();
+
+        bool loaded = true;
+        if (file.size() >= sizeof(BINARY_LOG_MAGIC) && memcmp(file.data(), BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC)) == 0) {
+            loaded = loadBinary(file.data(), file.size(), table);
+        }
+        else if (file.size() > 0) {
+            loaded = loadCsv(reinterpret_cast<const char*>(file.data()), file.size(), table);
+        }
+
+        stats.events = table.size();
+        stats.seconds = clock.toNs(QpcClock::now() - started) / 1e9;
+        return loaded;
+    }
+
+    const LoadStats& getStats() const {
+        return stats;
+    }
+
+    const std::string& getError() const {
+        return error;
+    }
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <winsock2.h>  // Before windows.h, see NetworkSink.h
+#include <windows.h>
+#include <string>
+
+#include "FileOutput.h"
+#include "EventJournal.h"
+#include "LogRotation.h"
+#include "CaptureIndex.h"
+#include "NetworkSink.h"
+#include "SinkPipeline.h"
+#include "ProcessCounter.h"
+#include "HookThread.h"
+#include "MouseDecimator.h"
+#include "WheelCoalescer.h"
+#include "FeatureExtractor.h"
+#include "IdleMonitor.h"
+#include "SessionRing.h"
+
+// Where addEvent() runs
+enum CaptureMode {
+    CAPTURE_MODE_SYNC,  // Formatting and I/O inline on the hook thread (legacy)
+    CAPTURE_MODE_RING   // Hook only enqueues, a drainer thread formats and writes
+};
+
+// Where mouse and keyboard input comes from
+enum InputBackend {
+    INPUT_BACKEND_HOOKS,     // WH_MOUSE_LL/WH_KEYBOARD_LL callbacks, see HookThread
+    INPUT_BACKEND_RAW_INPUT  // WM_INPUT read in batches on its own thread, see RawInputReader
+};
+
+// How the active application is kept up to date
+enum ForegroundTracking {
+    FOREGROUND_TRACKING_POLL,   // Context thread checks every contextUpdateIntervalMs
+    FOREGROUND_TRACKING_EVENTS  // EVENT_SYSTEM_FOREGROUND WinEvent hook, updated on each switch
+};
+
+// On-disk format of the capture log
+enum LogFormat {
+    LOG_FORMAT_CSV,     // Text rows, one per event
+    LOG_FORMAT_BINARY,  // Compact .bclog blocks, see BinaryLog.h
+    LOG_FORMAT_JOURNAL  // Memory-mapped .bcj segments, crash-safe, see EventJournal.h
+};
+
+struct CaptureOptions {
+    CaptureMode mode = CAPTURE_MODE_RING;
+    InputBackend inputBackend = INPUT_BACKEND_HOOKS;
+    LogFormat logFormat = LOG_FORMAT_CSV;
+    ForegroundTracking foregroundTracking = FOREGROUND_TRACKING_EVENTS;
+    ProcessCountProvider processCountProvider = PROCESS_COUNT_NTQUERY;
+    bool installHooks = true;  // False drives the pipeline only through inject*Event()
+    HookThreadOptions hookThread;  // Where the low-level hooks run (INPUT_BACKEND_HOOKS)
+    int quitKey = 0;               // Virtual key whose press posts WM_QUIT to quitThreadId, 0 = none
+    DWORD quitThreadId = 0;
+    bool monitorGeometry = true;   // Cached monitor table for the monitor, normalized and mm/s columns
+    DecimationOptions decimation;  // Applied to mouse moves before they are stored
+    WheelCoalescingOptions wheelCoalescing;  // Merges wheel bursts after decimation
+    FeatureOptions features;       // Per-window feature rows, off unless features.windowMs > 0
+    std::string featureFile;       // Empty: <log name>.features.csv next to the event log
+    bool writeEventLog = true;     // False keeps only features (and the in-memory history)
+    bool recordedTime = false;     // Replay: stage deadlines follow record timestamps, not the wall clock,
+                                   // and the host's foreground app and process count are not sampled
+    IdleOptions idle;              // When context polling and the writers' timed flushes pause
+
+    // Live telemetry (see TelemetryBlock); an empty name disables shared memory
+    std::string telemetrySharedMemoryName = "Local\\BehavioralCaptureTelemetry";
+    int telemetryIntervalMs = 1000;
+    int statsLineIntervalMs = 0;  // Print a one-line summary this often, 0 = off
+    size_t ringCapacity = 16384;  // Records, rounded up to a power of two
+    size_t historyCapacity = 50000;  // Most recent events kept in memory
+    int contextUpdateIntervalMs = 500;  // Process count refresh (and foreground polling)
+    int drainIntervalMs = 5;            // Drainer sleep while the ring is empty
+    size_t csvFlushRows = 100;          // CSV rows per write
+    size_t binaryBlockEvents = 256;     // Events per .bclog block
+    WriterBackend writerBackend = WRITER_BACKEND_STREAM;
+    OverlappedWriterOptions overlappedWriter;  // Used with WRITER_BACKEND_OVERLAPPED
+    JournalOptions journal;  // Used with LOG_FORMAT_JOURNAL
+    RotationOptions rotation;  // CSV and binary logs; a journal only takes maxBytes as its segment size
+    IndexOptions index;  // Sparse <log>.idx time index for CSV and binary logs
+    NetworkOptions network;  // Streaming to a collector, off unless network.host is set
+    PipelineOptions pipeline;  // Per-sink queues and writer threads behind addEvent()
+    SessionRingOptions sessionRing;  // Agent mode: CaptureService writes the log, see SessionRing.h
+    std::string profileName = "default";  // Reported with the statistics, see CaptureProfile.h
+};
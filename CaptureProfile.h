@@ -0,0 +1,341 @@
+#pragma once
+
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "CaptureOptions.h"
+
+// Capture profiles: named presets for the settings that drive overhead,
+// and key = value profile files, so a fleet can be tuned without a rebuild.
+//
+// Built-in profiles (--profile NAME, or "profile = NAME" in a file):
+//   low-overhead   binary log, 60 Hz move cap, coarse context polling,
+//                  small history, large write batches, idle after 30 s
+//   balanced       the CaptureOptions defaults
+//   full-fidelity  every move kept, no wheel coalescing, 100 ms context
+//                  polling, large history
+//   default        the same settings as balanced, under the name a run
+//                  without a profile reports
+// A profile only sets the fields listed in copyProfileSettings() (plus the
+// format for low-overhead); anything set before it outside them is kept.
+//
+// Profile file (--config FILE): one "key = value" per line, '#' starts a
+// comment. Lines apply in order, so "profile = ..." belongs at the top.
+// The keys are those of applyCaptureSetting(); describeCaptureSettings()
+// prints the cost-related ones in the same syntax, one per line, profile
+// first, so its output is itself a valid profile file. Integer settings
+// are range-checked (see integerSettingRange()), so a value that would
+// spin a thread or not fit its field is rejected, not clamped.
+
+inline void copyProfileSettings(const CaptureOptions& from, CaptureOptions& to) {
+    to.decimation = from.decimation;
+    to.wheelCoalescing = from.wheelCoalescing;
+    to.contextUpdateIntervalMs = from.contextUpdateIntervalMs;
+    to.drainIntervalMs = from.drainIntervalMs;
+    to.ringCapacity = from.ringCapacity;
+    to.historyCapacity = from.historyCapacity;
+    to.csvFlushRows = from.csvFlushRows;
+    to.binaryBlockEvents = from.binaryBlockEvents;
+    to.pipeline.batchEvents = from.pipeline.batchEvents;
+    to.pipeline.batchIntervalMs = from.pipeline.batchIntervalMs;
+    to.telemetryIntervalMs = from.telemetryIntervalMs;
+    to.idle = from.idle;
+}
+
+// Returns false for an unknown name
+inline bool applyCaptureProfile(const std::string& name, CaptureOptions& options) {
+    CaptureOptions preset;
+    if (name == "low-overhead") {
+        preset.decimation.policy = DECIMATE_MAX_RATE;
+        preset.decimation.maxRateHz = 60;
+        preset.wheelCoalescing.windowMs = 250;
+        preset.contextUpdateIntervalMs = 2000;
+        preset.drainIntervalMs = 20;
+        preset.ringCapacity = 8192;
+        preset.historyCapacity = 10000;
+        preset.csvFlushRows = 1000;
+        preset.binaryBlockEvents = 1024;
+        preset.pipeline.batchEvents = 1024;
+        preset.pipeline.batchIntervalMs = 500;
+        preset.telemetryIntervalMs = 5000;
+        preset.idle.idleAfterMs = 30000;
+    }
+    else if (name == "full-fidelity") {
+        preset.decimation.policy = DECIMATE_NONE;
+        preset.wheelCoalescing.enabled = false;
+        preset.contextUpdateIntervalMs = 100;
+        preset.drainIntervalMs = 1;
+        preset.ringCapacity = 65536;
+        preset.historyCapacity = 200000;
+    }
+    else if (name != "balanced" && name != "default") {
+        return false;
+    }
+
+    copyProfileSettings(preset, options);
+    if (name == "low-overhead") options.logFormat = LOG_FORMAT_BINARY;
+    options.profileName = name;
+    return true;
+}
+
+inline const char* logFormatName(LogFormat format) {
+    switch (format) {
+    case LOG_FORMAT_BINARY: return "binary";
+    case LOG_FORMAT_JOURNAL: return "journal";
+    default: return "csv";
+    }
+}
+
+inline const char* decimationPolicyName(DecimationPolicy policy) {
+    switch (policy) {
+    case DECIMATE_NONE: return "none";
+    case DECIMATE_EVERY_NTH: return "nth";
+    case DECIMATE_MAX_RATE: return "rate";
+    case DECIMATE_DISTANCE: return "distance";
+    default: return "trajectory";
+    }
+}
+
+// key=value lines in the profile file syntax, each prefixed by indent
+inline std::string describeCaptureSettings(const CaptureOptions& options, const std::string& indent = std::string()) {
+    std::ostringstream out;
+    out << indent << "profile=" << options.profileName << "\n";
+    out << indent << "format=" << logFormatName(options.logFormat) << "\n";
+    out << indent << "mode=" << (options.mode == CAPTURE_MODE_RING ? "ring" : "sync") << "\n";
+    out << indent << "input=" << (options.inputBackend == INPUT_BACKEND_RAW_INPUT ? "raw" : "hooks") << "\n";
+    out << indent << "monitor_geometry=" << (options.monitorGeometry ? "on" : "off") << "\n";
+    out << indent << "writer=" << (options.writerBackend == WRITER_BACKEND_OVERLAPPED ? "overlapped" : "stream") << "\n";
+    out << indent << "ring_records=" << options.ringCapacity << "\n";
+    out << indent << "history_events=" << options.historyCapacity << "\n";
+    out << indent << "context_update_ms=" << options.contextUpdateIntervalMs << "\n";
+    out << indent << "drain_interval_ms=" << options.drainIntervalMs << "\n";
+    out << indent << "csv_flush_rows=" << options.csvFlushRows << "\n";
+    out << indent << "binary_block_events=" << options.binaryBlockEvents << "\n";
+    out << indent << "decimation=" << decimationPolicyName(options.decimation.policy) << "\n";
+    out << indent << "decimation_nth=" << options.decimation.everyNth << "\n";
+    out << indent << "decimation_rate_hz=" << options.decimation.maxRateHz << "\n";
+    out << indent << "decimation_distance_px=" << options.decimation.minDistancePx << "\n";
+    out << indent << "decimation_tolerance_px=" << options.decimation.tolerancePx << "\n";
+    out << indent << "wheel_coalescing=" << (options.wheelCoalescing.enabled ? "on" : "off") << "\n";
+    out << indent << "wheel_window_ms=" << options.wheelCoalescing.windowMs << "\n";
+    out << indent << "features_ms=" << options.features.windowMs << "\n";
+    out << indent << "pipeline=" << (options.pipeline.enabled ? "on" : "off") << "\n";
+    out << indent << "pipeline_batch_events=" << options.pipeline.batchEvents << "\n";
+    out << indent << "pipeline_batch_ms=" << options.pipeline.batchIntervalMs << "\n";
+    out << indent << "sink_queue_batches=" << options.pipeline.queueBatches << "\n";
+    out << indent << "telemetry_interval_ms=" << options.telemetryIntervalMs << "\n";
+    out << indent << "idle_after_ms=" << options.idle.idleAfterMs << "\n";
+    out << indent << "idle_session_events=" << (options.idle.sessionEvents ? "on" : "off") << "\n";
+    out << indent << "session_agent=" << (options.sessionRing.enabled ? "on" : "off") << "\n";
+    return out.str();
+}
+
+// Parsers for setting values; false leaves the target unchanged
+inline bool parseSettingNumber(const std::string& text, long long& value) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    const long long parsed = std::strtoll(text.c_str(), &end, 10);
+    if (*end != '\0' || parsed < 0) return false;
+    value = parsed;
+    return true;
+}
+
+inline bool parseSettingDecimal(const std::string& text, double& value) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    const double parsed = std::strtod(text.c_str(), &end);
+    if (*end != '\0' || parsed < 0) return false;
+    value = parsed;
+    return true;
+}
+
+inline bool parseSettingSwitch(const std::string& text, bool& value) {
+    if (text == "on" || text == "true" || text == "1") value = true;
+    else if (text == "off" || text == "false" || text == "0") value = false;
+    else return false;
+    return true;
+}
+
+// Accepted values of an integer setting
+struct SettingRange {
+    long long min;
+    long long max;
+    bool zeroMeansOff;  // 0 is accepted below min
+};
+
+// False for a key that is not an integer setting. The minimums keep the
+// polling loops from spinning; the maximums keep values within their field.
+inline bool integerSettingRange(const std::string& key, SettingRange& range) {
+    const long long sizeLimit = 1ll << 30;
+    if (key == "ring_records") range = { 16, sizeLimit, false };
+    else if (key == "history_events") range = { 1, sizeLimit, false };
+    else if (key == "context_update_ms") range = { 10, INT_MAX, false };
+    else if (key == "drain_interval_ms") range = { 1, INT_MAX, false };
+    else if (key == "csv_flush_rows") range = { 1, sizeLimit, false };
+    else if (key == "binary_block_events") range = { 1, static_cast<long long>(BINARY_MAX_BLOCK_EVENTS), false };
+    else if (key == "decimation_nth") range = { 1, INT_MAX, false };
+    else if (key == "decimation_rate_hz") range = { 1, 100000, false };
+    else if (key == "wheel_window_ms") range = { 1, INT_MAX, false };
+    else if (key == "features_ms") range = { 10, INT_MAX, true };
+    else if (key == "pipeline_batch_events") range = { 1, sizeLimit, false };
+    else if (key == "pipeline_batch_ms") range = { 1, INT_MAX, false };
+    else if (key == "sink_queue_batches") range = { 1, sizeLimit, false };
+    else if (key == "telemetry_interval_ms") range = { 10, INT_MAX, false };
+    else if (key == "stats_interval_ms") range = { 100, INT_MAX, true };
+    else if (key == "idle_after_ms") range = { 1000, INT_MAX, true };
+    else if (key == "session_ring_slots") range = { 64, sizeLimit, false };
+    else if (key == "rotate_mb") range = { 1, 1ll << 20, true };
+    else if (key == "rotate_minutes") range = { 1, 60 * 24 * 366, true };
+    else if (key == "index_interval") range = { 1, INT_MAX, true };
+    else if (key == "journal_flush_ms") range = { 10, INT_MAX, true };
+    else if (key == "network_batch_events") range = { 1, 1ll << 20, false };
+    else if (key == "spool_mb") range = { 1, 1ll << 20, true };
+    else return false;
+    return true;
+}
+
+// Applies one setting; outputFile receives "output". Returns false for an
+// unknown key or a value it cannot use.
+inline bool applyCaptureSetting(const std::string& key, const std::string& value,
+                                CaptureOptions& options, std::string& outputFile) {
+    long long number = 0;
+    double decimal = 0;
+    bool enabled = false;
+
+    if (key == "profile") return applyCaptureProfile(value, options);
+    if (key == "output") {
+        if (value.empty()) return false;
+        outputFile = value;
+        return true;
+    }
+    if (key == "format") {
+        if (value == "csv") options.logFormat = LOG_FORMAT_CSV;
+        else if (value == "binary") options.logFormat = LOG_FORMAT_BINARY;
+        else if (value == "journal") options.logFormat = LOG_FORMAT_JOURNAL;
+        else return false;
+        return true;
+    }
+    if (key == "mode") {
+        if (value == "ring") options.mode = CAPTURE_MODE_RING;
+        else if (value == "sync") options.mode = CAPTURE_MODE_SYNC;
+        else return false;
+        return true;
+    }
+    if (key == "input") {
+        if (value == "hooks") options.inputBackend = INPUT_BACKEND_HOOKS;
+        else if (value == "raw") options.inputBackend = INPUT_BACKEND_RAW_INPUT;
+        else return false;
+        return true;
+    }
+    if (key == "writer") {
+        if (value == "stream") options.writerBackend = WRITER_BACKEND_STREAM;
+        else if (value == "overlapped") options.writerBackend = WRITER_BACKEND_OVERLAPPED;
+        else return false;
+        return true;
+    }
+    if (key == "decimation") return parseDecimationPolicy(value, options.decimation.policy);
+    if (key == "decimation_distance_px") {
+        if (!parseSettingDecimal(value, decimal)) return false;
+        options.decimation.minDistancePx = decimal;
+        return true;
+    }
+    if (key == "decimation_tolerance_px") {
+        if (!parseSettingDecimal(value, decimal)) return false;
+        options.decimation.tolerancePx = decimal;
+        return true;
+    }
+    if (key == "wheel_coalescing") return parseSettingSwitch(value, options.wheelCoalescing.enabled);
+    if (key == "pipeline") return parseSettingSwitch(value, options.pipeline.enabled);
+    if (key == "monitor_geometry") return parseSettingSwitch(value, options.monitorGeometry);
+    if (key == "idle_session_events") return parseSettingSwitch(value, options.idle.sessionEvents);
+    if (key == "session_agent") return parseSettingSwitch(value, options.sessionRing.enabled);
+    if (key == "mmcss") {
+        options.hookThread.mmcssTask = value;
+        return true;
+    }
+    if (key == "hook_thread") {
+        if (!parseSettingSwitch(value, enabled)) return false;
+        options.hookThread.enabled = enabled;
+        return true;
+    }
+
+    // Everything else is an integer within its key's range
+    SettingRange range;
+    if (!integerSettingRange(key, range) || !parseSettingNumber(value, number)) return false;
+    if ((number < range.min && !(number == 0 && range.zeroMeansOff)) || number > range.max) return false;
+    const int milliseconds = static_cast<int>(number);
+    if (key == "ring_records") options.ringCapacity = static_cast<size_t>(number);
+    else if (key == "history_events") options.historyCapacity = static_cast<size_t>(number);
+    else if (key == "context_update_ms") options.contextUpdateIntervalMs = milliseconds;
+    else if (key == "drain_interval_ms") options.drainIntervalMs = milliseconds;
+    else if (key == "csv_flush_rows") options.csvFlushRows = static_cast<size_t>(number);
+    else if (key == "binary_block_events") options.binaryBlockEvents = static_cast<size_t>(number);
+    else if (key == "decimation_nth") options.decimation.everyNth = static_cast<int>(number);
+    else if (key == "decimation_rate_hz") options.decimation.maxRateHz = static_cast<int>(number);
+    else if (key == "wheel_window_ms") options.wheelCoalescing.windowMs = milliseconds;
+    else if (key == "features_ms") options.features.windowMs = milliseconds;
+    else if (key == "pipeline_batch_events") options.pipeline.batchEvents = static_cast<size_t>(number);
+    else if (key == "pipeline_batch_ms") options.pipeline.batchIntervalMs = milliseconds;
+    else if (key == "sink_queue_batches") options.pipeline.queueBatches = static_cast<size_t>(number);
+    else if (key == "telemetry_interval_ms") options.telemetryIntervalMs = milliseconds;
+    else if (key == "stats_interval_ms") options.statsLineIntervalMs = milliseconds;
+    else if (key == "idle_after_ms") options.idle.idleAfterMs = milliseconds;
+    else if (key == "session_ring_slots") options.sessionRing.capacitySlots = static_cast<size_t>(number);
+    else if (key == "rotate_mb") options.rotation.maxBytes = static_cast<unsigned long long>(number) * 1024 * 1024;
+    else if (key == "rotate_minutes") options.rotation.intervalMinutes = milliseconds;
+    else if (key == "index_interval") {
+        options.index.enabled = number > 0;
+        if (number > 0) options.index.interval = static_cast<unsigned int>(number);
+    }
+    else if (key == "journal_flush_ms") options.journal.flushIntervalMs = milliseconds;
+    else if (key == "network_batch_events") options.network.batchEvents = static_cast<size_t>(number);
+    else if (key == "spool_mb") options.network.maxSpoolBytes = static_cast<unsigned long long>(number) * 1024 * 1024;
+    else return false;
+    return true;
+}
+
+// "key=value" from the command line (--set)
+inline bool applyCaptureSettingText(const std::string& text, CaptureOptions& options, std::string& outputFile) {
+    const size_t equals = text.find('=');
+    if (equals == std::string::npos) return false;
+    return applyCaptureSetting(text.substr(0, equals), text.substr(equals + 1), options, outputFile);
+}
+
+inline std::string trimSetting(const std::string& text) {
+    const size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos) return std::string();
+    const size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+// Loads a profile file; reports the first bad line on std::cerr
+inline bool loadCaptureProfile(const std::string& path, CaptureOptions& options, std::string& outputFile) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open profile: " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        line = trimSetting(line);
+        if (line.empty()) continue;
+
+        const size_t equals = line.find('=');
+        const std::string key = equals == std::string::npos ? line : trimSetting(line.substr(0, equals));
+        const std::string value = equals == std::string::npos ? std::string() : trimSetting(line.substr(equals + 1));
+        if (equals == std::string::npos || !applyCaptureSetting(key, value, options, outputFile)) {
+            std::cerr << "Invalid setting in " << path << ":" << lineNumber << ": " << line << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,212 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <ctime>
+#include <climits>
+
+#include "BinaryLog.h"
+#include "CaptureIndex.h"
+#include "CsvFormat.h"
+
+// Prints the events of a CSV or binary capture log that fall in a time range,
+// as CSV. With a <log>.idx next to the log (BehavioralCapture --index) it
+// seeks straight to the range instead of scanning from the start. A
+// CaptureService log interleaves sessions, each in time order but not with
+// each other, so it is always scanned whole.
+
+struct QueryRange {
+    long long fromMs = 0;
+    long long toMs = LLONG_MAX;
+    std::string app;  // Empty matches every app
+};
+
+// Accepts ms since epoch or local "YYYY-MM-DD HH:MM[:SS]"
+bool parseTime(const std::string& text, long long& ms) {
+    if (!text.empty() && text.find_first_not_of("0123456789") == std::string::npos) {
+        ms = std::stoll(text);
+        return true;
+    }
+
+    std::tm time = {};
+    std::istringstream input(text);
+    input >> std::get_time(&time, "%Y-%m-%d %H:%M:%S");
+    if (input.fail()) {
+        time = {};
+        input.clear();
+        input.str(text);
+        input >> std::get_time(&time, "%Y-%m-%d %H:%M");
+        if (input.fail()) return false;
+    }
+    time.tm_isdst = -1;
+    const std::time_t seconds = std::mktime(&time);
+    if (seconds == -1) return false;
+    ms = static_cast<long long>(seconds) * 1000;
+    return true;
+}
+
+// Field `index` of a CSV row written by CsvBlock (no quoting)
+std::string csvField(const std::string& line, int index) {
+    size_t start = 0;
+    for (int i = 0; i < index; i++) {
+        start = line.find(',', start);
+        if (start == std::string::npos) return std::string();
+        start++;
+    }
+    const size_t end = line.find(',', start);
+    return line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+bool isBinaryLog(const std::string& filename) {
+    return filename.size() > 6 && filename.compare(filename.size() - 6, 6, ".bclog") == 0;
+}
+
+// Set when the log carries session blocks (written by CaptureService)
+bool isMultiplexedLog(const std::string& inputFile) {
+    BinaryLogReader probe;
+    BehavioralEvent event;
+    return probe.open(inputFile) && probe.next(event) && probe.hasSessions();
+}
+
+int queryCsv(const std::string& inputFile, const QueryRange& range, unsigned long long start, std::ostream& output,
+             unsigned long long& count) {
+    std::ifstream input(inputFile, std::ios::binary);
+    if (!input.is_open()) {
+        std::cerr << "Failed to open file: " << inputFile << std::endl;
+        return 1;
+    }
+    input.seekg(static_cast<std::streamoff>(start));
+
+    output << CSV_HEADER << CSV_LINE_END;
+    std::string line;
+    while (std::getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] < '0' || line[0] > '9') continue;  // Header of an appended session
+
+        const long long timestamp = std::stoll(line.substr(0, line.find(',')));
+        if (timestamp > range.toMs) break;
+        if (timestamp < range.fromMs) continue;
+        if (!range.app.empty() && csvField(line, 7) != range.app) continue;
+
+        output << line << CSV_LINE_END;
+        count++;
+    }
+    return 0;
+}
+
+// ordered is false for a multiplexed log, where an event past range.toMs
+// does not end the range for the other sessions
+int queryBinary(const std::string& inputFile, const QueryRange& range, const CaptureIndex* index,
+                unsigned long long start, bool ordered, std::ostream& output, unsigned long long& count) {
+    BinaryLogReader reader;
+    if (!reader.open(inputFile)) {
+        std::cerr << "Failed to open " << inputFile << ": " << reader.getError() << std::endl;
+        return 1;
+    }
+    if (index) {
+        // Dictionary blocks before the seek target are skipped, the index names
+        // those apps; the writer repeats the monitor table at every index entry
+        for (const auto& entry : index->getAppNames()) reader.addAppName(entry.first, entry.second);
+        if (start > 0 && !reader.seek(start)) {
+            std::cerr << "Failed to seek in " << inputFile << ": " << reader.getError() << std::endl;
+            return 1;
+        }
+    }
+
+    CsvBlock block;
+    block.appendLine(CSV_HEADER, strlen(CSV_HEADER));
+    BehavioralEvent event;
+    while (reader.next(event)) {
+        if (event.timestamp > range.toMs) {
+            if (ordered) break;
+            continue;
+        }
+        if (event.timestamp < range.fromMs) continue;
+        const std::string& appName = reader.appName(event.appId);
+        if (!range.app.empty() && appName != range.app) continue;
+
+        block.appendRow(event, appName, reader.monitors());
+        count++;
+        if (block.rowCount() >= 4096) {
+            output.write(block.bytes(), block.size());
+            block.clear();
+        }
+    }
+    output.write(block.bytes(), block.size());
+
+    if (!reader.getError().empty()) {
+        std::cerr << "Stopped after " << count << " events: " << reader.getError() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: CaptureQuery <log.csv | log.bclog> [--from <time>] [--to <time>] [--app <name>] [-o output.csv]" << std::endl;
+        std::cerr << "  <time> is ms since epoch or local \"YYYY-MM-DD HH:MM[:SS]\"" << std::endl;
+        return 1;
+    }
+
+    const std::string inputFile = argv[1];
+    QueryRange range;
+    std::string outputFile;
+    for (int i = 2; i < argc; i++) {
+        const std::string arg = argv[i];
+        if ((arg == "--from" || arg == "--to") && i + 1 < argc) {
+            long long& target = arg == "--from" ? range.fromMs : range.toMs;
+            if (!parseTime(argv[++i], target)) {
+                std::cerr << "Invalid time: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--app" && i + 1 < argc) {
+            range.app = argv[++i];
+        }
+        else if (arg == "-o" && i + 1 < argc) {
+            outputFile = argv[++i];
+        }
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    const bool binary = isBinaryLog(inputFile);
+    const bool multiplexed = binary && isMultiplexedLog(inputFile);
+    CaptureIndex index;
+    const bool indexed = !multiplexed && index.load(inputFile);
+    unsigned long long start = 0;
+    if (indexed) {
+        index.findStart(range.fromMs, start);
+    }
+    else if (multiplexed) {
+        std::cerr << "Sessions are interleaved, scanning the whole log" << std::endl;
+    }
+    else {
+        std::cerr << "No index (" << index.getError() << "), scanning the whole log" << std::endl;
+    }
+
+    std::ofstream outputStream;
+    if (!outputFile.empty()) {
+        outputStream.open(outputFile, std::ios::binary);
+        if (!outputStream.is_open()) {
+            std::cerr << "Failed to open file: " << outputFile << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& output = outputFile.empty() ? std::cout : outputStream;
+
+    unsigned long long count = 0;
+    const int result = binary
+        ? queryBinary(inputFile, range, indexed ? &index : nullptr, start, !multiplexed, output, count)
+        : queryCsv(inputFile, range, start, output, count);
+    output.flush();
+
+    std::cerr << count << " events";
+    if (indexed) std::cerr << ", started at byte " << start;
+    std::cerr << std::endl;
+    return result;
+}
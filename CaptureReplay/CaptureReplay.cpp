@@ -0,0 +1,305 @@
+#include <winsock2.h>  // Before windows.h, see NetworkSink.h
+#include <windows.h>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "BehavioralCapture.h"
+#include "CaptureLoader.h"
+
+// Deterministic replay of a recorded capture for regression-testing the
+// pipeline. A CSV or binary log is loaded with CaptureLoader and every
+// record is fed back through processMouseEvent/processKeyboardEvent ->
+// addEvent() -> the writers via BehavioralCapture::replayEvent(), with its
+// recorded timestamp, application and background count, either flat out
+// or at the recorded pace (--realtime, scaled by --speed). Stage deadlines
+// follow the recorded timestamps (CaptureOptions::recordedTime), so two
+// replays of a file with the same settings write the same bytes whatever
+// the host's scheduling; compare the checksums. Timestamps are whole ms, so
+// consecutive moves are re-timed from their recorded speed and the
+// kinematics stage measures sub-ms steps again. Reports hook latency,
+// throughput, and event counts and output size against the input.
+//
+// Settings are those of the capture (--profile, --config, --set, ...), with
+// input hooks, idle detection, process counting, live telemetry and
+// monitor geometry off: the recorded values are replayed instead.
+
+static double percentile(const std::vector<long long>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1));
+    return static_cast<double>(sorted[index]);
+}
+
+// FNV-1a of a whole file, 0 if it cannot be read
+static unsigned long long fileChecksum(const std::string& path) {
+    MappedFile file;
+    if (!file.open(path)) return 0;
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < file.size(); i++) {
+        hash = (hash ^ file.data()[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string signedDiff(long long value) {
+    return (value > 0 ? "+" : "") + std::to_string(value);
+}
+
+static double percentChange(double from, double to) {
+    return from > 0 ? (to - from) * 100.0 / from : 0;
+}
+
+// Size on disk of every segment of a journal (trimmed when it was closed)
+static unsigned long long journalBytes(const std::string& base, uint64_t& segments) {
+    unsigned long long total = 0;
+    for (segments = 0; journalSegmentExists(base, segments); segments++) {
+        std::ifstream segment(journalSegmentPath(base, segments), std::ios::binary | std::ios::ate);
+        if (segment.is_open()) total += static_cast<unsigned long long>(segment.tellg());
+    }
+    return total;
+}
+
+int main(int argc, char* argv[]) {
+    std::string inputFile;
+    std::string outputFile;  // Empty: <input>.replay.csv / .bclog / .bcj
+    bool realtime = false;
+    double speed = 1.0;
+    CaptureOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--profile" && i + 1 < argc) {
+            const std::string name = argv[++i];
+            if (!applyCaptureProfile(name, options)) {
+                std::cerr << "Unknown profile: " << name << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--config" && i + 1 < argc) {
+            std::string ignoredOutput;  // The replay names its own output
+            if (!loadCaptureProfile(argv[++i], options, ignoredOutput)) return 1;
+        }
+        else if (arg == "--set" && i + 1 < argc) {
+            std::string ignoredOutput;
+            const std::string setting = argv[++i];
+            if (!applyCaptureSettingText(setting, options, ignoredOutput)) {
+                std::cerr << "Unknown or invalid setting: " << setting << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--realtime") {
+            realtime = true;  // Pace records by their recorded timestamps
+        }
+        else if (arg == "--speed" && i + 1 < argc) {
+            // With --realtime: 2 replays twice as fast
+            if (!parseSettingDecimal(argv[++i], speed) || speed <= 0) {
+                std::cerr << "Invalid speed: " << argv[i] << " (a factor above 0)" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--sync") {
+            options.mode = CAPTURE_MODE_SYNC;
+        }
+        else if (arg == "--binary") {
+            options.logFormat = LOG_FORMAT_BINARY;
+        }
+        else if (arg == "--journal") {
+            options.logFormat = LOG_FORMAT_JOURNAL;
+        }
+        else if (arg == "--overlapped") {
+            options.writerBackend = WRITER_BACKEND_OVERLAPPED;
+        }
+        else if (arg == "--decimate" && i + 1 < argc) {
+            const std::string policy = argv[++i];
+            if (!parseDecimationPolicy(policy, options.decimation.policy)) {
+                std::cerr << "Unknown decimation policy: " << policy << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--features" && i + 1 < argc) {
+            std::string ignoredOutput;
+            if (!applyCaptureSetting("features_ms", argv[++i], options, ignoredOutput)) {
+                std::cerr << "Invalid feature window: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            outputFile = argv[++i];
+        }
+        else if (inputFile.empty() && arg.compare(0, 2, "--") != 0) {
+            inputFile = arg;
+        }
+        else {
+            std::cerr << "Usage: CaptureReplay <capture.csv | capture.bclog> [--realtime [--speed F]] [--output file]\n"
+                "       [--binary | --journal] [--sync] [--overlapped] [--decimate policy] [--features ms]\n"
+                "       [--profile name] [--config file] [--set key=value]" << std::endl;
+            return 1;
+        }
+    }
+    if (inputFile.empty()) {
+        std::cerr << "Usage: CaptureReplay <capture.csv | capture.bclog> [options], see the source for the list" << std::endl;
+        return 1;
+    }
+
+    options.installHooks = false;
+    options.foregroundTracking = FOREGROUND_TRACKING_POLL;  // No message pump in the replay
+    options.processCountProvider = PROCESS_COUNT_NONE;      // Recorded counts are replayed
+    options.monitorGeometry = false;                        // Recorded monitor indices are replayed
+    options.idle.idleAfterMs = 0;                           // Recorded timestamps are in the past
+    options.idle.sessionEvents = false;
+    options.telemetrySharedMemoryName.clear();              // Leave a live capture's block alone
+    options.recordedTime = true;
+    options.quitKey = 0;
+    options.sessionRing.enabled = false;
+
+    if (outputFile.empty()) {
+        const size_t slash = inputFile.find_last_of("\\/");
+        const size_t dot = inputFile.find_last_of('.');
+        const bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+        outputFile = (hasExtension ? inputFile.substr(0, dot) : inputFile) +
+            (options.logFormat == LOG_FORMAT_BINARY ? ".replay.bclog"
+                : options.logFormat == LOG_FORMAT_JOURNAL ? ".replay.bcj" : ".replay.csv");
+    }
+
+    CaptureLoader loader;
+    CaptureTable input;
+    if (!loader.load(inputFile, input)) {
+        std::cerr << "Failed to load " << inputFile << ": " << loader.getError() << std::endl;
+        return 1;
+    }
+    const LoadStats loadStats = loader.getStats();
+    if (input.size() == 0) {
+        std::cerr << "No events in " << inputFile << std::endl;
+        return 1;
+    }
+
+    if (options.logFormat == LOG_FORMAT_JOURNAL) {
+        // Segments of an earlier, longer replay would be read as a continuation
+        for (uint64_t segment = 0; journalSegmentExists(outputFile, segment); segment++) {
+            std::remove(journalSegmentPath(outputFile, segment).c_str());
+        }
+    }
+    else {
+        std::remove(outputFile.c_str());
+    }
+
+    BehavioralCapture capture;
+    if (!capture.start(outputFile, options)) {
+        std::cerr << "Failed to start capture pipeline!" << std::endl;
+        return 1;
+    }
+    const unsigned long long bytesAtStart = capture.getBytesWritten();  // File header
+
+    // Records with the capture's app IDs, built before the timed loop
+    std::vector<uint16_t> appIds(input.appNames.size());
+    for (size_t id = 0; id < input.appNames.size(); id++) {
+        appIds[id] = capture.internAppName(input.appNames[id]);
+    }
+    std::vector<BehavioralEvent> records(input.size());
+    unsigned long long inputByType[EVENT_TYPE_COUNT] = {};
+    for (size_t row = 0; row < input.size(); row++) {
+        records[row] = input.get(row);
+        records[row].appId = records[row].appId < appIds.size() ? appIds[records[row].appId] : AppInternTable::UNKNOWN_APP_ID;
+        if (records[row].type < EVENT_TYPE_COUNT) inputByType[records[row].type]++;
+    }
+
+    std::vector<long long> latencies(records.size());
+    LARGE_INTEGER frequency, begin, end, replayStart, replayEnd;
+    QueryPerformanceFrequency(&frequency);
+    const double ticksToNs = 1e9 / static_cast<double>(frequency.QuadPart);
+    const double ticksPerRecordedMs = frequency.QuadPart / 1000.0 / speed;
+    const long long firstTimestamp = records.front().timestamp;
+
+    QueryPerformanceCounter(&replayStart);
+    for (size_t i = 0; i < records.size(); i++) {
+        if (realtime) {
+            const long long due = replayStart.QuadPart +
+                static_cast<long long>((records[i].timestamp - firstTimestamp) * ticksPerRecordedMs);
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            if (due - now.QuadPart > frequency.QuadPart / 500) {
+                // Sleep through long gaps, spin the last 2 ms
+                Sleep(static_cast<DWORD>((due - now.QuadPart) * 1000 / frequency.QuadPart - 2));
+            }
+            do {
+                QueryPerformanceCounter(&now);
+            } while (now.QuadPart < due);
+        }
+
+        QueryPerformanceCounter(&begin);
+        capture.replayEvent(records[i]);
+        QueryPerformanceCounter(&end);
+        latencies[i] = end.QuadPart - begin.QuadPart;
+    }
+    QueryPerformanceCounter(&replayEnd);
+
+    capture.stop();  // Drains the ring and flushes the writers
+    LARGE_INTEGER drained;
+    QueryPerformanceCounter(&drained);
+
+    const unsigned long long stored = capture.getRecordedEventCount();
+    uint64_t segments = 0;
+    const unsigned long long bytes = options.logFormat == LOG_FORMAT_JOURNAL
+        ? journalBytes(outputFile, segments) : capture.getBytesWritten();
+    const double replaySeconds = (replayEnd.QuadPart - replayStart.QuadPart) / static_cast<double>(frequency.QuadPart);
+    const double totalSeconds = (drained.QuadPart - replayStart.QuadPart) / static_cast<double>(frequency.QuadPart);
+    const double recordedSeconds = (records.back().timestamp - firstTimestamp) / 1000.0;
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << "\n=== Capture Replay ===" << std::endl;
+    std::cout << "Settings:\n" << describeCaptureSettings(options, "  ") << std::flush;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Input: " << inputFile << ", " << records.size() << " events over " << recordedSeconds
+        << " s recorded, " << loadStats.bytes << " bytes (loaded in " << loadStats.seconds * 1000.0 << " ms)" << std::endl;
+    std::cout << "Replay: " << (realtime ? "recorded pace" : "max speed");
+    if (realtime && speed != 1.0) std::cout << " x" << speed;
+    std::cout << ", " << replaySeconds << " s" << std::endl;
+    std::cout << std::setprecision(0);
+    std::cout << "Hook latency: p50 " << percentile(latencies, 0.50) * ticksToNs
+        << " ns, p99 " << percentile(latencies, 0.99) * ticksToNs
+        << " ns, p999 " << percentile(latencies, 0.999) * ticksToNs
+        << " ns, max " << latencies.back() * ticksToNs << " ns" << std::endl;
+    std::cout << "Throughput: " << records.size() / replaySeconds << " records/sec replayed, "
+        << stored / totalSeconds << " stored events/sec end-to-end" << std::endl;
+
+    std::cout << "Stored events: " << stored << " (" << signedDiff(static_cast<long long>(stored) - static_cast<long long>(records.size()))
+        << " vs input, dropped by ring: " << capture.getDroppedRecordCount() << ")" << std::endl;
+    std::cout << std::setprecision(1);
+    std::cout << "Output: " << outputFile;
+    if (options.logFormat == LOG_FORMAT_JOURNAL) std::cout << " (" << segments << " segments)";
+    std::cout << ", " << bytes << " bytes (" << signedDiff(static_cast<long long>(bytes) - static_cast<long long>(loadStats.bytes))
+        << ", " << std::showpos << percentChange(static_cast<double>(loadStats.bytes), static_cast<double>(bytes))
+        << std::noshowpos << "% vs input), " << (stored ? static_cast<double>(bytes - bytesAtStart) / stored : 0.0)
+        << " bytes per stored event" << std::endl;
+
+    // Per-type counts of what was written, for the logs the loader reads
+    if (options.logFormat != LOG_FORMAT_JOURNAL && options.writeEventLog) {
+        CaptureTable output;
+        if (loader.load(outputFile, output)) {
+            unsigned long long outputByType[EVENT_TYPE_COUNT] = {};
+            for (size_t row = 0; row < output.size(); row++) {
+                if (output.type[row] < EVENT_TYPE_COUNT) outputByType[output.type[row]]++;
+            }
+            static const char* const typeNames[EVENT_TYPE_COUNT] = {
+                "mouse moves", "left downs", "left ups", "right downs", "right ups", "wheel", "key downs", "key ups"
+            };
+            std::cout << "Events by type (input -> output):";
+            for (int type = 0; type < EVENT_TYPE_COUNT; type++) {
+                std::cout << (type > 0 ? "," : "") << " " << typeNames[type] << " " << inputByType[type]
+                    << " -> " << outputByType[type];
+            }
+            std::cout << std::endl;
+        }
+        else {
+            std::cerr << "Failed to read back " << outputFile << ": " << loader.getError() << std::endl;
+        }
+        std::cout << "Output checksum: " << std::hex << fileChecksum(outputFile) << std::dec
+            << " (equal across replays with the same settings)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,371 @@
+#include <windows.h>
+#include <wtsapi32.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+
+#include "SessionRing.h"
+#include "BinaryLog.h"
+#include "AppInternTable.h"
+#include "ProcessCounter.h"
+
+#pragma comment(lib, "wtsapi32.lib")
+
+// Multi-session capture service for terminal servers. Every interactive
+// session runs an agent (BehavioralCapture --agent) that publishes its
+// records into a SessionRing; this service drains all of them into one
+// binary log, each run of a session's events preceded by a session block
+// with its ID and user name (see BinaryLog.h), so CaptureExport --session
+// can split them again. Processes are counted here, once for the machine,
+// and the count is stamped into every session's records; app IDs are
+// remapped into one table for the log.
+//
+// Runs under the service control manager, or in the foreground with
+// --console. Installed with, for example:
+//   sc create BehavioralCaptureService start= auto
+//      binPath= "C:\Tools\CaptureService.exe --output D:\Capture\sessions.bclog"
+// A relative --output is resolved next to the executable, as a service
+// starts in the system directory.
+//
+// While every ring is empty the service sleeps on the agents' data events
+// (see SessionRing.h) until the next session scan or process count is due.
+// Rings without an event, or more sessions than one wait can take, are
+// polled every pollIntervalMs instead.
+
+static const char* const SERVICE_NAME = "BehavioralCaptureService";
+
+struct ServiceOptions {
+    std::string outputFile = "session_behavior_data.bclog";
+    int pollIntervalMs = 5;              // Polling of rings the service cannot wait on
+    int sessionScanIntervalMs = 1000;    // New and ended sessions, and the partial block is sealed
+    int contextUpdateIntervalMs = 500;   // Process count refresh
+    size_t drainBatchEvents = 256;       // Taken from one ring before moving to the next
+    size_t binaryBlockEvents = 256;
+    bool console = false;
+};
+
+// One Windows session with an agent ring
+struct AgentSession {
+    uint32_t id = 0;
+    std::string user;
+    SessionRingReader ring;
+    std::vector<uint16_t> appIds;        // Agent app ID -> log app ID, 0 = not mapped yet
+    unsigned long long ringResets = 0;   // Of the agent the mapping belongs to
+    unsigned long long events = 0;
+    bool listed = false;                 // Seen by the last session scan
+};
+
+class CaptureService {
+private:
+    ServiceOptions options;
+    AppInternTable appNames;  // IDs of the log; every agent has its own
+    BinaryLogWriter writer;
+    ProcessCounter processCounter;
+    uint16_t backgroundCount;
+    std::map<uint32_t, std::unique_ptr<AgentSession>> sessions;  // Stable addresses, the writer holds a ring
+    std::atomic<bool> running;
+    HANDLE stopEvent;                    // Ends the wait in run() on requestStop()
+    unsigned long long totalEvents;
+    unsigned long long attachedSessions;
+
+    static std::string sessionUser(uint32_t id) {
+        LPSTR buffer = NULL;
+        DWORD bytes = 0;
+        std::string user;
+        if (WTSQuerySessionInformationA(WTS_CURRENT_SERVER_HANDLE, id, WTSUserName, &buffer, &bytes) && buffer) {
+            user = buffer;
+        }
+        if (buffer) WTSFreeMemory(buffer);
+        return user;
+    }
+
+    uint16_t logAppId(AgentSession& session, uint16_t agentId, const std::string& appName) {
+        if (session.ring.getResets() != session.ringResets) {
+            // A new agent numbers its apps from scratch
+            session.appIds.clear();
+            session.ringResets = session.ring.getResets();
+        }
+        if (agentId >= session.appIds.size()) session.appIds.resize(agentId + 1, 0);
+        uint16_t& id = session.appIds[agentId];
+        if (id == 0) id = appNames.intern(appName);
+        return id;
+    }
+
+    size_t drainSession(AgentSession& session) {
+        return session.ring.drain(options.drainBatchEvents, [&](const BehavioralEvent& agentEvent, const std::string& appName) {
+            // A no-op while the session stays the same, so a ring with nothing new never splits a block
+            writer.setSession(session.id, session.user, &session.ring);
+            BehavioralEvent event = agentEvent;
+            event.appId = logAppId(session, agentEvent.appId, appName);
+            event.backgroundAppCount = backgroundCount;
+            writer.write(event);
+            session.events++;
+            totalEvents++;
+        });
+    }
+
+    void detach(std::map<uint32_t, std::unique_ptr<AgentSession>>::iterator it) {
+        AgentSession& session = *it->second;
+        while (drainSession(session) > 0) {}
+        writer.flush();
+        writer.setMonitorSource(nullptr);  // Done with the ring's monitor table
+        std::cout << "Session " << session.id << " (" << session.user << ") detached: " << session.events
+            << " events, " << session.ring.getDroppedRecords() << " dropped by the agent" << std::endl;
+        sessions.erase(it);
+    }
+
+    // Opens the rings of sessions whose agent appeared, drains and closes
+    // those of sessions that ended
+    void scanSessions() {
+        PWTS_SESSION_INFOA list = NULL;
+        DWORD count = 0;
+        if (!WTSEnumerateSessionsA(WTS_CURRENT_SERVER_HANDLE, 0, 1, &list, &count)) return;
+
+        for (auto& entry : sessions) entry.second->listed = false;
+        for (DWORD i = 0; i < count; i++) {
+            const uint32_t id = list[i].SessionId;
+            const WTS_CONNECTSTATE_CLASS state = list[i].State;
+            if (id == 0 || (state != WTSActive && state != WTSConnected && state != WTSDisconnected)) continue;
+
+            auto it = sessions.find(id);
+            if (it != sessions.end()) {
+                it->second->listed = true;
+                continue;
+            }
+            std::unique_ptr<AgentSession> session(new AgentSession());
+            if (!session->ring.open(id)) continue;  // No agent (yet)
+            session->id = id;
+            session->user = sessionUser(id);
+            session->listed = true;
+            std::cout << "Session " << id << " (" << session->user << ") attached, ring of "
+                << session->ring.getCapacity() << " slots, agent pid " << session->ring.getAgentPid() << std::endl;
+            sessions[id] = std::move(session);
+            attachedSessions++;
+        }
+        WTSFreeMemory(list);
+
+        for (auto it = sessions.begin(); it != sessions.end();) {
+            auto next = std::next(it);
+            if (!it->second->listed) detach(it);
+            it = next;
+        }
+    }
+
+public:
+    CaptureService() :
+        backgroundCount(0),
+        running(false),
+        stopEvent(NULL),
+        totalEvents(0),
+        attachedSessions(0) {}
+
+    bool start(const ServiceOptions& serviceOptions) {
+        options = serviceOptions;
+        writer.setBlockEvents(options.binaryBlockEvents);
+        if (!writer.open(options.outputFile, appNames)) {
+            std::cerr << "Failed to open file: " << options.outputFile << std::endl;
+            return false;
+        }
+        processCounter.init(PROCESS_COUNT_NTQUERY);
+        stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        if (stopEvent == NULL) {
+            std::cerr << "Failed to create the stop event" << std::endl;
+            writer.close();
+            return false;
+        }
+        running = true;
+
+        std::cout << "Capture service writing " << options.outputFile << std::endl;
+        std::cout << "- Session scan every " << options.sessionScanIntervalMs << "ms, process count every "
+            << options.contextUpdateIntervalMs << "ms ("
+            << (processCounter.getProvider() == PROCESS_COUNT_NTQUERY ? "NtQuerySystemInformation" : "Toolhelp snapshot")
+            << ")" << std::endl;
+        return true;
+    }
+
+    // Until requestStop(); rings are drained in turn, drainBatchEvents at a time
+    void run() {
+        auto nextScan = std::chrono::steady_clock::now();
+        auto nextCount = nextScan;
+        while (running) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= nextCount) {
+                const int count = processCounter.count();
+                backgroundCount = static_cast<uint16_t>(count > 0xFFFF ? 0xFFFF : count);
+                nextCount = now + std::chrono::milliseconds(options.contextUpdateIntervalMs);
+            }
+            if (now >= nextScan) {
+                scanSessions();
+                writer.flush();  // Seals the partial block, the log trails by one scan at most
+                nextScan = now + std::chrono::milliseconds(options.sessionScanIntervalMs);
+            }
+
+            size_t drained = 0;
+            for (auto& entry : sessions) {
+                drained += drainSession(*entry.second);
+            }
+            if (drained == 0) {
+                waitForData(nextScan < nextCount ? nextScan : nextCount);
+            }
+        }
+    }
+
+    // Every ring was empty: sleeps until an agent signals, the deadline
+    // passes or requestStop()
+    void waitForData(std::chrono::steady_clock::time_point deadline) {
+        std::vector<HANDLE> handles(1, stopEvent);
+        bool polling = false;
+        for (auto& entry : sessions) {
+            const HANDLE event = entry.second->ring.getDataEvent();
+            if (event == NULL || handles.size() == MAXIMUM_WAIT_OBJECTS) {
+                polling = true;
+                continue;
+            }
+            handles.push_back(event);
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        long long timeoutMs = deadline > now ?
+            std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1 : 0;
+        if (polling && timeoutMs > options.pollIntervalMs) timeoutMs = options.pollIntervalMs;
+        WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, static_cast<DWORD>(timeoutMs));
+    }
+
+    void requestStop() {
+        running = false;
+        if (stopEvent) SetEvent(stopEvent);
+    }
+
+    void stop() {
+        while (!sessions.empty()) detach(sessions.begin());
+        writer.close();
+        if (stopEvent) {
+            CloseHandle(stopEvent);
+            stopEvent = NULL;
+        }
+        std::cout << "Capture service stopped: " << totalEvents << " events from " << attachedSessions
+            << " sessions, " << appNames.size() << " applications, " << writer.getBytesWritten() << " bytes written"
+            << std::endl;
+    }
+};
+
+static CaptureService service;
+static ServiceOptions serviceOptions;
+static SERVICE_STATUS_HANDLE statusHandle = NULL;
+static SERVICE_STATUS status;
+
+static void reportStatus(DWORD state, DWORD exitCode = NO_ERROR) {
+    status.dwServiceType = SERVICE_WIN32_OWN_PROCESS;
+    status.dwCurrentState = state;
+    status.dwControlsAccepted = state == SERVICE_RUNNING ? SERVICE_ACCEPT_STOP | SERVICE_ACCEPT_SHUTDOWN : 0;
+    status.dwWin32ExitCode = exitCode;
+    status.dwWaitHint = state == SERVICE_RUNNING || state == SERVICE_STOPPED ? 0 : 5000;
+    if (statusHandle) SetServiceStatus(statusHandle, &status);
+}
+
+static DWORD WINAPI serviceControl(DWORD control, DWORD, LPVOID, LPVOID) {
+    if (control == SERVICE_CONTROL_STOP || control == SERVICE_CONTROL_SHUTDOWN) {
+        reportStatus(SERVICE_STOP_PENDING);
+        service.requestStop();
+        return NO_ERROR;
+    }
+    return control == SERVICE_CONTROL_INTERROGATE ? NO_ERROR : ERROR_CALL_NOT_IMPLEMENTED;
+}
+
+static void WINAPI serviceMain(DWORD, LPSTR*) {
+    statusHandle = RegisterServiceCtrlHandlerExA(SERVICE_NAME, serviceControl, NULL);
+    if (statusHandle == NULL) return;
+    reportStatus(SERVICE_START_PENDING);
+    if (!service.start(serviceOptions)) {
+        reportStatus(SERVICE_STOPPED, ERROR_SERVICE_SPECIFIC_ERROR);
+        return;
+    }
+    reportStatus(SERVICE_RUNNING);
+    service.run();
+    service.stop();
+    reportStatus(SERVICE_STOPPED);
+}
+
+static BOOL WINAPI consoleControl(DWORD) {
+    service.requestStop();
+    return TRUE;
+}
+
+// Services start in the system directory
+static std::string besideExecutable(const std::string& path) {
+    if (path.size() > 1 && (path[1] == ':' || path[0] == '\\' || path[0] == '/')) return path;
+    char module[MAX_PATH];
+    const DWORD length = GetModuleFileNameA(NULL, module, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) return path;
+    std::string directory(module, length);
+    const size_t slash = directory.find_last_of("\\/");
+    return slash == std::string::npos ? path : directory.substr(0, slash + 1) + path;
+}
+
+// Whole decimal number within [min, max]; prints the problem otherwise
+static bool parseFlagNumber(const std::string& flag, const char* text, long long min, long long max, long long& value) {
+    char* end = nullptr;
+    const long long parsed = std::strtoll(text, &end, 10);
+    if (end == text || *end != '\0' || parsed < min || parsed > max) {
+        std::cerr << flag << " needs a whole number from " << min << " to " << max << ", not '" << text << "'" << std::endl;
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        long long number = 0;
+        if (arg == "--console") {
+            serviceOptions.console = true;
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            serviceOptions.outputFile = argv[++i];
+        }
+        else if (arg == "--scan-ms" && i + 1 < argc) {
+            if (!parseFlagNumber(arg, argv[++i], 100, 3600000, number)) return 1;
+            serviceOptions.sessionScanIntervalMs = static_cast<int>(number);
+        }
+        else if (arg == "--poll-ms" && i + 1 < argc) {
+            if (!parseFlagNumber(arg, argv[++i], 1, 1000, number)) return 1;
+            serviceOptions.pollIntervalMs = static_cast<int>(number);
+        }
+        else if (arg == "--block-events" && i + 1 < argc) {
+            if (!parseFlagNumber(arg, argv[++i], 1, static_cast<long long>(BINARY_MAX_BLOCK_EVENTS), number)) return 1;
+            serviceOptions.binaryBlockEvents = static_cast<size_t>(number);
+        }
+        else {
+            std::cerr << "Usage: CaptureService [--console] [--output sessions.bclog] [--scan-ms N] [--poll-ms N] "
+                "[--block-events N]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (serviceOptions.console) {
+        SetConsoleCtrlHandler(consoleControl, TRUE);
+        if (!service.start(serviceOptions)) return 1;
+        std::cout << "Press Ctrl+C to stop." << std::endl;
+        service.run();
+        service.stop();
+        return 0;
+    }
+
+    serviceOptions.outputFile = besideExecutable(serviceOptions.outputFile);
+    SERVICE_TABLE_ENTRYA table[] = {
+        { const_cast<LPSTR>(SERVICE_NAME), serviceMain },
+        { NULL, NULL }
+    };
+    if (!StartServiceCtrlDispatcherA(table)) {
+        std::cerr << "Not started by the service control manager (use --console to run in the foreground)" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include "BehavioralEvent.h"
+
+// Log-linear histogram of durations in nanoseconds (four sub-buckets per
+// power of two, so percentiles are within ~25%). Recording is a handful of
+// instructions and a relaxed atomic add; it is meant to be updated by one
+// thread and read by any.
+class LatencyHistogram {
+public:
+    static const int BUCKET_COUNT = 128;  // The last bucket starts at 7 << 30 ns (~7.5 s) and takes everything above
+
+private:
+    std::atomic<uint64_t> buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> maxValue;
+
+    static int bucketFor(uint64_t ns) {
+        if (ns < 4) return static_cast<int>(ns);
+        int msb = 0;
+        for (uint64_t v = ns; v > 1; v >>= 1) msb++;
+        int index = (msb - 1) * 4 + static_cast<int>((ns >> (msb - 2)) & 3);
+        return index < BUCKET_COUNT ? index : BUCKET_COUNT - 1;
+    }
+
+public:
+    LatencyHistogram() {
+        reset();
+    }
+
+    void reset() {
+        for (int i = 0; i < BUCKET_COUNT; i++) buckets[i].store(0, std::memory_order_relaxed);
+        count.store(0, std::memory_order_relaxed);
+        maxValue.store(0, std::memory_order_relaxed);
+    }
+
+    void record(uint64_t ns) {
+        std::atomic<uint64_t>& bucket = buckets[bucketFor(ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (ns > maxValue.load(std::memory_order_relaxed)) maxValue.store(ns, std::memory_order_relaxed);
+    }
+
+    // Smallest value that falls into bucket index
+    static uint64_t bucketLowerBound(int index) {
+        if (index < 4) return static_cast<uint64_t>(index);
+        int msb = index / 4 + 1;
+        return static_cast<uint64_t>(4 + index % 4) << (msb - 2);
+    }
+
+    // Upper bound of the bucket containing the given fraction of samples
+    uint64_t percentile(double fraction) const {
+        const uint64_t total = count.load(std::memory_order_relaxed);
+        if (total == 0) return 0;
+
+        const uint64_t target = static_cast<uint64_t>(fraction * total + 0.5);
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= target && seen > 0) {
+                return i + 1 < BUCKET_COUNT ? bucketLowerBound(i + 1) - 1 : getMax();
+            }
+        }
+        return getMax();
+    }
+
+    uint64_t getCount() const { return count.load(std::memory_order_relaxed); }
+    uint64_t getMax() const { return maxValue.load(std::memory_order_relaxed); }
+
+    void copyBuckets(uint64_t* out) const {
+        for (int i = 0; i < BUCKET_COUNT; i++) out[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+};
+
+// Converts QueryPerformanceCounter ticks to nanoseconds
+class QpcClock {
+private:
+    double nsPerTick;
+
+public:
+    QpcClock() {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        nsPerTick = 1e9 / static_cast<double>(frequency.QuadPart);
+    }
+
+    static long long now() {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        return counter.QuadPart;
+    }
+
+    uint64_t toNs(long long ticks) const {
+        return ticks > 0 ? static_cast<uint64_t>(ticks * nsPerTick) : 0;
+    }
+};
+
+// Layout of the named shared-memory block scraped by monitoring agents.
+// Readers copy the block and retry while sequence is odd or changed during
+// the copy (seqlock), so the capture never waits on a reader.
+struct TelemetryBlock {
+    static const uint32_t LAYOUT_VERSION = 3;
+
+    std::atomic<uint32_t> sequence;
+    uint32_t version;
+    uint32_t processId;
+    uint32_t reserved;
+    uint64_t updatedAtMs;               // ms since epoch of the last publish
+
+    uint64_t mouseCallbacks;
+    uint64_t keyboardCallbacks;
+    uint64_t mouseHookP50Ns, mouseHookP99Ns, mouseHookMaxNs;
+    uint64_t keyboardHookP50Ns, keyboardHookP99Ns, keyboardHookMaxNs;
+    uint64_t sampledOutMoves;           // Moves dropped by the decimation stage
+    uint64_t keptMoves;                 // Moves that passed the decimation stage
+    uint64_t recordedEvents;
+    uint64_t droppedRecords;            // Ring full
+    uint64_t queueDepth;                // Records waiting in the ring
+    uint64_t queueHighWater;
+    uint64_t flushCount;
+    uint64_t flushP50Ns, flushP99Ns, flushMaxNs;
+    uint64_t bytesWritten;
+    uint64_t recordedByType[EVENT_TYPE_COUNT];  // Recorded events per EventType
+
+    // Raw buckets, see LatencyHistogram::bucketLowerBound()
+    uint64_t mouseHookBuckets[LatencyHistogram::BUCKET_COUNT];
+    uint64_t keyboardHookBuckets[LatencyHistogram::BUCKET_COUNT];
+    uint64_t flushBuckets[LatencyHistogram::BUCKET_COUNT];
+};
+
+// Owns the file mapping backing TelemetryBlock. A name that is already
+// mapped belongs to another capture (or a reader left open), so open()
+// refuses it rather than wiping that block.
+class TelemetryPublisher {
+private:
+    HANDLE mapping;
+    TelemetryBlock* block;
+    bool nameInUse;
+
+public:
+    TelemetryPublisher() : mapping(NULL), block(nullptr), nameInUse(false) {}
+
+    ~TelemetryPublisher() {
+        close();
+    }
+
+    TelemetryPublisher(const TelemetryPublisher&) = delete;
+    TelemetryPublisher& operator=(const TelemetryPublisher&) = delete;
+
+    bool open(const std::string& name) {
+        nameInUse = false;
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+            static_cast<DWORD>(sizeof(TelemetryBlock)), name.c_str());
+        if (mapping == NULL) return false;
+        if (GetLastError() == ERROR_ALREADY_EXISTS) {
+            nameInUse = true;
+            close();
+            return false;
+        }
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(TelemetryBlock));
+        if (view == NULL) {
+            close();
+            return false;
+        }
+        memset(view, 0, sizeof(TelemetryBlock));
+        block = new (view) TelemetryBlock();
+        block->version = TelemetryBlock::LAYOUT_VERSION;
+        block->processId = GetCurrentProcessId();
+        return true;
+    }
+
+    // Fills the block via fill(TelemetryBlock&) inside a seqlock write section
+    template <typename Fill>
+    void publish(Fill fill) {
+        if (!block) return;
+        const uint32_t start = block->sequence.load(std::memory_order_relaxed);
+        block->sequence.store(start + 1, std::memory_order_relaxed);  // Odd: update in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        fill(*block);
+        block->sequence.store(start + 2, std::memory_order_release);
+    }
+
+    bool isOpen() const {
+        return block != nullptr;
+    }
+
+    // Whether the last open() failed because the name was already mapped
+    bool wasNameInUse() const {
+        return nameInUse;
+    }
+
+    void close() {
+        if (block) {
+            UnmapViewOfFile(block);
+            block = nullptr;
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+            mapping = NULL;
+        }
+    }
+};
@@ -0,0 +1,443 @@
+#pragma once
+
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "BehavioralEvent.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BC_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC compiles intrinsics of any instruction set; GCC/Clang need the
+// target enabled per function
+#if defined(BC_HAVE_X86_SIMD) && (defined(__GNUC__) || defined(__clang__))
+#define BC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BC_TARGET_AVX2
+#endif
+
+// Structure-of-arrays copy of the event history for analytics.
+// x/y hold the cursor position at every record: key records carry the last
+// mouse position forward (their own x/y slots hold key timing), so the path
+// length is a plain pass over consecutive rows.
+struct EventColumns {
+    std::vector<uint8_t> type;
+    std::vector<long long> timestamp;
+    std::vector<int32_t> x;
+    std::vector<int32_t> y;
+    std::vector<float> speed;
+
+    size_t size() const { return type.size(); }
+
+    void clear() {
+        type.clear();
+        timestamp.clear();
+        x.clear();
+        y.clear();
+        speed.clear();
+    }
+
+    // Rebuilds the columns from a sized range of BehavioralEvent (oldest first)
+    template <typename Range>
+    void assign(const Range& events) {
+        const size_t count = events.size();
+        type.resize(count);
+        timestamp.resize(count);
+        x.resize(count);
+        y.resize(count);
+        speed.resize(count);
+
+        int32_t cursorX = 0, cursorY = 0;
+        bool haveCursor = false;
+        size_t i = 0;
+        for (const BehavioralEvent& event : events) {
+            if (i == count) break;
+            const bool isKey = event.type == KEY_DOWN || event.type == KEY_UP;
+            if (!isKey) {
+                cursorX = event.x;
+                cursorY = event.y;
+                if (!haveCursor) {
+                    // Key records before the first mouse record take its position
+                    for (size_t j = 0; j < i; j++) {
+                        x[j] = cursorX;
+                        y[j] = cursorY;
+                    }
+                    haveCursor = true;
+                }
+            }
+            type[i] = event.type;
+            timestamp[i] = event.timestamp;
+            x[i] = cursorX;
+            y[i] = cursorY;
+            speed[i] = event.mouseSpeed;
+            i++;
+        }
+    }
+};
+
+// Result of one analytics pass over EventColumns
+struct ColumnStats {
+    uint64_t countByType[EVENT_TYPE_COUNT];
+    uint64_t speedCount;      // MOUSE_MOVE records with a non-zero speed
+    double speedMean;
+    double speedVariance;     // Sample variance
+    float speedMin;
+    float speedMax;
+    double distancePx;        // Cursor path length
+};
+
+enum SimdLevel {
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2
+};
+
+inline const char* simdLevelName(SimdLevel level) {
+    return level == SIMD_AVX2 ? "AVX2" : level == SIMD_SSE2 ? "SSE2" : "scalar";
+}
+
+// Best kernel set this CPU and OS support (AVX2 also needs OS-saved YMM state)
+inline SimdLevel detectSimdLevel() {
+#if defined(BC_HAVE_X86_SIMD)
+    int info[4] = { 0, 0, 0, 0 };
+#if defined(_MSC_VER)
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    __cpuid(info, 1);
+#else
+    unsigned int a, b, c, d;
+    const int maxLeaf = static_cast<int>(__get_cpuid_max(0, nullptr));
+    __cpuid(1, a, b, c, d);
+    info[0] = static_cast<int>(a); info[1] = static_cast<int>(b);
+    info[2] = static_cast<int>(c); info[3] = static_cast<int>(d);
+#endif
+    const bool sse2 = (info[3] & (1 << 26)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osxsave && avx) {
+#if defined(_MSC_VER)
+        const unsigned long long xcr0 = _xgetbv(0);
+        __cpuidex(info, 7, 0);
+        const int leaf7ebx = info[1];
+#else
+        unsigned int xcrLow, xcrHigh;
+        __asm__("xgetbv" : "=a"(xcrLow), "=d"(xcrHigh) : "c"(0));
+        const unsigned long long xcr0 = (static_cast<unsigned long long>(xcrHigh) << 32) | xcrLow;
+        __cpuid_count(7, 0, a, b, c, d);
+        const int leaf7ebx = static_cast<int>(b);
+#endif
+        avx2 = (xcr0 & 0x6) == 0x6 && (leaf7ebx & (1 << 5)) != 0;
+    }
+    if (avx2) return SIMD_AVX2;
+    if (sse2) return SIMD_SSE2;
+#endif
+    return SIMD_SCALAR;
+}
+
+// Counts by type, speed mean/variance/min/max (two passes, so the variance
+// does not suffer from cancellation) and path length. All kernel sets give
+// the same counts; floating-point results agree to rounding.
+class ColumnStatsKernels {
+private:
+    static int bitCount(unsigned int mask) {
+        return static_cast<int>(std::bitset<32>(mask).count());
+    }
+
+    static void scalarCounts(const uint8_t* type, size_t begin, size_t n, uint64_t* counts) {
+        for (size_t i = begin; i < n; i++) {
+            if (type[i] < EVENT_TYPE_COUNT) counts[type[i]]++;
+        }
+    }
+
+    static void scalarSpeedSums(const uint8_t* type, const float* speed, size_t begin, size_t n,
+        double& sum, uint64_t& count, float& minValue, float& maxValue) {
+        for (size_t i = begin; i < n; i++) {
+            if (type[i] == MOUSE_MOVE && speed[i] > 0.0f) {
+                sum += speed[i];
+                count++;
+                if (speed[i] < minValue) minValue = speed[i];
+                if (speed[i] > maxValue) maxValue = speed[i];
+            }
+        }
+    }
+
+    static double scalarSquaredDeviations(const uint8_t* type, const float* speed, size_t begin, size_t n, double mean) {
+        double total = 0.0;
+        for (size_t i = begin; i < n; i++) {
+            if (type[i] == MOUSE_MOVE && speed[i] > 0.0f) {
+                const double d = speed[i] - mean;
+                total += d * d;
+            }
+        }
+        return total;
+    }
+
+    // Sum of |p[i] - p[i-1]| for i in [begin, n)
+    static double scalarDistance(const int32_t* x, const int32_t* y, size_t begin, size_t n) {
+        double total = 0.0;
+        for (size_t i = (begin > 0 ? begin : 1); i < n; i++) {
+            const double dx = static_cast<double>(x[i]) - x[i - 1];
+            const double dy = static_cast<double>(y[i]) - y[i - 1];
+            total += std::sqrt(dx * dx + dy * dy);
+        }
+        return total;
+    }
+
+#if defined(BC_HAVE_X86_SIMD)
+    static double horizontalSum(__m128d v) {
+        return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+    }
+
+    static float horizontalMin(__m128 v) {
+        v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+        v = _mm_min_ss(v, _mm_shuffle_ps(v, v, 1));
+        return _mm_cvtss_f32(v);
+    }
+
+    static float horizontalMax(__m128 v) {
+        v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+        v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+        return _mm_cvtss_f32(v);
+    }
+
+    // Lane mask for MOUSE_MOVE (type 0) with speed > 0 over 4 records
+    static __m128 moveMask4(const uint8_t* type, const float* speed) {
+        const int packed = static_cast<int>(type[0]) | (static_cast<int>(type[1]) << 8) |
+            (static_cast<int>(type[2]) << 16) | (static_cast<int>(type[3]) << 24);
+        __m128i bytes = _mm_cvtsi32_si128(packed);
+        __m128i zero = _mm_setzero_si128();
+        __m128i words = _mm_unpacklo_epi8(bytes, zero);
+        __m128i dwords = _mm_unpacklo_epi16(words, zero);
+        __m128 isMove = _mm_castsi128_ps(_mm_cmpeq_epi32(dwords, _mm_set1_epi32(MOUSE_MOVE)));
+        return _mm_and_ps(isMove, _mm_cmpgt_ps(_mm_loadu_ps(speed), _mm_setzero_ps()));
+    }
+
+    static void sse2Counts(const uint8_t* type, size_t n, uint64_t* counts) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(type + i));
+            for (int t = 0; t < EVENT_TYPE_COUNT; t++) {
+                const __m128i eq = _mm_cmpeq_epi8(block, _mm_set1_epi8(static_cast<char>(t)));
+                counts[t] += bitCount(static_cast<unsigned int>(_mm_movemask_epi8(eq)));
+            }
+        }
+        scalarCounts(type, i, n, counts);
+    }
+
+    static size_t sse2SpeedSums(const uint8_t* type, const float* speed, size_t n,
+        double& sum, uint64_t& count, float& minValue, float& maxValue) {
+        __m128d sumLow = _mm_setzero_pd(), sumHigh = _mm_setzero_pd();
+        __m128 minV = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        __m128 maxV = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+        const __m128 inf = minV, negInf = maxV;
+
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            const __m128 mask = moveMask4(type + i, speed + i);
+            const __m128 values = _mm_loadu_ps(speed + i);
+            const __m128 kept = _mm_and_ps(mask, values);
+            sumLow = _mm_add_pd(sumLow, _mm_cvtps_pd(kept));
+            sumHigh = _mm_add_pd(sumHigh, _mm_cvtps_pd(_mm_movehl_ps(kept, kept)));
+            minV = _mm_min_ps(minV, _mm_or_ps(_mm_and_ps(mask, values), _mm_andnot_ps(mask, inf)));
+            maxV = _mm_max_ps(maxV, _mm_or_ps(_mm_and_ps(mask, values), _mm_andnot_ps(mask, negInf)));
+            count += bitCount(static_cast<unsigned int>(_mm_movemask_ps(mask)));
+        }
+        sum += horizontalSum(_mm_add_pd(sumLow, sumHigh));
+        if (horizontalMin(minV) < minValue) minValue = horizontalMin(minV);
+        if (horizontalMax(maxV) > maxValue) maxValue = horizontalMax(maxV);
+        return i;
+    }
+
+    static size_t sse2SquaredDeviations(const uint8_t* type, const float* speed, size_t n, double mean, double& total) {
+        const __m128d meanV = _mm_set1_pd(mean);
+        __m128d acc = _mm_setzero_pd();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            const __m128 mask = moveMask4(type + i, speed + i);
+            const __m128 values = _mm_loadu_ps(speed + i);
+            const __m128d maskLow = _mm_castsi128_pd(_mm_unpacklo_epi32(_mm_castps_si128(mask), _mm_castps_si128(mask)));
+            const __m128d maskHigh = _mm_castsi128_pd(_mm_unpackhi_epi32(_mm_castps_si128(mask), _mm_castps_si128(mask)));
+            const __m128d dLow = _mm_and_pd(maskLow, _mm_sub_pd(_mm_cvtps_pd(values), meanV));
+            const __m128d dHigh = _mm_and_pd(maskHigh, _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(values, values)), meanV));
+            acc = _mm_add_pd(acc, _mm_add_pd(_mm_mul_pd(dLow, dLow), _mm_mul_pd(dHigh, dHigh)));
+        }
+        total += horizontalSum(acc);
+        return i;
+    }
+
+    static size_t sse2Distance(const int32_t* x, const int32_t* y, size_t n, double& total) {
+        __m128d acc = _mm_setzero_pd();
+        size_t i = 1;
+        for (; i + 4 <= n; i += 4) {
+            const __m128 dx = _mm_cvtepi32_ps(_mm_sub_epi32(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i - 1))));
+            const __m128 dy = _mm_cvtepi32_ps(_mm_sub_epi32(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i - 1))));
+            const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+            acc = _mm_add_pd(acc, _mm_add_pd(_mm_cvtps_pd(length), _mm_cvtps_pd(_mm_movehl_ps(length, length))));
+        }
+        total += horizontalSum(acc);
+        return i;
+    }
+
+    BC_TARGET_AVX2 static double avx2HorizontalSum(__m256d v) {
+        return horizontalSum(_mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1)));
+    }
+
+    BC_TARGET_AVX2 static __m256 avx2MoveMask8(const uint8_t* type, const float* speed) {
+        const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(type));
+        const __m256i dwords = _mm256_cvtepu8_epi32(bytes);
+        const __m256 isMove = _mm256_castsi256_ps(_mm256_cmpeq_epi32(dwords, _mm256_set1_epi32(MOUSE_MOVE)));
+        return _mm256_and_ps(isMove, _mm256_cmp_ps(_mm256_loadu_ps(speed), _mm256_setzero_ps(), _CMP_GT_OQ));
+    }
+
+    BC_TARGET_AVX2 static void avx2Counts(const uint8_t* type, size_t n, uint64_t* counts) {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(type + i));
+            for (int t = 0; t < EVENT_TYPE_COUNT; t++) {
+                const __m256i eq = _mm256_cmpeq_epi8(block, _mm256_set1_epi8(static_cast<char>(t)));
+                counts[t] += bitCount(static_cast<unsigned int>(_mm256_movemask_epi8(eq)));
+            }
+        }
+        scalarCounts(type, i, n, counts);
+    }
+
+    BC_TARGET_AVX2 static size_t avx2SpeedSums(const uint8_t* type, const float* speed, size_t n,
+        double& sum, uint64_t& count, float& minValue, float& maxValue) {
+        __m256d sumV = _mm256_setzero_pd();
+        const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+        const __m256 negInf = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+        __m256 minV = inf, maxV = negInf;
+
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            const __m256 mask = avx2MoveMask8(type + i, speed + i);
+            const __m256 values = _mm256_loadu_ps(speed + i);
+            const __m256 kept = _mm256_and_ps(mask, values);
+            sumV = _mm256_add_pd(sumV, _mm256_cvtps_pd(_mm256_castps256_ps128(kept)));
+            sumV = _mm256_add_pd(sumV, _mm256_cvtps_pd(_mm256_extractf128_ps(kept, 1)));
+            minV = _mm256_min_ps(minV, _mm256_blendv_ps(inf, values, mask));
+            maxV = _mm256_max_ps(maxV, _mm256_blendv_ps(negInf, values, mask));
+            count += bitCount(static_cast<unsigned int>(_mm256_movemask_ps(mask)));
+        }
+        sum += avx2HorizontalSum(sumV);
+        const float laneMin = horizontalMin(_mm_min_ps(_mm256_castps256_ps128(minV), _mm256_extractf128_ps(minV, 1)));
+        const float laneMax = horizontalMax(_mm_max_ps(_mm256_castps256_ps128(maxV), _mm256_extractf128_ps(maxV, 1)));
+        if (laneMin < minValue) minValue = laneMin;
+        if (laneMax > maxValue) maxValue = laneMax;
+        return i;
+    }
+
+    BC_TARGET_AVX2 static size_t avx2SquaredDeviations(const uint8_t* type, const float* speed, size_t n,
+        double mean, double& total) {
+        const __m256d meanV = _mm256_set1_pd(mean);
+        __m256d acc = _mm256_setzero_pd();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            const __m256 mask = avx2MoveMask8(type + i, speed + i);
+            const __m256 values = _mm256_loadu_ps(speed + i);
+            const __m256d maskLow = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(_mm256_castps_si256(mask))));
+            const __m256d maskHigh = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_extracti128_si256(_mm256_castps_si256(mask), 1)));
+            const __m256d dLow = _mm256_and_pd(maskLow, _mm256_sub_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(values)), meanV));
+            const __m256d dHigh = _mm256_and_pd(maskHigh, _mm256_sub_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(values, 1)), meanV));
+            acc = _mm256_add_pd(acc, _mm256_add_pd(_mm256_mul_pd(dLow, dLow), _mm256_mul_pd(dHigh, dHigh)));
+        }
+        total += avx2HorizontalSum(acc);
+        return i;
+    }
+
+    BC_TARGET_AVX2 static size_t avx2Distance(const int32_t* x, const int32_t* y, size_t n, double& total) {
+        __m256d acc = _mm256_setzero_pd();
+        size_t i = 1;
+        for (; i + 8 <= n; i += 8) {
+            const __m256 dx = _mm256_cvtepi32_ps(_mm256_sub_epi32(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i - 1))));
+            const __m256 dy = _mm256_cvtepi32_ps(_mm256_sub_epi32(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + i - 1))));
+            const __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+            acc = _mm256_add_pd(acc, _mm256_cvtps_pd(_mm256_castps256_ps128(length)));
+            acc = _mm256_add_pd(acc, _mm256_cvtps_pd(_mm256_extractf128_ps(length, 1)));
+        }
+        total += avx2HorizontalSum(acc);
+        return i;
+    }
+#endif
+
+public:
+    static ColumnStats compute(const EventColumns& columns, SimdLevel level) {
+        ColumnStats stats = {};
+        const size_t n = columns.size();
+        const uint8_t* type = columns.type.data();
+        const float* speed = columns.speed.data();
+        const int32_t* x = columns.x.data();
+        const int32_t* y = columns.y.data();
+
+        double sum = 0.0;
+        uint64_t count = 0;
+        float minValue = std::numeric_limits<float>::infinity();
+        float maxValue = -std::numeric_limits<float>::infinity();
+        size_t speedDone = 0, distanceDone = 0;
+
+#if defined(BC_HAVE_X86_SIMD)
+        if (level == SIMD_AVX2) {
+            avx2Counts(type, n, stats.countByType);
+            speedDone = avx2SpeedSums(type, speed, n, sum, count, minValue, maxValue);
+            distanceDone = avx2Distance(x, y, n, stats.distancePx);
+        }
+        else if (level == SIMD_SSE2) {
+            sse2Counts(type, n, stats.countByType);
+            speedDone = sse2SpeedSums(type, speed, n, sum, count, minValue, maxValue);
+            distanceDone = sse2Distance(x, y, n, stats.distancePx);
+        }
+        else
+#endif
+        {
+            (void)level;
+            scalarCounts(type, 0, n, stats.countByType);
+        }
+
+        // Scalar tails (or the whole range without SIMD)
+        scalarSpeedSums(type, speed, speedDone, n, sum, count, minValue, maxValue);
+        stats.distancePx += scalarDistance(x, y, distanceDone, n);
+
+        stats.speedCount = count;
+        stats.speedMean = count > 0 ? sum / static_cast<double>(count) : 0.0;
+        stats.speedMin = count > 0 ? minValue : 0.0f;
+        stats.speedMax = count > 0 ? maxValue : 0.0f;
+
+        if (count > 1) {
+            double deviations = 0.0;
+            size_t done = 0;
+#if defined(BC_HAVE_X86_SIMD)
+            if (level == SIMD_AVX2) done = avx2SquaredDeviations(type, speed, n, stats.speedMean, deviations);
+            else if (level == SIMD_SSE2) done = sse2SquaredDeviations(type, speed, n, stats.speedMean, deviations);
+#endif
+            deviations += scalarSquaredDeviations(type, speed, done, n, stats.speedMean);
+            stats.speedVariance = deviations / static_cast<double>(count - 1);
+        }
+        return stats;
+    }
+};
+
+// Runs the best kernel set for this machine (detected once)
+inline ColumnStats computeColumnStats(const EventColumns& columns) {
+    static const SimdLevel level = detectSimdLevel();
+    return ColumnStatsKernels::compute(columns, level);
+}
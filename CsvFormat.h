@@ -0,0 +1,145 @@
+#pragma once
+
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "BehavioralEvent.h"
+#include "MonitorTable.h"
+
+// Column layout shared by the live CSV writer and the binary log exporter
+const char* const CSV_HEADER =
+    "timestamp,event_type,x,y,key_code,wheel_delta,time_since_last,"
+    "active_app,background_apps,mouse_speed_pxps,dwell_ms,flight_ms,repeat_count,"
+    "monitor,norm_x,norm_y,mouse_speed_mmps";
+
+// Rows end in CRLF, the same bytes a text-mode stream produced on Windows
+const char CSV_LINE_END[] = "\r\n";
+
+// Worst-case length of a row excluding the app name (largest float speed
+// in fixed notation is 42 characters, and it appears twice)
+const size_t CSV_ROW_MAX_WITHOUT_APP = 224;
+
+// Reusable block of formatted CSV rows.
+// Rows are written in place with std::to_chars, so formatting does no
+// allocation (once the block has grown to its working size) and no locale
+// lookups. The output matches the former ostringstream formatting byte for
+// byte, including std::fixed << std::setprecision(2) for the speed.
+// Key records print 0 for x/y, key_code and wheel_delta; dwell_ms, flight_ms and
+// repeat_count are only filled for KEY_UP (the timings left empty when
+// unknown). monitor is filled for mouse records on a known monitor, and
+// norm_x, norm_y (0 to 1 across that monitor) and mouse_speed_mmps when the
+// row is formatted with the MonitorTable the record refers to.
+class CsvBlock {
+private:
+    std::vector<char> data;
+    size_t used;
+    size_t rows;
+
+    void ensureSpace(size_t needed) {
+        if (data.size() - used < needed) {
+            size_t newSize = data.size() * 2;
+            if (newSize < used + needed) newSize = used + needed;
+            data.resize(newSize);
+        }
+    }
+
+    template <typename T>
+    static char* putNumber(char* out, char* end, T value) {
+        return std::to_chars(out, end, value).ptr;
+    }
+
+    static char* putKeyTiming(char* out, char* end, int32_t value) {
+        return value == KEY_TIMING_NONE ? out : putNumber(out, end, value);
+    }
+
+public:
+    explicit CsvBlock(size_t initialCapacity = 16 * 1024) :
+        data(initialCapacity > 0 ? initialCapacity : CSV_ROW_MAX_WITHOUT_APP),
+        used(0),
+        rows(0) {}
+
+    // Appends an arbitrary line (e.g. the header) followed by CSV_LINE_END
+    void appendLine(const char* text, size_t length) {
+        ensureSpace(length + sizeof(CSV_LINE_END));
+        memcpy(data.data() + used, text, length);
+        used += length;
+        memcpy(data.data() + used, CSV_LINE_END, sizeof(CSV_LINE_END) - 1);
+        used += sizeof(CSV_LINE_END) - 1;
+    }
+
+    // Starts the next row with an extra leading column, e.g. the session of
+    // a CaptureService log; appendRow() completes it
+    void appendLeadingField(uint32_t value) {
+        ensureSpace(16);
+        char* out = putNumber(data.data() + used, data.data() + data.size(), value);
+        *out++ = ',';
+        used = out - data.data();
+    }
+
+    void appendRow(const BehavioralEvent& event, const std::string& appName, const MonitorTable* monitors = nullptr) {
+        ensureSpace(CSV_ROW_MAX_WITHOUT_APP + appName.size());
+        char* out = data.data() + used;
+        char* end = data.data() + data.size();
+
+        out = putNumber(out, end, event.timestamp);
+        *out++ = ',';
+        out = putNumber(out, end, static_cast<int>(event.type));
+        *out++ = ',';
+        const bool isKey = event.type == KEY_DOWN || event.type == KEY_UP;
+        out = putNumber(out, end, isKey ? 0 : event.x);
+        *out++ = ',';
+        out = putNumber(out, end, isKey ? 0 : event.y);
+        *out++ = ',';
+        out = putNumber(out, end, isKey ? static_cast<int>(event.keyCode) : 0);
+        *out++ = ',';
+        out = putNumber(out, end, isKey ? 0 : event.wheelDelta);
+        *out++ = ',';
+        out = putNumber(out, end, event.timeSinceLast);
+        *out++ = ',';
+        memcpy(out, appName.data(), appName.size());
+        out += appName.size();
+        *out++ = ',';
+        out = putNumber(out, end, event.backgroundAppCount);
+        *out++ = ',';
+        out = std::to_chars(out, end, static_cast<double>(event.mouseSpeed), std::chars_format::fixed, 2).ptr;
+        *out++ = ',';
+        if (event.type == KEY_UP) out = putKeyTiming(out, end, event.dwellTime);
+        *out++ = ',';
+        if (event.type == KEY_UP) out = putKeyTiming(out, end, event.flightTime);
+        *out++ = ',';
+        if (event.type == KEY_UP) out = putNumber(out, end, event.repeatCount);
+        *out++ = ',';
+        if (!isKey && event.monitor != MONITOR_NONE) out = putNumber(out, end, static_cast<int>(event.monitor));
+        *out++ = ',';
+        NormalizedMouse normalized;
+        if (monitors && monitors->normalize(event, normalized)) {
+            out = std::to_chars(out, end, static_cast<double>(normalized.x), std::chars_format::fixed, 4).ptr;
+            *out++ = ',';
+            out = std::to_chars(out, end, static_cast<double>(normalized.y), std::chars_format::fixed, 4).ptr;
+            *out++ = ',';
+            out = std::to_chars(out, end, static_cast<double>(normalized.speedMmps), std::chars_format::fixed, 2).ptr;
+        }
+        else {
+            *out++ = ',';
+            *out++ = ',';
+        }
+        *out++ = CSV_LINE_END[0];
+        *out++ = CSV_LINE_END[1];
+
+        used = out - data.data();
+        rows++;
+    }
+
+    const char* bytes() const { return data.data(); }
+    size_t size() const { return used; }
+    size_t rowCount() const { return rows; }
+    bool empty() const { return used == 0; }
+
+    // Keeps the allocation for the next batch
+    void clear() {
+        used = 0;
+        rows = 0;
+    }
+};
@@ -0,0 +1,142 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+#include "BehavioralEvent.h"
+#include "CsvFormat.h"
+
+// Microbenchmark for the CSV formatting path: the previous per-event
+// ostringstream + std::string buffer versus CsvBlock (std::to_chars into
+// a reusable block). Both produce the same bytes; the tool checks that.
+
+// The formatting addEvent() and BufferedWriter used before CsvBlock
+// (extended with the dwell/flight/repeat and monitor columns CsvBlock has
+// since gained; rows are formatted without a monitor table, so the
+// normalized columns stay empty)
+static std::string legacyFormatRow(const BehavioralEvent& event, const std::string& appName) {
+    const bool isKey = event.type == KEY_DOWN || event.type == KEY_UP;
+    std::ostringstream oss;
+    oss << event.timestamp << ","
+        << static_cast<int>(event.type) << ","
+        << (isKey ? 0 : event.x) << ","
+        << (isKey ? 0 : event.y) << ","
+        << (isKey ? static_cast<int>(event.keyCode) : 0) << ","
+        << (isKey ? 0 : event.wheelDelta) << ","
+        << event.timeSinceLast << ","
+        << appName << ","
+        << event.backgroundAppCount << ","
+        << std::fixed << std::setprecision(2) << event.mouseSpeed << ",";
+    if (event.type == KEY_UP && event.dwellTime != KEY_TIMING_NONE) oss << event.dwellTime;
+    oss << ",";
+    if (event.type == KEY_UP && event.flightTime != KEY_TIMING_NONE) oss << event.flightTime;
+    oss << ",";
+    if (event.type == KEY_UP) oss << event.repeatCount;
+    oss << ",";
+    if (!isKey && event.monitor != MONITOR_NONE) oss << static_cast<int>(event.monitor);
+    oss << ",,,";
+    return oss.str();
+}
+
+static std::vector<BehavioralEvent> makeEvents(size_t count) {
+    std::vector<BehavioralEvent> events(count);
+    long long timestamp = 1759261340935LL;
+    unsigned int seed = 12345;
+    auto next = [&seed]() { seed = seed * 1103515245u + 12345u; return (seed >> 16) & 0x7FFF; };
+
+    for (auto& event : events) {
+        event = BehavioralEvent();
+        event.timeSinceLast = 1 + next() % 50;
+        timestamp += event.timeSinceLast;
+        event.timestamp = timestamp;
+        event.appId = static_cast<uint16_t>(next() % 4);
+        event.backgroundAppCount = 345;
+
+        unsigned int kind = next() % 10;
+        if (kind < 7) {
+            event.type = MOUSE_MOVE;
+            event.x = next() % 3840;
+            event.y = next() % 2160;
+            event.mouseSpeed = static_cast<float>(next()) / 7.0f;
+        }
+        else if (kind < 9) {
+            event.type = (kind == 7) ? KEY_DOWN : KEY_UP;
+            event.keyCode = static_cast<uint8_t>(0x41 + next() % 26);
+            if (event.type == KEY_UP) {
+                event.dwellTime = 40 + next() % 120;
+                event.flightTime = (next() % 8 == 0) ? KEY_TIMING_NONE : static_cast<int32_t>(next() % 400) - 50;
+                event.repeatCount = (next() % 16 == 0) ? static_cast<uint16_t>(next() % 40) : 0;
+            }
+        }
+        else {
+            event.type = MOUSE_WHEEL;
+            event.x = next() % 1920;
+            event.y = next() % 1080;
+            event.wheelDelta = (next() & 1) ? 120 : -120;
+        }
+    }
+    return events;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t eventCount = argc > 1 ? static_cast<size_t>(std::atoll(argv[1])) : 1000000;
+    const size_t batchSize = 100;  // Rows per flush, as in BufferedWriter
+    const std::string appNames[] = { "chrome.exe", "devenv.exe", "VsDebugConsole.exe", "explorer.exe" };
+    const std::vector<BehavioralEvent> events = makeEvents(eventCount);
+
+    // Before: one ostringstream and one std::string per event, copied into a vector
+    std::string legacyOutput;
+    auto legacyStart = std::chrono::steady_clock::now();
+    {
+        std::vector<std::string> buffer;
+        for (const auto& event : events) {
+            buffer.push_back(legacyFormatRow(event, appNames[event.appId]));
+            if (buffer.size() >= batchSize) {
+                for (const auto& line : buffer) {
+                    legacyOutput += line;
+                    legacyOutput += CSV_LINE_END;
+                }
+                buffer.clear();
+            }
+        }
+        for (const auto& line : buffer) {
+            legacyOutput += line;
+            legacyOutput += CSV_LINE_END;
+        }
+    }
+    double legacySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - legacyStart).count();
+
+    // After: rows formatted in place into a reused block
+    std::string blockOutput;
+    blockOutput.reserve(legacyOutput.size());
+    auto blockStart = std::chrono::steady_clock::now();
+    {
+        CsvBlock block;
+        for (const auto& event : events) {
+            block.appendRow(event, appNames[event.appId]);
+            if (block.rowCount() >= batchSize) {
+                blockOutput.append(block.bytes(), block.size());
+                block.clear();
+            }
+        }
+        blockOutput.append(block.bytes(), block.size());
+    }
+    double blockSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - blockStart).count();
+
+    std::cout << "Events formatted: " << eventCount << " (" << legacyOutput.size() << " bytes)" << std::endl;
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "ostringstream:  " << (eventCount / legacySeconds) << " events/sec" << std::endl;
+    std::cout << "CsvBlock:       " << (eventCount / blockSeconds) << " events/sec" << std::endl;
+    std::cout << std::setprecision(1) << "Speedup:        " << (legacySeconds / blockSeconds) << "x" << std::endl;
+
+    if (legacyOutput != blockOutput) {
+        std::cerr << "Output mismatch between formatters!" << std::endl;
+        return 1;
+    }
+    std::cout << "Output identical: yes" << std::endl;
+    return 0;
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MonitorTable.h"
+
+// Cached monitor geometry and DPI for the capture.
+//
+// The table is built on start() and rebuilt whenever Windows broadcasts
+// WM_DISPLAYCHANGE, which a hidden top-level window on a small watcher
+// thread receives (message-only windows do not get broadcasts). Readers
+// load the current table through one atomic pointer, so the hook path
+// finds a record's monitor with a few compares and no Win32 call, and the
+// writers turn it into normalized coordinates and mm/s with multiplies.
+// Tables are immutable once published and kept until stop(), so a reader
+// never sees one freed; display changes are rare enough for that to cost
+// nothing. A record captured just before a change may be formatted with
+// the next table; if it no longer falls inside its monitor the normalized
+// columns stay empty.
+//
+// start() makes the process per-monitor DPI aware, so monitor rectangles,
+// hook coordinates and GetCursorPos all use physical pixels. DPI is the
+// monitor's physical density (MDT_RAW_DPI) when the display reports one,
+// else its effective DPI, else 96. shcore.dll is loaded on demand, as
+// systems before Windows 8.1 do not have it.
+class DisplayGeometry : public MonitorTableSource {
+private:
+    typedef HRESULT(WINAPI* GetDpiForMonitorFn)(HMONITOR, int, UINT*, UINT*);
+    typedef BOOL(WINAPI* SetProcessDpiAwarenessContextFn)(HANDLE);
+    typedef HRESULT(WINAPI* SetProcessDpiAwarenessFn)(int);
+
+    static const int MDT_EFFECTIVE_DPI_VALUE = 0;
+    static const int MDT_RAW_DPI_VALUE = 2;
+    static const int PROCESS_PER_MONITOR_DPI_AWARE_VALUE = 2;
+
+    HMODULE shcore;
+    GetDpiForMonitorFn getDpiForMonitor;
+    std::atomic<const MonitorTable*> current;
+    std::vector<std::unique_ptr<MonitorTable>> tables;  // Every table published since start()
+    std::mutex tablesMutex;
+    uint32_t lastGeneration;  // Never reset, so a writer can tell a restart's table from the old one
+    HWND window;
+    std::thread thread;
+    std::atomic<DWORD> threadId;
+    std::atomic<int> startState;  // 0 starting, 1 running, -1 failed
+    std::atomic<unsigned long long> displayChanges;
+
+    static const char* windowClassName() {
+        return "BehavioralCaptureDisplayWatcher";
+    }
+
+    // Per-monitor awareness, newest API first; fails harmlessly when the
+    // manifest or an earlier call already set it
+    static void becomeDpiAware(HMODULE shcoreModule) {
+        HMODULE user32 = GetModuleHandleA("user32.dll");
+        SetProcessDpiAwarenessContextFn setContext = user32
+            ? reinterpret_cast<SetProcessDpiAwarenessContextFn>(GetProcAddress(user32, "SetProcessDpiAwarenessContext"))
+            : NULL;
+        if (setContext && setContext(reinterpret_cast<HANDLE>(static_cast<LONG_PTR>(-4)))) return;  // PER_MONITOR_AWARE_V2
+
+        SetProcessDpiAwarenessFn setAwareness = shcoreModule
+            ? reinterpret_cast<SetProcessDpiAwarenessFn>(GetProcAddress(shcoreModule, "SetProcessDpiAwareness"))
+            : NULL;
+        if (setAwareness) setAwareness(PROCESS_PER_MONITOR_DPI_AWARE_VALUE);
+    }
+
+    struct EnumContext {
+        DisplayGeometry* geometry;
+        MonitorTable* table;
+    };
+
+    uint32_t monitorDpi(HMONITOR monitor) const {
+        if (!getDpiForMonitor) return DEFAULT_MONITOR_DPI;
+        UINT dpiX = 0, dpiY = 0;
+        if (getDpiForMonitor(monitor, MDT_RAW_DPI_VALUE, &dpiX, &dpiY) == S_OK && dpiX > 0) return dpiX;
+        if (getDpiForMonitor(monitor, MDT_EFFECTIVE_DPI_VALUE, &dpiX, &dpiY) == S_OK && dpiX > 0) return dpiX;
+        return DEFAULT_MONITOR_DPI;
+    }
+
+    static BOOL CALLBACK MonitorEnumProc(HMONITOR monitor, HDC, LPRECT bounds, LPARAM param) {
+        EnumContext* context = reinterpret_cast<EnumContext*>(param);
+        if (context->table->monitors.size() >= MAX_MONITORS) return FALSE;
+        context->table->monitors.push_back(MonitorTable::makeMonitor(
+            bounds->left, bounds->top, bounds->right - bounds->left, bounds->bottom - bounds->top,
+            context->geometry->monitorDpi(monitor)));
+        return TRUE;
+    }
+
+    // Builds and publishes a new table; keeps the old one if enumeration fails
+    void refresh() {
+        std::unique_ptr<MonitorTable> table(new MonitorTable());
+        EnumContext context = { this, table.get() };
+        if (!EnumDisplayMonitors(NULL, NULL, MonitorEnumProc, reinterpret_cast<LPARAM>(&context)) ||
+            table->monitors.empty()) {
+            return;
+        }
+        // Enumeration order is not defined; sort so indices are stable across rebuilds
+        std::sort(table->monitors.begin(), table->monitors.end(), [](const MonitorInfo& a, const MonitorInfo& b) {
+            return a.left != b.left ? a.left < b.left : a.top < b.top;
+        });
+
+        std::lock_guard<std::mutex> lock(tablesMutex);
+        table->generation = ++lastGeneration;
+        current.store(table.get(), std::memory_order_release);
+        tables.push_back(std::move(table));
+    }
+
+    static LRESULT CALLBACK WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+        if (message == WM_NCCREATE) {
+            CREATESTRUCTA* create = reinterpret_cast<CREATESTRUCTA*>(lParam);
+            SetWindowLongPtrA(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(create->lpCreateParams));
+        }
+        else if (message == WM_DISPLAYCHANGE) {
+            DisplayGeometry* geometry = reinterpret_cast<DisplayGeometry*>(GetWindowLongPtrA(hwnd, GWLP_USERDATA));
+            if (geometry) {
+                geometry->refresh();
+                geometry->displayChanges.store(geometry->displayChanges.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+            }
+        }
+        return DefWindowProcA(hwnd, message, wParam, lParam);
+    }
+
+    void threadProc() {
+        threadId = GetCurrentThreadId();
+        HINSTANCE module = GetModuleHandleA(NULL);
+        WNDCLASSEXA windowClass;
+        ZeroMemory(&windowClass, sizeof(windowClass));
+        windowClass.cbSize = sizeof(windowClass);
+        windowClass.lpfnWndProc = WindowProc;
+        windowClass.hInstance = module;
+        windowClass.lpszClassName = windowClassName();
+        RegisterClassExA(&windowClass);  // Fails harmlessly if already registered
+
+        // Never shown; a top-level window so the broadcast reaches it
+        window = CreateWindowExA(WS_EX_TOOLWINDOW, windowClassName(), "", WS_POPUP, 0, 0, 0, 0, NULL, NULL, module, this);
+        if (window == NULL) {
+            startState = -1;
+            return;
+        }
+        startState = 1;
+
+        MSG msg;
+        while (GetMessage(&msg, NULL, 0, 0) > 0) {
+            DispatchMessage(&msg);
+        }
+        DestroyWindow(window);
+        window = NULL;
+    }
+
+public:
+    DisplayGeometry() :
+        shcore(NULL),
+        getDpiForMonitor(NULL),
+        current(nullptr),
+        lastGeneration(0),
+        window(NULL),
+        threadId(0),
+        startState(0),
+        displayChanges(0) {}
+
+    ~DisplayGeometry() {
+        stop();
+    }
+
+    DisplayGeometry(const DisplayGeometry&) = delete;
+    DisplayGeometry& operator=(const DisplayGeometry&) = delete;
+
+    // Publishes the first table before returning. Without a watcher window
+    // the table is still valid, it just is not refreshed on display changes.
+    bool start() {
+        stop();
+        shcore = LoadLibraryA("shcore.dll");
+        getDpiForMonitor = shcore
+            ? reinterpret_cast<GetDpiForMonitorFn>(GetProcAddress(shcore, "GetDpiForMonitor"))
+            : NULL;
+        becomeDpiAware(shcore);
+        displayChanges = 0;
+        refresh();
+        if (current.load(std::memory_order_relaxed) == nullptr) return false;
+
+        startState = 0;
+        thread = std::thread(&DisplayGeometry::threadProc, this);
+        while (startState == 0) {
+            Sleep(1);
+        }
+        if (startState < 0) {
+            thread.join();
+            std::cerr << "Failed to create display change window, monitor table will not be refreshed" << std::endl;
+        }
+        return true;
+    }
+
+    // Readers must be done with the tables (hooks removed, writers flushed)
+    void stop() {
+        if (thread.joinable()) {
+            PostThreadMessageA(threadId, WM_QUIT, 0, 0);
+            thread.join();
+        }
+        current.store(nullptr, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(tablesMutex);
+            tables.clear();
+        }
+        if (shcore) {
+            FreeLibrary(shcore);
+            shcore = NULL;
+            getDpiForMonitor = NULL;
+        }
+    }
+
+    // The table in effect, or null before start(); valid until stop()
+    const MonitorTable* getTable() const override {
+        return current.load(std::memory_order_acquire);
+    }
+
+    // Hook path: monitor index of a point, MONITOR_NONE without a table
+    uint8_t monitorAt(int32_t x, int32_t y) const {
+        const MonitorTable* table = current.load(std::memory_order_acquire);
+        return table ? table->find(x, y) : MONITOR_NONE;
+    }
+
+    // False when the watcher window could not be created
+    bool isWatching() const {
+        return thread.joinable();
+    }
+
+    unsigned long long getDisplayChanges() const {
+        return displayChanges.load(std::memory_order_relaxed);
+    }
+
+    // "2 monitors: 2560x1440 at 0,0 (109 dpi), ..."
+    std::string describe() const {
+        const MonitorTable* table = getTable();
+        if (!table) return "off";
+        std::string text = std::to_string(table->monitors.size()) + (table->monitors.size() == 1 ? " monitor:" : " monitors:");
+        for (size_t i = 0; i < table->monitors.size(); i++) {
+            const MonitorInfo& monitor = table->monitors[i];
+            text += (i > 0 ? ", " : " ") + std::to_string(monitor.width) + "x" + std::to_string(monitor.height) +
+                " at " + std::to_string(monitor.left) + "," + std::to_string(monitor.top) +
+                " (" + std::to_string(monitor.dpi) + " dpi)";
+        }
+        return text;
+    }
+};
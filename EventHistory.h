@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+// Fixed-capacity circular history of the most recent records.
+// Appending is O(1); once full, each append overwrites the oldest entry
+// instead of shifting the whole container. Index 0 is the oldest record.
+//
+// One thread appends. Everything except copyRecent() belongs to that thread
+// (or to any thread once it has stopped); copyRecent() may run concurrently
+// on other threads and never makes the writer wait.
+template <typename T>
+class EventHistory {
+private:
+    std::vector<T> storage;
+    size_t start;  // Physical index of the oldest record
+    size_t count;
+    std::atomic<uint64_t> published;  // Records appended since reset(); record s lives in slot s % capacity
+    std::atomic<uint64_t> claimed;    // Records whose slot write has begun, published + 1 while writing
+
+public:
+    class const_iterator {
+    private:
+        const EventHistory* history;
+        size_t index;
+
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        const_iterator(const EventHistory* owner, size_t position) : history(owner), index(position) {}
+
+        reference operator*() const { return (*history)[index]; }
+        pointer operator->() const { return &(*history)[index]; }
+        reference operator[](difference_type n) const { return (*history)[index + n]; }
+
+        const_iterator& operator++() { ++index; return *this; }
+        const_iterator operator++(int) { const_iterator old = *this; ++index; return old; }
+        const_iterator& operator--() { --index; return *this; }
+        const_iterator operator--(int) { const_iterator old = *this; --index; return old; }
+        const_iterator& operator+=(difference_type n) { index += n; return *this; }
+        const_iterator& operator-=(difference_type n) { index -= n; return *this; }
+        const_iterator operator+(difference_type n) const { return const_iterator(history, index + n); }
+        const_iterator operator-(difference_type n) const { return const_iterator(history, index - n); }
+        difference_type operator-(const const_iterator& other) const {
+            return static_cast<difference_type>(index) - static_cast<difference_type>(other.index);
+        }
+
+        bool operator==(const const_iterator& other) const { return index == other.index; }
+        bool operator!=(const const_iterator& other) const { return index != other.index; }
+        bool operator<(const const_iterator& other) const { return index < other.index; }
+        bool operator>(const const_iterator& other) const { return index > other.index; }
+        bool operator<=(const const_iterator& other) const { return index <= other.index; }
+        bool operator>=(const const_iterator& other) const { return index >= other.index; }
+    };
+
+    explicit EventHistory(size_t capacity = 50000) :
+        storage(capacity > 0 ? capacity : 1),
+        start(0),
+        count(0),
+        published(0),
+        claimed(0) {}
+
+    // Drops all records and changes the capacity; no reader may be active
+    void reset(size_t capacity) {
+        storage.assign(capacity > 0 ? capacity : 1, T());
+        start = 0;
+        count = 0;
+        claimed.store(0, std::memory_order_relaxed);
+        published.store(0, std::memory_order_release);
+    }
+
+    // Seqlock write section: the claim is ordered before the slot stores, so
+    // a reader that copied any byte of the new record also sees the claim
+    void push_back(const T& item) {
+        const size_t capacity = storage.size();
+        const uint64_t sequence = published.load(std::memory_order_relaxed);
+        claimed.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        if (count < capacity) {
+            size_t slot = start + count;
+            if (slot >= capacity) slot -= capacity;
+            storage[slot] = item;
+            count++;
+        }
+        else {
+            // Full: overwrite the oldest record and advance the start
+            storage[start] = item;
+            if (++start == capacity) start = 0;
+        }
+        published.store(sequence + 1, std::memory_order_release);
+    }
+
+    // No reader may be active
+    void clear() {
+        start = 0;
+        count = 0;
+        claimed.store(0, std::memory_order_relaxed);
+        published.store(0, std::memory_order_release);
+    }
+
+    const T& operator[](size_t index) const {
+        size_t slot = start + index;
+        if (slot >= storage.size()) slot -= storage.size();
+        return storage[slot];
+    }
+
+    const T& front() const { return (*this)[0]; }
+    const T& back() const { return (*this)[count - 1]; }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return storage.size(); }
+    bool empty() const { return count == 0; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+    // Copies the records, oldest first, into a contiguous vector
+    std::vector<T> snapshot() const {
+        std::vector<T> result;
+        result.reserve(count);
+        const size_t firstPart = (start + count <= storage.size()) ? count : storage.size() - start;
+        result.insert(result.end(), storage.begin() + start, storage.begin() + start + firstPart);
+        result.insert(result.end(), storage.begin(), storage.begin() + (count - firstPart));
+        return result;
+    }
+
+    // Records appended since reset(), readable from any thread
+    uint64_t getPublishedCount() const {
+        return published.load(std::memory_order_acquire);
+    }
+
+    // Copies up to maxRecords of the most recent records, oldest first, while
+    // the writer keeps appending (seqlock: copy, then read the claimed count
+    // and discard every record whose slot the writer has started to
+    // overwrite meanwhile). T must be trivially copyable. Returns the
+    // sequence number of the first record in out.
+    uint64_t copyRecent(std::vector<T>& out, size_t maxRecords) const {
+        const size_t capacity = storage.size();
+        const uint64_t end = published.load(std::memory_order_acquire);
+        const uint64_t available = std::min<uint64_t>(end, capacity);
+        const uint64_t first = end - std::min<uint64_t>(available, maxRecords);
+
+        out.clear();
+        out.reserve(static_cast<size_t>(end - first));
+        const size_t firstSlot = static_cast<size_t>(first % capacity);
+        const size_t total = static_cast<size_t>(end - first);
+        const size_t firstPart = (std::min)(total, capacity - firstSlot);
+        out.insert(out.end(), storage.begin() + firstSlot, storage.begin() + firstSlot + firstPart);
+        out.insert(out.end(), storage.begin(), storage.begin() + (total - firstPart));
+
+        // Writing record r + capacity (claimed > r + capacity) reuses the
+        // slot of record r, so records below claimed - capacity may be torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t after = claimed.load(std::memory_order_relaxed);
+        uint64_t valid = first;
+        if (after > capacity && after - capacity > first) valid = after - capacity;
+        if (valid > end) valid = end;
+        out.erase(out.begin(), out.begin() + static_cast<size_t>(valid - first));
+        return valid;
+    }
+};
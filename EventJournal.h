@@ -0,0 +1,768 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <vector>
+
+#include "BehavioralEvent.h"
+#include "AppInternTable.h"
+#include "MonitorTable.h"
+#include "CaptureTelemetry.h"
+#include "EventSink.h"
+
+// Crash-safe event journal (.bcj): rolling, preallocated segment files
+// written through a memory mapping.
+//
+// Segment layout:
+//   header page  JournalSegmentHeader, padded to JOURNAL_HEADER_BYTES
+//   slots        fixed-size 32-byte slots, BehavioralEvent as stored in memory
+//
+// An event is a plain store into the mapped view followed by a release
+// store of committedSlots, so once write() returns the record is in the
+// page cache and survives the process being killed; the OS writes it back.
+// Readers trust committedSlots, never the file size, so a torn last slot
+// is never read. Power-loss durability is FlushViewOfFile every
+// flushIntervalMs (off by default).
+//
+// App names are stored in-band so every segment is self-contained: the
+// first event of an app in a segment is preceded by a slot of type
+// JOURNAL_SLOT_APP_NAME (appId = ID, x = name length) and the name bytes in
+// ceil(length / 32) continuation slots. The monitor table works the same
+// way: a slot of type JOURNAL_SLOT_MONITOR_TABLE (x = monitor count, y =
+// table generation) followed by one MonitorInfo per slot, written before
+// the first event of a segment and again after every display change.
+//
+// Segments are named <base>.<index>.bcj (base without its .bcj extension);
+// every session starts with the first index not taken yet, and a cleanly
+// closed segment is truncated to its committed size. The next segment is
+// created and mapped ahead of time by a worker thread, so the file exists
+// with a zeroed header until the writer rolls over to it; readers skip
+// such unstarted segments.
+
+const char JOURNAL_MAGIC[8] = { 'B', 'C', 'J', 'R', 'N', 'L', '\r', '\n' };
+const uint32_t JOURNAL_VERSION = 1;
+const size_t JOURNAL_HEADER_BYTES = 4096;
+const size_t JOURNAL_SLOT_BYTES = sizeof(BehavioralEvent);
+const uint8_t JOURNAL_SLOT_APP_NAME = 0xFF;
+const uint8_t JOURNAL_SLOT_MONITOR_TABLE = 0xFE;
+const size_t JOURNAL_MAX_APP_NAME = 1024;
+
+struct JournalSegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotBytes;                   // JOURNAL_SLOT_BYTES
+    uint64_t segmentIndex;
+    uint64_t capacitySlots;
+    int64_t createdAtMs;
+    int64_t firstTimestamp;               // Of the first event, 0 while empty
+    int64_t lastTimestamp;                // Of the last committed event
+    uint32_t closedCleanly;               // 1 once the writer closed the segment
+    uint32_t reserved;
+    std::atomic<uint64_t> committedSlots; // Slots readers may use
+    uint64_t committedEvents;             // Event slots among them
+};
+
+static_assert(sizeof(JournalSegmentHeader) <= JOURNAL_HEADER_BYTES, "Journal header must fit its page");
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "Journal commit counter must be a plain 64-bit word");
+static_assert(sizeof(MonitorInfo) <= JOURNAL_SLOT_BYTES, "A monitor table entry must fit one journal slot");
+
+struct JournalOptions {
+    uint64_t segmentSlots = 1 << 20;  // Slots per segment file (32 MB)
+    int flushIntervalMs = 0;          // FlushViewOfFile this often, 0 = leave writeback to the OS
+};
+
+// <base>.<index>.bcj, with a trailing .bcj removed from base first
+inline std::string journalSegmentPath(const std::string& base, uint64_t index) {
+    std::string stem = base;
+    if (stem.size() > 4 && stem.compare(stem.size() - 4, 4, ".bcj") == 0) {
+        stem.resize(stem.size() - 4);
+    }
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%06llu.bcj", static_cast<unsigned long long>(index));
+    return stem + suffix;
+}
+
+// Base name of the journal a segment path belongs to (other paths unchanged)
+inline std::string journalBaseName(const std::string& path) {
+    std::string stem = path;
+    if (stem.size() > 4 && stem.compare(stem.size() - 4, 4, ".bcj") == 0) {
+        stem.resize(stem.size() - 4);
+    }
+    const size_t dot = stem.find_last_of('.');
+    if (dot != std::string::npos && stem.size() - dot == 7 &&
+        stem.find_first_not_of("0123456789", dot + 1) == std::string::npos) {
+        stem.resize(dot);
+    }
+    return stem;
+}
+
+inline bool journalSegmentExists(const std::string& base, uint64_t index) {
+    return GetFileAttributesA(journalSegmentPath(base, index).c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+// False for a segment that was created ahead of time but never written to
+inline bool journalSegmentStarted(const std::string& base, uint64_t index) {
+    HANDLE file = CreateFileA(journalSegmentPath(base, index).c_str(), GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    char magic[sizeof(JOURNAL_MAGIC)] = {};
+    DWORD read = 0;
+    const bool ok = ReadFile(file, magic, sizeof(magic), &read, NULL) && read == sizeof(magic);
+    CloseHandle(file);
+    return ok && memcmp(magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0;
+}
+
+// A created and mapped segment file, header still zeroed
+struct JournalSegmentFile {
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+    uint8_t* view = nullptr;
+    uint64_t index = 0;
+};
+
+// Creates the first free segment at or after index and maps it at its full
+// size; the mapping extends the file up front, which is the slow part
+inline bool createJournalSegment(const std::string& base, uint64_t index, uint64_t capacitySlots,
+    JournalSegmentFile& segment) {
+    const uint64_t size = JOURNAL_HEADER_BYTES + capacitySlots * JOURNAL_SLOT_BYTES;
+    HANDLE file;
+    for (;;) {
+        const std::string path = journalSegmentPath(base, index);
+        file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+            NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file != INVALID_HANDLE_VALUE) break;
+        if (GetLastError() != ERROR_FILE_EXISTS) return false;
+        index++;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE,
+        static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), NULL);
+    uint8_t* view = nullptr;
+    if (mapping != NULL) {
+        view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size)));
+    }
+    if (view == nullptr) {
+        if (mapping != NULL) CloseHandle(mapping);
+        CloseHandle(file);
+        DeleteFileA(journalSegmentPath(base, index).c_str());
+        return false;
+    }
+
+    segment.file = file;
+    segment.mapping = mapping;
+    segment.view = view;
+    segment.index = index;
+    return true;
+}
+
+// Flushes and unmaps a segment and trims the file to usedBytes; a segment
+// that was never started is deleted instead
+inline void closeJournalSegment(const std::string& base, JournalSegmentFile& segment, uint64_t usedBytes) {
+    if (segment.view) {
+        if (usedBytes > 0) FlushViewOfFile(segment.view, 0);
+        UnmapViewOfFile(segment.view);
+        segment.view = nullptr;
+    }
+    if (segment.mapping != NULL) {
+        CloseHandle(segment.mapping);
+        segment.mapping = NULL;
+    }
+    if (segment.file != INVALID_HANDLE_VALUE) {
+        if (usedBytes > 0) {
+            LARGE_INTEGER end;
+            end.QuadPart = static_cast<LONGLONG>(usedBytes);
+            if (SetFilePointerEx(segment.file, end, NULL, FILE_BEGIN)) SetEndOfFile(segment.file);
+        }
+        CloseHandle(segment.file);
+        segment.file = INVALID_HANDLE_VALUE;
+        if (usedBytes == 0) DeleteFileA(journalSegmentPath(base, segment.index).c_str());
+    }
+}
+
+// Keeps the next segment created and mapped, and closes finished ones, on
+// its own thread, so a rollover on the writing thread (the hook thread in
+// sync mode) only swaps views
+class JournalSegmentWorker {
+private:
+    struct Retired {
+        JournalSegmentFile segment;
+        uint64_t usedBytes;
+    };
+
+    std::string baseName;
+    uint64_t capacitySlots;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable prepared;
+    std::thread thread;
+    bool running;
+    bool wanted;               // Create a segment at wantedIndex or after
+    uint64_t wantedIndex;
+    bool preparing;
+    bool ready;                // spare holds a created segment
+    JournalSegmentFile spare;
+    std::vector<Retired> retired;
+
+    void threadProc() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this] { return !running || wanted || !retired.empty(); });
+            if (!retired.empty()) {
+                std::vector<Retired> batch;
+                batch.swap(retired);
+                lock.unlock();
+                for (Retired& entry : batch) closeJournalSegment(baseName, entry.segment, entry.usedBytes);
+                lock.lock();
+                continue;
+            }
+            if (!running) break;
+
+            wanted = false;
+            preparing = true;
+            const uint64_t index = wantedIndex;
+            lock.unlock();
+            JournalSegmentFile segment;
+            const bool created = createJournalSegment(baseName, index, capacitySlots, segment);
+            lock.lock();
+            preparing = false;
+            if (created) {
+                spare = segment;
+                ready = true;
+            }
+            prepared.notify_all();
+        }
+    }
+
+public:
+    JournalSegmentWorker() :
+        capacitySlots(0),
+        running(false),
+        wanted(false),
+        wantedIndex(0),
+        preparing(false),
+        ready(false) {}
+
+    ~JournalSegmentWorker() {
+        stop();
+    }
+
+    JournalSegmentWorker(const JournalSegmentWorker&) = delete;
+    JournalSegmentWorker& operator=(const JournalSegmentWorker&) = delete;
+
+    void start(const std::string& base, uint64_t slots) {
+        stop();
+        baseName = base;
+        capacitySlots = slots;
+        running = true;
+        thread = std::thread(&JournalSegmentWorker::threadProc, this);
+    }
+
+    // Closes what is queued, then deletes a spare nobody took
+    void stop() {
+        if (!thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+            wanted = false;
+        }
+        wake.notify_all();
+        thread.join();
+        if (ready) closeJournalSegment(baseName, spare, 0);
+        ready = false;
+    }
+
+    // Starts creating the segment to roll over to next
+    void prepare(uint64_t index) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            wanted = true;
+            wantedIndex = index;
+        }
+        wake.notify_all();
+    }
+
+    // The prepared segment; waits while it is still being created, false
+    // when it could not be
+    bool take(JournalSegmentFile& segment) {
+        std::unique_lock<std::mutex> lock(mutex);
+        prepared.wait(lock, [this] { return ready || (!wanted && !preparing); });
+        if (!ready) return false;
+        segment = spare;
+        spare = JournalSegmentFile();
+        ready = false;
+        return true;
+    }
+
+    // Hands a finished segment over to be flushed, unmapped and trimmed
+    void retire(const JournalSegmentFile& segment, uint64_t usedBytes) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            retired.push_back({ segment, usedBytes });
+        }
+        wake.notify_all();
+    }
+};
+
+// Appends events to the journal; used from the capture consumer thread
+class JournalWriter : public EventSink {
+private:
+    const AppInternTable* appNames;
+    JournalOptions options;
+    std::string baseName;
+    JournalSegmentFile segment;
+    uint8_t* view;                   // segment.view while open
+    JournalSegmentHeader* header;
+    JournalSegmentWorker worker;
+    uint64_t writePos;               // Slots used in the current segment
+    std::vector<bool> appWritten;    // App IDs already named in the current segment
+    const MonitorTableSource* monitors;
+    uint32_t monitorsWritten;        // Generation of the current segment's monitor table, 0 = none
+    std::mutex writerMutex;
+    std::atomic<unsigned long long> bytesWritten;
+    std::atomic<unsigned long long> segmentCount;
+    unsigned long long droppedEvents;  // A new segment could not be created
+    LatencyHistogram* flushTimes;
+    QpcClock clock;
+    std::chrono::steady_clock::time_point lastFlush;
+
+    static long long nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static size_t nameSlots(size_t length) {
+        return (length + JOURNAL_SLOT_BYTES - 1) / JOURNAL_SLOT_BYTES;
+    }
+
+    uint8_t* slot(uint64_t index) {
+        return view + JOURNAL_HEADER_BYTES + index * JOURNAL_SLOT_BYTES;
+    }
+
+    // Starts writing to a created segment and has the one after it prepared
+    void beginSegment(const JournalSegmentFile& created) {
+        segment = created;
+        view = segment.view;
+        header = new (view) JournalSegmentHeader();
+        header->version = JOURNAL_VERSION;
+        header->slotBytes = static_cast<uint32_t>(JOURNAL_SLOT_BYTES);
+        header->segmentIndex = segment.index;
+        header->capacitySlots = options.segmentSlots;
+        header->createdAtMs = nowMs();
+        header->committedSlots.store(0, std::memory_order_relaxed);
+        // The magic last: readers take a segment with it as started
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+
+        writePos = 0;
+        appWritten.clear();
+        monitorsWritten = 0;
+        segmentCount.store(segmentCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        bytesWritten.store(bytesWritten.load(std::memory_order_relaxed) + JOURNAL_HEADER_BYTES, std::memory_order_relaxed);
+        worker.prepare(segment.index + 1);
+    }
+
+    // Marks the segment closed; the worker trims the unused preallocation
+    void endSegment() {
+        if (view == nullptr) return;
+        header->closedCleanly = 1;
+        worker.retire(segment, JOURNAL_HEADER_BYTES + writePos * JOURNAL_SLOT_BYTES);
+        segment = JournalSegmentFile();
+        view = nullptr;
+        header = nullptr;
+        writePos = 0;
+    }
+
+    // Swaps in the segment the worker prepared, waiting for it only when
+    // the previous one filled up faster than the next could be created
+    bool rollSegment() {
+        const uint64_t nextIndex = segment.index + 1;
+        endSegment();
+        JournalSegmentFile next;
+        if (!worker.take(next)) {
+            segment.index = nextIndex;  // For the error message
+            return false;
+        }
+        beginSegment(next);
+        return true;
+    }
+
+    void writeAppName(uint16_t id) {
+        const std::string& name = appNames->name(id);
+        const size_t length = name.size() < JOURNAL_MAX_APP_NAME ? name.size() : JOURNAL_MAX_APP_NAME;
+
+        BehavioralEvent entry = {};
+        entry.type = JOURNAL_SLOT_APP_NAME;
+        entry.appId = id;
+        entry.x = static_cast<int32_t>(length);
+        memcpy(slot(writePos), &entry, JOURNAL_SLOT_BYTES);
+        memset(slot(writePos + 1), 0, nameSlots(length) * JOURNAL_SLOT_BYTES);
+        memcpy(slot(writePos + 1), name.data(), length);
+        writePos += 1 + nameSlots(length);
+
+        if (id >= appWritten.size()) appWritten.resize(id + 1, false);
+        appWritten[id] = true;
+    }
+
+    bool appNamed(uint16_t id) const {
+        return id < appWritten.size() && appWritten[id];
+    }
+
+    void writeMonitorTable(const MonitorTable& table) {
+        BehavioralEvent entry = {};
+        entry.type = JOURNAL_SLOT_MONITOR_TABLE;
+        entry.x = static_cast<int32_t>(table.monitors.size());
+        entry.y = static_cast<int32_t>(table.generation);
+        memcpy(slot(writePos), &entry, JOURNAL_SLOT_BYTES);
+        for (size_t i = 0; i < table.monitors.size(); i++) {
+            memcpy(slot(writePos + 1 + i), &table.monitors[i], sizeof(MonitorInfo));
+        }
+        writePos += 1 + table.monitors.size();
+        monitorsWritten = table.generation;
+    }
+
+    // table (the source's current one) if the segment does not have it yet
+    const MonitorTable* pendingMonitorTable(const MonitorTable* table) const {
+        return table && table->generation != monitorsWritten ? table : nullptr;
+    }
+
+    // Slots write() needs for event in the current segment, given the
+    // monitor table it will write
+    size_t slotsNeeded(const BehavioralEvent& event, const MonitorTable* table) const {
+        size_t slots = 1;
+        if (const MonitorTable* pending = pendingMonitorTable(table)) slots += 1 + pending->monitors.size();
+        if (appNamed(event.appId)) return slots;
+        const size_t length = appNames->name(event.appId).size();
+        return slots + 1 + nameSlots(length < JOURNAL_MAX_APP_NAME ? length : JOURNAL_MAX_APP_NAME);
+    }
+
+    void flushViewLocked() {
+        lastFlush = std::chrono::steady_clock::now();
+        const long long started = QpcClock::now();
+        FlushViewOfFile(view, static_cast<SIZE_T>(JOURNAL_HEADER_BYTES + writePos * JOURNAL_SLOT_BYTES));
+        if (flushTimes) flushTimes->record(clock.toNs(QpcClock::now() - started));
+    }
+
+public:
+    JournalWriter() :
+        appNames(nullptr),
+        view(nullptr),
+        header(nullptr),
+        writePos(0),
+        monitors(nullptr),
+        monitorsWritten(0),
+        bytesWritten(0),
+        segmentCount(0),
+        droppedEvents(0),
+        flushTimes(nullptr) {}
+
+    ~JournalWriter() {
+        close();
+    }
+
+    JournalWriter(const JournalWriter&) = delete;
+    JournalWriter& operator=(const JournalWriter&) = delete;
+
+    // Optional: records the duration of every FlushViewOfFile
+    void setFlushHistogram(LatencyHistogram* histogram) {
+        flushTimes = histogram;
+    }
+
+    // Optional: monitor geometry recorded next to the events
+    void setMonitorSource(const MonitorTableSource* source) {
+        monitors = source;
+    }
+
+    bool open(const std::string& filename, const AppInternTable& names,
+        const JournalOptions& journalOptions = JournalOptions()) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        appNames = &names;
+        options = journalOptions;
+        if (options.segmentSlots < 64) options.segmentSlots = 64;
+        baseName = filename;
+        droppedEvents = 0;
+        lastFlush = std::chrono::steady_clock::now();
+        JournalSegmentFile first;
+        if (!createJournalSegment(baseName, 0, options.segmentSlots, first)) return false;
+        worker.start(baseName, options.segmentSlots);
+        beginSegment(first);
+        return true;
+    }
+
+    // App names come from the AppInternTable passed to open()
+    void write(const BehavioralEvent& event, const std::string&) override {
+        write(event);
+    }
+
+    void write(const BehavioralEvent& event) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        if (view == nullptr) {
+            droppedEvents++;
+            return;
+        }
+
+        // One fetch for the size check and the write: the source may
+        // publish a new table in between
+        const MonitorTable* table = monitors ? monitors->getTable() : nullptr;
+        if (writePos + slotsNeeded(event, table) > options.segmentSlots && !rollSegment()) {
+            if (droppedEvents++ == 0) {
+                std::cerr << "Failed to create journal segment: " << journalSegmentPath(baseName, segment.index) << std::endl;
+            }
+            return;
+        }
+
+        const uint64_t before = writePos;
+        if (const MonitorTable* pending = pendingMonitorTable(table)) writeMonitorTable(*pending);
+        if (!appNamed(event.appId)) writeAppName(event.appId);
+        memcpy(slot(writePos), &event, JOURNAL_SLOT_BYTES);
+        writePos++;
+
+        if (header->committedEvents == 0) header->firstTimestamp = event.timestamp;
+        header->lastTimestamp = event.timestamp;
+        header->committedEvents++;
+        header->committedSlots.store(writePos, std::memory_order_release);
+        bytesWritten.store(bytesWritten.load(std::memory_order_relaxed) + (writePos - before) * JOURNAL_SLOT_BYTES,
+            std::memory_order_relaxed);
+    }
+
+    // Records are committed as they are written; nothing is buffered
+    void flush() {}
+
+    // Idle-time check for the flushIntervalMs durability policy
+    void flushIfDue() override {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        if (view == nullptr || options.flushIntervalMs <= 0) return;
+        if (std::chrono::steady_clock::now() - lastFlush < std::chrono::milliseconds(options.flushIntervalMs)) return;
+        flushViewLocked();
+    }
+
+    // Going idle: a pending interval flush happens now rather than never
+    void flushAll() override {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        if (view == nullptr || options.flushIntervalMs <= 0) return;
+        flushViewLocked();
+    }
+
+    void close() override {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        endSegment();
+        worker.stop();
+    }
+
+    bool isOpen() const {
+        return view != nullptr;
+    }
+
+    unsigned long long getBytesWritten() const override {
+        return bytesWritten.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long getSegmentCount() const {
+        return segmentCount.load(std::memory_order_relaxed);
+    }
+
+    // Only meaningful once the writer has been closed
+    unsigned long long getDroppedEvents() const {
+        return droppedEvents;
+    }
+};
+
+// Sequential reader over the segments of a journal, used by the CSV export
+// tool. Works on segments that are still being written or were left behind
+// by a crashed writer.
+class JournalReader {
+private:
+    std::string baseName;
+    uint64_t segmentIndex;
+    HANDLE file;
+    HANDLE mapping;
+    const uint8_t* view;
+    uint64_t committed;   // Slots of the current segment
+    uint64_t pos;
+    std::unordered_map<uint16_t, std::string> appNames;
+    MonitorTable monitorTable;
+    bool hasMonitorTable;
+    std::string error;
+    const std::string unknownApp = "Unknown";
+
+    bool fail(const std::string& message) {
+        error = message;
+        return false;
+    }
+
+    const uint8_t* slot(uint64_t index) const {
+        return view + JOURNAL_HEADER_BYTES + index * JOURNAL_SLOT_BYTES;
+    }
+
+    void closeSegment() {
+        if (view) {
+            UnmapViewOfFile(view);
+            view = nullptr;
+        }
+        if (mapping != NULL) {
+            CloseHandle(mapping);
+            mapping = NULL;
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+        }
+        committed = 0;
+        pos = 0;
+    }
+
+    // Maps segment `index`; false when it does not exist or is invalid
+    bool openSegment(uint64_t index) {
+        closeSegment();
+        const std::string path = journalSegmentPath(baseName, index);
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || static_cast<uint64_t>(size.QuadPart) < JOURNAL_HEADER_BYTES) {
+            closeSegment();
+            return fail("Truncated journal segment " + path);
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            view = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (view == nullptr) {
+            closeSegment();
+            return fail("Cannot map journal segment " + path);
+        }
+
+        const JournalSegmentHeader* header = reinterpret_cast<const JournalSegmentHeader*>(view);
+        if (memcmp(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 ||
+            header->slotBytes != JOURNAL_SLOT_BYTES) {
+            closeSegment();
+            return fail("Not a journal segment: " + path);
+        }
+        if (header->version > JOURNAL_VERSION) {
+            closeSegment();
+            return fail("Unsupported journal version: " + path);
+        }
+
+        const uint64_t available = (static_cast<uint64_t>(size.QuadPart) - JOURNAL_HEADER_BYTES) / JOURNAL_SLOT_BYTES;
+        // Plain read: the view is read-only, so no locked instruction on it
+        memcpy(&committed, &header->committedSlots, sizeof(committed));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (committed > available) committed = available;
+        segmentIndex = index;
+        appNames.clear();  // Names and monitor tables are per segment
+        hasMonitorTable = false;
+        return true;
+    }
+
+    // First started segment at or after index, skipping ones created ahead
+    // of time (a live writer's next segment, or left behind by a crash)
+    uint64_t nextStartedSegment(uint64_t index) const {
+        while (journalSegmentExists(baseName, index) && !journalSegmentStarted(baseName, index)) index++;
+        return index;
+    }
+
+public:
+    JournalReader() :
+        segmentIndex(0),
+        file(INVALID_HANDLE_VALUE),
+        mapping(NULL),
+        view(nullptr),
+        committed(0),
+        pos(0),
+        hasMonitorTable(false) {}
+
+    ~JournalReader() {
+        closeSegment();
+    }
+
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    // base as passed to JournalWriter::open(), or any of its segments;
+    // starts at the lowest segment index found among the first
+    // firstIndexScan candidates
+    bool open(const std::string& base, uint64_t firstIndexScan = 1000) {
+        baseName = journalBaseName(base);
+        for (uint64_t index = 0; index < firstIndexScan; index++) {
+            if (journalSegmentExists(baseName, index)) {
+                const uint64_t first = nextStartedSegment(index);
+                if (!journalSegmentExists(baseName, first)) break;
+                return openSegment(first);
+            }
+        }
+        return fail("No journal segments for " + base);
+    }
+
+    // Returns the next event, or false after the last segment (check getError())
+    bool next(BehavioralEvent& event) {
+        for (;;) {
+            if (view == nullptr) return false;
+            if (pos >= committed) {
+                const uint64_t following = nextStartedSegment(segmentIndex + 1);
+                if (!journalSegmentExists(baseName, following)) return false;
+                if (!openSegment(following)) return false;
+                continue;
+            }
+
+            const uint8_t* data = slot(pos);
+            if (data[offsetof(BehavioralEvent, type)] == JOURNAL_SLOT_APP_NAME) {
+                BehavioralEvent entry;
+                memcpy(&entry, data, JOURNAL_SLOT_BYTES);
+                const size_t length = static_cast<size_t>(entry.x);
+                const uint64_t slots = (length + JOURNAL_SLOT_BYTES - 1) / JOURNAL_SLOT_BYTES;
+                if (length > JOURNAL_MAX_APP_NAME || pos + 1 + slots > committed) {
+                    return fail("Corrupt app name in journal segment " + journalSegmentPath(baseName, segmentIndex));
+                }
+                appNames[entry.appId] = std::string(reinterpret_cast<const char*>(slot(pos + 1)), length);
+                pos += 1 + slots;
+                continue;
+            }
+            if (data[offsetof(BehavioralEvent, type)] == JOURNAL_SLOT_MONITOR_TABLE) {
+                BehavioralEvent entry;
+                memcpy(&entry, data, JOURNAL_SLOT_BYTES);
+                const uint64_t count = static_cast<uint32_t>(entry.x);
+                if (count > MAX_MONITORS || pos + 1 + count > committed) {
+                    return fail("Corrupt monitor table in journal segment " + journalSegmentPath(baseName, segmentIndex));
+                }
+                monitorTable.generation = static_cast<uint32_t>(entry.y);
+                monitorTable.monitors.resize(static_cast<size_t>(count));
+                for (uint64_t i = 0; i < count; i++) {
+                    memcpy(&monitorTable.monitors[static_cast<size_t>(i)], slot(pos + 1 + i), sizeof(MonitorInfo));
+                }
+                hasMonitorTable = true;
+                pos += 1 + count;
+                continue;
+            }
+
+            memcpy(&event, data, JOURNAL_SLOT_BYTES);
+            pos++;
+            return true;
+        }
+    }
+
+    const std::string& appName(uint16_t id) const {
+        auto it = appNames.find(id);
+        return it != appNames.end() ? it->second : unknownApp;
+    }
+
+    // The monitor table of the event returned last, null if its segment has none
+    const MonitorTable* monitors() const {
+        return hasMonitorTable ? &monitorTable : nullptr;
+    }
+
+    const std::string& getError() const {
+        return error;
+    }
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+#include "BehavioralEvent.h"
+
+// Destination for recorded events. BehavioralCapture feeds every registered
+// sink from its consumer thread (the drainer, or the hook thread in
+// CAPTURE_MODE_SYNC), in event order. Opening is sink specific and happens
+// before the sink is registered.
+class EventSink {
+public:
+    virtual ~EventSink() {}
+
+    // appName is the active application of event, already resolved
+    virtual void write(const BehavioralEvent& event, const std::string& appName) = 0;
+
+    // Called while no events arrive, lets time-based policies push out
+    // partial batches
+    virtual void flushIfDue() = 0;
+
+    // Called when the capture goes idle: writes out everything buffered,
+    // as flushIfDue() will not be called again until input resumes
+    virtual void flushAll() = 0;
+
+    virtual void close() = 0;
+
+    virtual unsigned long long getBytesWritten() const = 0;
+};
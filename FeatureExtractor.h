@@ -0,0 +1,328 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "BehavioralEvent.h"
+#include "FileOutput.h"
+#include "MouseKinematics.h"
+#include "StreamingStats.h"
+
+struct FeatureOptions {
+    int windowMs = 0;             // Tumbling window length, 0 disables feature extraction
+    int kinematicsSampleMs = 10;  // Motion is resampled to at least this interval before differentiating
+    int strokeGapMs = 250;        // Longer pauses start a new stroke (no acceleration across them)
+    int maxFlightMs = 2000;       // Key flight times above this are pauses, not typing
+};
+
+// One row of the feature log: aggregates of one application over one window
+struct FeatureVector {
+    long long windowStart;
+    long long windowEnd;
+    uint16_t appId;
+    uint64_t events;
+
+    uint64_t mouseMoves;
+    double pathLengthPx;
+    double speedMean, speedStd, speedP50, speedP95;  // px/s
+    double accelMean, accelStd;                      // |d speed / dt|, px/s^2
+    double jerkMean, jerkStd;                        // |d accel / dt|, px/s^3
+    double curvatureMean;                            // Heading change per px, rad/px
+
+    uint64_t clicks;
+    double clickDurationMean, clickDurationStd;      // ms
+
+    uint64_t keystrokes;
+    double dwellMean, dwellStd, dwellP50, dwellP95;      // Key down to up, ms
+    double flightMean, flightStd, flightP50, flightP95;  // Previous key's up to this key's down, ms (negative = overlap)
+
+    uint64_t wheelEvents;
+};
+
+// Streaming feature stage fed from the event stream on the consumer thread.
+// Keeps incremental aggregates (Welford mean/variance, quantile sketches) per
+// application for the current tumbling window and emits one FeatureVector per
+// application when the window closes, so hundreds of raw events become one
+// row. Kinematics come from KinematicsStage, a single cursor trajectory
+// across applications; each sample is attributed to the app of the move
+// that completed it.
+class FeatureExtractor {
+private:
+    struct AppWindow {
+        uint64_t events;
+        uint64_t mouseMoves;
+        double pathLength;
+        RunningStats speed;
+        QuantileSketch speedQuantiles;
+        RunningStats accel;
+        RunningStats jerk;
+        RunningStats curvature;
+        uint64_t clicks;
+        RunningStats clickDuration;
+        uint64_t keystrokes;
+        RunningStats dwell;
+        QuantileSketch dwellQuantiles;
+        RunningStats flight;
+        QuantileSketch flightQuantiles;
+        uint64_t wheelEvents;
+
+        AppWindow() { reset(); }
+
+        void reset() {
+            events = 0;
+            mouseMoves = 0;
+            pathLength = 0.0;
+            speed.reset();
+            speedQuantiles.reset();
+            accel.reset();
+            jerk.reset();
+            curvature.reset();
+            clicks = 0;
+            clickDuration.reset();
+            keystrokes = 0;
+            dwell.reset();
+            dwellQuantiles.reset();
+            flight.reset();
+            flightQuantiles.reset();
+            wheelEvents = 0;
+        }
+    };
+
+    FeatureOptions options;
+    std::vector<std::unique_ptr<AppWindow>> apps;  // Indexed by app ID, allocated on first use
+    std::vector<uint16_t> activeApps;              // Apps with events in the current window
+    long long windowStart;
+    bool windowOpen;
+
+    long long buttonDownAt[2];  // Left, right
+
+    AppWindow& appWindow(uint16_t appId) {
+        if (appId >= apps.size()) apps.resize(appId + 1);
+        if (!apps[appId]) apps[appId].reset(new AppWindow());
+        AppWindow& window = *apps[appId];
+        if (window.events == 0) activeApps.push_back(appId);
+        return window;
+    }
+
+    void addMove(const KinematicSample* motion, AppWindow& window) {
+        window.mouseMoves++;
+        if (!motion) return;  // The move did not complete a sample
+
+        window.pathLength += motion->distance;
+        window.speed.add(motion->speed);
+        window.speedQuantiles.add(motion->speed);
+        if (motion->flags & KINEMATICS_HAS_ACCEL) window.accel.add(std::fabs(motion->accel));
+        if (motion->flags & KINEMATICS_HAS_JERK) window.jerk.add(std::fabs(motion->jerk));
+        if (motion->flags & KINEMATICS_HAS_CURVATURE) window.curvature.add(motion->curvature);
+    }
+
+    // KEY_UP records arrive already paired (dwell/flight set by the capture).
+    // Overlapped (negative) flights go to both the running stats and the
+    // sketch, which keeps negative values in buckets of their own.
+    void addKeyUp(const BehavioralEvent& event, AppWindow& window) {
+        window.keystrokes++;
+        if (event.dwellTime != KEY_TIMING_NONE) {
+            window.dwell.add(static_cast<double>(event.dwellTime));
+            window.dwellQuantiles.add(static_cast<double>(event.dwellTime));
+        }
+        if (event.flightTime != KEY_TIMING_NONE && event.flightTime <= options.maxFlightMs) {
+            window.flight.add(static_cast<double>(event.flightTime));
+            window.flightQuantiles.add(static_cast<double>(event.flightTime));
+        }
+    }
+
+    void addButton(const BehavioralEvent& event, AppWindow& window) {
+        const bool left = event.type == MOUSE_LEFT_DOWN || event.type == MOUSE_LEFT_UP;
+        long long& downAt = buttonDownAt[left ? 0 : 1];
+        if (event.type == MOUSE_LEFT_DOWN || event.type == MOUSE_RIGHT_DOWN) {
+            downAt = event.timestamp;
+            window.clicks++;
+        }
+        else if (downAt != 0) {
+            window.clickDuration.add(static_cast<double>(event.timestamp - downAt));
+            downAt = 0;
+        }
+    }
+
+    template <typename Emit>
+    void closeWindow(Emit& sink) {
+        const long long windowEnd = windowStart + options.windowMs;
+        for (uint16_t appId : activeApps) {
+            AppWindow& window = *apps[appId];
+            FeatureVector row;
+            row.windowStart = windowStart;
+            row.windowEnd = windowEnd;
+            row.appId = appId;
+            row.events = window.events;
+            row.mouseMoves = window.mouseMoves;
+            row.pathLengthPx = window.pathLength;
+            row.speedMean = window.speed.getMean();
+            row.speedStd = window.speed.getStdDev();
+            row.speedP50 = window.speedQuantiles.quantile(0.50);
+            row.speedP95 = window.speedQuantiles.quantile(0.95);
+            row.accelMean = window.accel.getMean();
+            row.accelStd = window.accel.getStdDev();
+            row.jerkMean = window.jerk.getMean();
+            row.jerkStd = window.jerk.getStdDev();
+            row.curvatureMean = window.curvature.getMean();
+            row.clicks = window.clicks;
+            row.clickDurationMean = window.clickDuration.getMean();
+            row.clickDurationStd = window.clickDuration.getStdDev();
+            row.keystrokes = window.keystrokes;
+            row.dwellMean = window.dwell.getMean();
+            row.dwellStd = window.dwell.getStdDev();
+            row.dwellP50 = window.dwellQuantiles.quantile(0.50);
+            row.dwellP95 = window.dwellQuantiles.quantile(0.95);
+            row.flightMean = window.flight.getMean();
+            row.flightStd = window.flight.getStdDev();
+            row.flightP50 = window.flightQuantiles.quantile(0.50);
+            row.flightP95 = window.flightQuantiles.quantile(0.95);
+            row.wheelEvents = window.wheelEvents;
+            sink(row);
+            window.reset();
+        }
+        activeApps.clear();
+        windowOpen = false;
+    }
+
+public:
+    FeatureExtractor() :
+        windowStart(0),
+        windowOpen(false) {
+        memset(buttonDownAt, 0, sizeof(buttonDownAt));
+    }
+
+    void configure(const FeatureOptions& featureOptions) {
+        options = featureOptions;
+        if (options.kinematicsSampleMs < 1) options.kinematicsSampleMs = 1;
+    }
+
+    const FeatureOptions& getOptions() const {
+        return options;
+    }
+
+    bool isEnabled() const {
+        return options.windowMs > 0;
+    }
+
+    // A window with records that flushIdle() has not closed yet
+    bool hasOpenWindow() const {
+        return windowOpen;
+    }
+
+    // Adds one record with the sample KinematicsStage derived from it (null
+    // when it completed none); emits sink(const FeatureVector&) for every
+    // app of a window the record closes
+    template <typename Emit>
+    void add(const BehavioralEvent& event, const KinematicSample* motion, Emit&& sink) {
+        if (windowOpen && event.timestamp >= windowStart + options.windowMs) {
+            closeWindow(sink);
+        }
+        if (!windowOpen) {
+            windowStart = event.timestamp - event.timestamp % options.windowMs;
+            windowOpen = true;
+        }
+
+        AppWindow& window = appWindow(event.appId);
+        window.events++;
+
+        switch (event.type) {
+        case MOUSE_MOVE:
+            addMove(motion, window);
+            break;
+        case MOUSE_LEFT_DOWN:
+        case MOUSE_LEFT_UP:
+        case MOUSE_RIGHT_DOWN:
+        case MOUSE_RIGHT_UP:
+            addButton(event, window);
+            break;
+        case MOUSE_WHEEL:
+            window.wheelEvents++;
+            break;
+        case KEY_UP:
+            addKeyUp(event, window);
+            break;
+        }
+    }
+
+    // Closes the current window once wall-clock time has passed its end, so
+    // rows are written even when input stops
+    template <typename Emit>
+    void flushIdle(long long nowMs, Emit&& sink) {
+        if (windowOpen && nowMs >= windowStart + options.windowMs) {
+            closeWindow(sink);
+        }
+    }
+
+    // Emits the partial window (on stop)
+    template <typename Emit>
+    void flush(Emit&& sink) {
+        if (windowOpen) closeWindow(sink);
+    }
+};
+
+// Column layout of the feature log
+const char* const FEATURE_CSV_HEADER =
+    "window_start,window_end,active_app,events,mouse_moves,path_length_px,"
+    "speed_mean,speed_std,speed_p50,speed_p95,accel_mean,accel_std,jerk_mean,jerk_std,curvature_mean,"
+    "clicks,click_duration_mean,click_duration_std,"
+    "keystrokes,dwell_mean,dwell_std,dwell_p50,dwell_p95,flight_mean,flight_std,flight_p50,flight_p95,"
+    "wheel_events";
+
+// Writes FeatureVector rows as CSV; one write per closed window
+class FeatureCsvWriter {
+private:
+    FileOutput file;
+    std::ostringstream rows;
+    bool pending;
+
+public:
+    FeatureCsvWriter() : pending(false) {}
+
+    bool open(const std::string& filename) {
+        if (!file.open(filename, WRITER_BACKEND_STREAM)) return false;
+        if (file.isEmpty()) {
+            file.write(std::string(FEATURE_CSV_HEADER) + "\r\n");
+            file.flushBatch();
+        }
+        rows << std::fixed << std::setprecision(2);
+        return true;
+    }
+
+    void write(const FeatureVector& row, const std::string& appName) {
+        rows << row.windowStart << ',' << row.windowEnd << ',' << appName << ',' << row.events << ','
+            << row.mouseMoves << ',' << row.pathLengthPx << ','
+            << row.speedMean << ',' << row.speedStd << ',' << row.speedP50 << ',' << row.speedP95 << ','
+            << row.accelMean << ',' << row.accelStd << ',' << row.jerkMean << ',' << row.jerkStd << ','
+            << std::setprecision(5) << row.curvatureMean << std::setprecision(2) << ','
+            << row.clicks << ',' << row.clickDurationMean << ',' << row.clickDurationStd << ','
+            << row.keystrokes << ',' << row.dwellMean << ',' << row.dwellStd << ','
+            << row.dwellP50 << ',' << row.dwellP95 << ','
+            << row.flightMean << ',' << row.flightStd << ',' << row.flightP50 << ',' << row.flightP95 << ','
+            << row.wheelEvents << "\r\n";
+        pending = true;
+    }
+
+    void flush() {
+        if (!pending || !file.isOpen()) return;
+        file.write(rows.str());
+        file.flushBatch();
+        rows.str(std::string());
+        pending = false;
+    }
+
+    void close() {
+        flush();
+        file.close();
+    }
+
+    bool isOpen() const {
+        return file.isOpen();
+    }
+};
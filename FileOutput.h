@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <string>
+
+#include "OverlappedFileWriter.h"
+
+// How log bytes reach the disk
+enum WriterBackend {
+    WRITER_BACKEND_STREAM,     // std::ofstream, flushed at the end of every batch
+    WRITER_BACKEND_OVERLAPPED  // Double-buffered overlapped WriteFile, see OverlappedFileWriter
+};
+
+// Append-only binary file used by the CSV and binary log writers.
+// Wraps whichever backend was selected so the writers stay backend-agnostic.
+class FileOutput {
+private:
+    WriterBackend backend;
+    std::ofstream stream;
+    OverlappedFileWriter overlapped;
+    std::atomic<unsigned long long> bytesWritten;  // Written by the owning writer, readable from any thread
+    unsigned long long streamOffset;  // Stream backend: file size including this session's writes
+
+public:
+    FileOutput() : backend(WRITER_BACKEND_STREAM), bytesWritten(0), streamOffset(0) {}
+
+    bool open(const std::string& filename, WriterBackend writerBackend,
+        const OverlappedWriterOptions& overlappedOptions = OverlappedWriterOptions()) {
+        backend = writerBackend;
+        if (backend == WRITER_BACKEND_OVERLAPPED) {
+            return overlapped.open(filename, overlappedOptions);
+        }
+
+        stream.open(filename, std::ios::app | std::ios::binary);
+        if (!stream.is_open()) return false;
+        stream.seekp(0, std::ios::end);
+        streamOffset = static_cast<unsigned long long>(stream.tellp());
+        return true;
+    }
+
+    bool isOpen() const {
+        return backend == WRITER_BACKEND_OVERLAPPED ? overlapped.isOpen() : stream.is_open();
+    }
+
+    // True when the file has no content yet (the caller writes its header)
+    bool isEmpty() {
+        return getOffset() == 0;
+    }
+
+    // Offset the next write() lands at
+    unsigned long long getOffset() const {
+        return backend == WRITER_BACKEND_OVERLAPPED ? overlapped.size() : streamOffset;
+    }
+
+    void write(const char* data, size_t size) {
+        if (backend == WRITER_BACKEND_OVERLAPPED) {
+            overlapped.write(data, size);
+        }
+        else {
+            stream.write(data, size);
+            streamOffset += size;
+        }
+        bytesWritten.store(bytesWritten.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+    }
+
+    void write(const std::string& data) {
+        write(data.data(), data.size());
+    }
+
+    // End of a logical batch. The stream backend flushes; the overlapped
+    // backend leaves it to its durability policy.
+    void flushBatch() {
+        if (backend == WRITER_BACKEND_OVERLAPPED) {
+            overlapped.flushIfDue();
+        }
+        else if (stream.is_open()) {
+            stream.flush();
+        }
+    }
+
+    // Periodic check from an idle thread, used by the FLUSH_EVERY_MS policy
+    void flushIfDue() {
+        if (backend == WRITER_BACKEND_OVERLAPPED) overlapped.flushIfDue();
+    }
+
+    // Everything written so far goes to the OS, whatever the policy
+    void flush() {
+        if (backend == WRITER_BACKEND_OVERLAPPED) {
+            overlapped.flush();
+        }
+        else if (stream.is_open()) {
+            stream.flush();
+        }
+    }
+
+    void close() {
+        if (backend == WRITER_BACKEND_OVERLAPPED) {
+            overlapped.close();
+        }
+        else if (stream.is_open()) {
+            stream.close();
+        }
+    }
+
+    unsigned long long getBytesWritten() const {
+        return bytesWritten.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <windows.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <atomic>
+
+// Low-level mouse and keyboard hooks on a thread of their own.
+//
+// Windows runs a low-level hook callback on the thread that installed the
+// hook, from inside that thread's message retrieval. The hook thread blocks
+// in GetMessage, so it wakes only for callbacks and its WM_QUIT, and a
+// callback runs as soon as the input arrives instead of whenever a polling
+// loop next looks at its queue. Raised priority, and optionally an MMCSS
+// task, keep the callbacks prompt while the rest of the system is busy.
+
+struct HookThreadOptions {
+    bool enabled = true;  // False installs the hooks on the thread calling start(), which must pump messages
+    int priority = THREAD_PRIORITY_HIGHEST;
+    std::string mmcssTask;  // MMCSS task class such as "Games" or "Pro Audio", empty for none
+};
+
+class HookThread {
+private:
+    typedef HANDLE(WINAPI* AvSetMmThreadCharacteristicsFn)(LPCSTR, LPDWORD);
+    typedef BOOL(WINAPI* AvRevertMmThreadCharacteristicsFn)(HANDLE);
+
+    HookThreadOptions options;
+    HOOKPROC mouseProc;
+    HOOKPROC keyboardProc;
+    HHOOK mouseHook;
+    HHOOK keyboardHook;
+    std::thread thread;
+    DWORD threadId;
+    std::atomic<int> startState;  // 0 starting, 1 running, -1 failed
+    bool inMmcssTask;             // Written by the hook thread before startState
+
+    bool install() {
+        mouseHook = SetWindowsHookEx(WH_MOUSE_LL, mouseProc, NULL, 0);
+        if (mouseHook == NULL) {
+            std::cerr << "Failed to install mouse hook!" << std::endl;
+            return false;
+        }
+
+        keyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, keyboardProc, NULL, 0);
+        if (keyboardHook == NULL) {
+            std::cerr << "Failed to install keyboard hook!" << std::endl;
+            UnhookWindowsHookEx(mouseHook);
+            mouseHook = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    void uninstall() {
+        if (mouseHook) {
+            UnhookWindowsHookEx(mouseHook);
+            mouseHook = NULL;
+        }
+        if (keyboardHook) {
+            UnhookWindowsHookEx(keyboardHook);
+            keyboardHook = NULL;
+        }
+    }
+
+    void threadProc() {
+        threadId = GetCurrentThreadId();
+        MSG msg;
+        PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);  // Creates the queue stop() posts to
+
+        if (!SetThreadPriority(GetCurrentThread(), options.priority)) {
+            std::cerr << "Failed to raise hook thread priority" << std::endl;
+        }
+
+        // avrt.dll is loaded on demand so the executable does not depend on it
+        HMODULE avrt = NULL;
+        HANDLE mmcss = NULL;
+        if (!options.mmcssTask.empty()) {
+            avrt = LoadLibraryA("avrt.dll");
+            AvSetMmThreadCharacteristicsFn join = avrt
+                ? reinterpret_cast<AvSetMmThreadCharacteristicsFn>(GetProcAddress(avrt, "AvSetMmThreadCharacteristicsA"))
+                : NULL;
+            DWORD taskIndex = 0;
+            mmcss = join ? join(options.mmcssTask.c_str(), &taskIndex) : NULL;
+            if (mmcss == NULL) {
+                std::cerr << "Failed to join MMCSS task: " << options.mmcssTask << std::endl;
+            }
+        }
+        inMmcssTask = mmcss != NULL;
+
+        if (install()) {
+            startState = 1;
+            while (GetMessage(&msg, NULL, 0, 0) > 0) {
+                DispatchMessage(&msg);
+            }
+            uninstall();
+        }
+        else {
+            startState = -1;
+        }
+
+        if (mmcss) {
+            AvRevertMmThreadCharacteristicsFn revert =
+                reinterpret_cast<AvRevertMmThreadCharacteristicsFn>(GetProcAddress(avrt, "AvRevertMmThreadCharacteristics"));
+            if (revert) revert(mmcss);
+        }
+        if (avrt) FreeLibrary(avrt);
+    }
+
+public:
+    HookThread() :
+        mouseProc(NULL),
+        keyboardProc(NULL),
+        mouseHook(NULL),
+        keyboardHook(NULL),
+        threadId(0),
+        startState(0),
+        inMmcssTask(false) {}
+
+    ~HookThread() {
+        stop();
+    }
+
+    HookThread(const HookThread&) = delete;
+    HookThread& operator=(const HookThread&) = delete;
+
+    // Returns once both hooks are installed or installing one failed
+    bool start(HOOKPROC mouse, HOOKPROC keyboard, const HookThreadOptions& hookOptions) {
+        options = hookOptions;
+        mouseProc = mouse;
+        keyboardProc = keyboard;
+        inMmcssTask = false;
+        if (!options.enabled) {
+            return install();
+        }
+
+        startState = 0;
+        thread = std::thread(&HookThread::threadProc, this);
+        while (startState == 0) {
+            Sleep(1);
+        }
+        if (startState < 0) {
+            thread.join();
+            return false;
+        }
+        return true;
+    }
+
+    void stop() {
+        if (thread.joinable()) {
+            PostThreadMessageA(threadId, WM_QUIT, 0, 0);
+            thread.join();
+        }
+        else {
+            uninstall();
+        }
+    }
+
+    // For CallNextHookEx in the callbacks
+    HHOOK getMouseHook() const { return mouseHook; }
+    HHOOK getKeyboardHook() const { return keyboardHook; }
+
+    bool isDedicated() const {
+        return options.enabled;
+    }
+
+    // Only meaningful after a successful start()
+    bool isInMmcssTask() const {
+        return inMmcssTask;
+    }
+};
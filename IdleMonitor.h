@@ -0,0 +1,302 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct IdleOptions {
+    int idleAfterMs = 60000;       // No input for this long makes the capture idle, 0 = never by time
+    bool sessionEvents = true;     // Also idle while the session is locked or disconnected
+};
+
+// Idle state of the capture: no input for idleAfterMs, or a locked or
+// disconnected session (WTSRegisterSessionNotification). While idle the
+// threads that otherwise wake on a timer (context polling, the drainer,
+// the sink lanes' flush checks) block in waitWhileIdle() instead, so an
+// unattended machine runs none of the capture's periodic work.
+//
+// The hook path calls onInput() for every record, after handing it over:
+// a fence and a load while active, and on the first input after an idle
+// period one notify that releases every waiter at once. The context thread
+// calls poll() on its schedule and is the one that enters the idle state.
+// A record handed over just as the capture goes idle is seen either by
+// onInput() (which resumes) or by the consumer's inputPending check in
+// waitWhileIdle(), never by neither.
+// wtsapi32.dll is loaded on demand; without it, or without the watcher
+// window, only the input timeout applies.
+class IdleMonitor {
+private:
+    typedef BOOL(WINAPI* WTSRegisterSessionNotificationFn)(HWND, DWORD);
+    typedef BOOL(WINAPI* WTSUnRegisterSessionNotificationFn)(HWND);
+
+    static const UINT WM_WTSSESSION_CHANGE_VALUE = 0x02B1;
+    static const WPARAM WTS_CONSOLE_CONNECT_VALUE = 0x1;
+    static const WPARAM WTS_CONSOLE_DISCONNECT_VALUE = 0x2;
+    static const WPARAM WTS_REMOTE_CONNECT_VALUE = 0x3;
+    static const WPARAM WTS_REMOTE_DISCONNECT_VALUE = 0x4;
+    static const WPARAM WTS_SESSION_LOCK_VALUE = 0x7;
+    static const WPARAM WTS_SESSION_UNLOCK_VALUE = 0x8;
+    static const DWORD NOTIFY_FOR_THIS_SESSION_VALUE = 0;
+
+    IdleOptions options;
+    std::atomic<long long> lastInputMs;
+    std::atomic<bool> idle;
+    std::atomic<bool> sessionAway;  // Locked or disconnected
+    std::mutex mutex;
+    std::condition_variable wake;
+    long long idleSinceMs;  // Under mutex
+
+    HMODULE wtsapi;
+    WTSRegisterSessionNotificationFn registerNotification;
+    WTSUnRegisterSessionNotificationFn unregisterNotification;
+    HWND window;
+    std::thread thread;
+    std::atomic<DWORD> threadId;
+    std::atomic<int> startState;  // 0 starting, 1 running, -1 failed
+
+    std::atomic<unsigned long long> idlePeriods;
+    std::atomic<unsigned long long> sessionChanges;
+    std::atomic<long long> idleTotalMs;
+
+    static void increment(std::atomic<unsigned long long>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    static long long nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static const char* windowClassName() {
+        return "BehavioralCaptureSessionWatcher";
+    }
+
+    void enterIdle(long long now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idle.load(std::memory_order_relaxed)) return;
+        idleSinceMs = now;
+        idle.store(true, std::memory_order_seq_cst);
+        increment(idlePeriods);
+    }
+
+    void resume(long long now) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            lastInputMs.store(now, std::memory_order_relaxed);  // Counts as activity, or poll() would re-enter at once
+            if (!idle.load(std::memory_order_relaxed)) return;
+            idle.store(false, std::memory_order_release);
+            idleTotalMs.store(idleTotalMs.load(std::memory_order_relaxed) + (now - idleSinceMs), std::memory_order_relaxed);
+        }
+        wake.notify_all();
+    }
+
+    void onSessionChange(WPARAM change) {
+        increment(sessionChanges);
+        if (change == WTS_SESSION_LOCK_VALUE || change == WTS_CONSOLE_DISCONNECT_VALUE ||
+            change == WTS_REMOTE_DISCONNECT_VALUE) {
+            sessionAway = true;
+            enterIdle(nowMs());
+        }
+        else if (change == WTS_SESSION_UNLOCK_VALUE || change == WTS_CONSOLE_CONNECT_VALUE ||
+            change == WTS_REMOTE_CONNECT_VALUE) {
+            sessionAway = false;
+            resume(nowMs());  // Refresh context before the first keystroke after unlocking
+        }
+    }
+
+    static LRESULT CALLBACK WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+        if (message == WM_NCCREATE) {
+            CREATESTRUCTA* create = reinterpret_cast<CREATESTRUCTA*>(lParam);
+            SetWindowLongPtrA(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(create->lpCreateParams));
+        }
+        else if (message == WM_WTSSESSION_CHANGE_VALUE) {
+            IdleMonitor* monitor = reinterpret_cast<IdleMonitor*>(GetWindowLongPtrA(hwnd, GWLP_USERDATA));
+            if (monitor) monitor->onSessionChange(wParam);
+        }
+        return DefWindowProcA(hwnd, message, wParam, lParam);
+    }
+
+    void threadProc() {
+        threadId = GetCurrentThreadId();
+        HINSTANCE module = GetModuleHandleA(NULL);
+        WNDCLASSEXA windowClass;
+        ZeroMemory(&windowClass, sizeof(windowClass));
+        windowClass.cbSize = sizeof(windowClass);
+        windowClass.lpfnWndProc = WindowProc;
+        windowClass.hInstance = module;
+        windowClass.lpszClassName = windowClassName();
+        RegisterClassExA(&windowClass);  // Fails harmlessly if already registered
+
+        // Session notifications are sent, not broadcast, so a message-only window will do
+        window = CreateWindowExA(0, windowClassName(), "", 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, module, this);
+        if (window == NULL || !registerNotification(window, NOTIFY_FOR_THIS_SESSION_VALUE)) {
+            if (window != NULL) DestroyWindow(window);
+            window = NULL;
+            startState = -1;
+            return;
+        }
+        startState = 1;
+
+        MSG msg;
+        while (GetMessage(&msg, NULL, 0, 0) > 0) {
+            DispatchMessage(&msg);
+        }
+        unregisterNotification(window);
+        DestroyWindow(window);
+        window = NULL;
+    }
+
+    void startSessionWatcher() {
+        wtsapi = LoadLibraryA("wtsapi32.dll");
+        if (!wtsapi) return;
+        registerNotification = reinterpret_cast<WTSRegisterSessionNotificationFn>(
+            GetProcAddress(wtsapi, "WTSRegisterSessionNotification"));
+        unregisterNotification = reinterpret_cast<WTSUnRegisterSessionNotificationFn>(
+            GetProcAddress(wtsapi, "WTSUnRegisterSessionNotification"));
+        if (!registerNotification || !unregisterNotification) return;
+
+        startState = 0;
+        thread = std::thread(&IdleMonitor::threadProc, this);
+        while (startState == 0) {
+            Sleep(1);
+        }
+        if (startState < 0) {
+            thread.join();
+            std::cerr << "Failed to register for session notifications, lock and unlock will not be seen" << std::endl;
+        }
+    }
+
+public:
+    IdleMonitor() :
+        lastInputMs(0),
+        idle(false),
+        sessionAway(false),
+        idleSinceMs(0),
+        wtsapi(NULL),
+        registerNotification(NULL),
+        unregisterNotification(NULL),
+        window(NULL),
+        threadId(0),
+        startState(0),
+        idlePeriods(0),
+        sessionChanges(0),
+        idleTotalMs(0) {}
+
+    ~IdleMonitor() {
+        stop();
+    }
+
+    IdleMonitor(const IdleMonitor&) = delete;
+    IdleMonitor& operator=(const IdleMonitor&) = delete;
+
+    // Starts active, as if input had just arrived
+    void start(const IdleOptions& idleOptions) {
+        stop();
+        options = idleOptions;
+        lastInputMs = nowMs();
+        idle = false;
+        sessionAway = false;
+        idlePeriods = 0;
+        sessionChanges = 0;
+        idleTotalMs = 0;
+        if (options.sessionEvents) startSessionWatcher();
+    }
+
+    // Leaves the idle state, so nothing stays blocked in waitWhileIdle()
+    void stop() {
+        if (thread.joinable()) {
+            PostThreadMessageA(threadId, WM_QUIT, 0, 0);
+            thread.join();
+        }
+        if (wtsapi) {
+            FreeLibrary(wtsapi);
+            wtsapi = NULL;
+            registerNotification = NULL;
+            unregisterNotification = NULL;
+        }
+        resume(nowMs());
+    }
+
+    bool isEnabled() const {
+        return options.idleAfterMs > 0 || options.sessionEvents;
+    }
+
+    // Hook path, once per record, after the record is queued
+    void onInput(long long timestampMs) {
+        lastInputMs.store(timestampMs, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);  // Queued before idle is read
+        if (idle.load(std::memory_order_seq_cst)) resume(timestampMs);
+    }
+
+    // Context thread: enters the idle state once input has stopped for
+    // idleAfterMs; returns whether the capture is idle
+    bool poll(long long now) {
+        if (isIdle()) return true;
+        if (sessionAway || (options.idleAfterMs > 0 && now - lastInputMs.load(std::memory_order_relaxed) >= options.idleAfterMs)) {
+            enterIdle(now);
+        }
+        return isIdle();
+    }
+
+    bool isIdle() const {
+        return idle.load(std::memory_order_acquire);
+    }
+
+    // Blocks while idle, until input resumes or running goes false (the
+    // owner then calls wakeAll()); returns at once while active
+    void waitWhileIdle(const std::atomic<bool>& running) {
+        waitWhileIdle(running, [] { return false; });
+    }
+
+    // Consumer side: inputPending() tells whether a record is queued. It is
+    // checked once idle is seen, so a record whose producer found the
+    // capture still active ends the idle period here instead of waiting
+    // for the next input.
+    template <typename InputPending>
+    void waitWhileIdle(const std::atomic<bool>& running, InputPending inputPending) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (idle.load(std::memory_order_seq_cst) && inputPending()) {
+            resume(lastInputMs.load(std::memory_order_relaxed));
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return !idle.load(std::memory_order_relaxed) || !running.load(); });
+    }
+
+    // Releases waiters after their running flag was cleared
+    void wakeAll() {
+        { std::lock_guard<std::mutex> lock(mutex); }
+        wake.notify_all();
+    }
+
+    bool isWatchingSession() const {
+        return thread.joinable();
+    }
+
+    // "after 60000 ms without input, or while the session is locked"
+    std::string describe() const {
+        if (!isEnabled()) return "off";
+        std::string text;
+        if (options.idleAfterMs > 0) text = "after " + std::to_string(options.idleAfterMs) + " ms without input";
+        if (options.sessionEvents) text += std::string(text.empty() ? "" : ", or ") + "while the session is locked";
+        return text;
+    }
+
+    unsigned long long getIdlePeriods() const {
+        return idlePeriods.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long getSessionChanges() const {
+        return sessionChanges.load(std::memory_order_relaxed);
+    }
+
+    // Completed idle periods only
+    long long getIdleTotalMs() const {
+        return idleTotalMs.load(std::memory_order_relaxed);
+    }
+};
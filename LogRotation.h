@@ -0,0 +1,534 @@
+#pragma once
+
+#include <windows.h>
+#include <compressapi.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BehavioralEvent.h"
+#include "CaptureIndex.h"
+
+#pragma comment(lib, "Cabinet.lib")
+
+// Rotation of the CSV and binary logs into numbered segments.
+//
+// The active file keeps the name passed to start(). When it is due, it is
+// closed, renamed to <stem>.<index>.<ext> and reopened empty (so it gets a
+// fresh CSV header or .bclog header and dictionary). Closed segments are
+// listed in <stem>.manifest.csv with the range of event timestamps they
+// hold, and compressed to <segment>.bcz on a background-priority thread.
+//
+// Compression uses the Windows Compression API (XPRESS with Huffman, no
+// extra dependency). A .bcz file is "BCZ1", uint32 algorithm, then chunks
+// of uint32 original size, uint32 compressed size, compressed bytes; each
+// chunk covers up to COMPRESSION_CHUNK_BYTES of input so memory stays
+// bounded for large segments.
+
+struct RotationOptions {
+    unsigned long long maxBytes = 0;  // Rotate once the active file has grown by this much, 0 = off
+    int intervalMinutes = 0;          // Rotate at multiples of this interval (UTC), 0 = off
+    bool compress = true;             // Compress closed segments in the background
+
+    bool isEnabled() const {
+        return maxBytes > 0 || intervalMinutes > 0;
+    }
+};
+
+const char COMPRESSED_SEGMENT_MAGIC[4] = { 'B', 'C', 'Z', '1' };
+const size_t COMPRESSION_CHUNK_BYTES = 4 * 1024 * 1024;
+const size_t COMPRESSION_MAX_PACKED_BYTES = 2 * COMPRESSION_CHUNK_BYTES;  // Sanity bound when reading
+const char* const COMPRESSED_SEGMENT_EXTENSION = ".bcz";
+const char* const MANIFEST_HEADER = "segment,file,first_timestamp,last_timestamp,events,bytes,stored_bytes,compressed";
+
+// Filename without its extension, and the extension including the dot
+inline void splitExtension(const std::string& filename, std::string& stem, std::string& extension) {
+    const size_t slash = filename.find_last_of("\\/");
+    const size_t dot = filename.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        stem = filename;
+        extension.clear();
+    }
+    else {
+        stem = filename.substr(0, dot);
+        extension = filename.substr(dot);
+    }
+}
+
+inline std::string fileNamePart(const std::string& path) {
+    const size_t slash = path.find_last_of("\\/");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+inline std::string directoryPart(const std::string& path) {
+    const size_t slash = path.find_last_of("\\/");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+inline bool fileExists(const std::string& path) {
+    return GetFileAttributesA(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+// Compresses input into a .bcz file; storedBytes receives the output size
+inline bool compressFile(const std::string& input, const std::string& output, unsigned long long& storedBytes) {
+    std::ifstream in(input, std::ios::binary);
+    std::ofstream out(output, std::ios::binary | std::ios::trunc);
+    if (!in.is_open() || !out.is_open()) return false;
+
+    COMPRESSOR_HANDLE compressor;
+    if (!CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, NULL, &compressor)) return false;
+
+    const uint32_t algorithm = COMPRESS_ALGORITHM_XPRESS_HUFF;
+    out.write(COMPRESSED_SEGMENT_MAGIC, sizeof(COMPRESSED_SEGMENT_MAGIC));
+    out.write(reinterpret_cast<const char*>(&algorithm), sizeof(algorithm));
+
+    std::vector<char> chunk(COMPRESSION_CHUNK_BYTES);
+    std::vector<char> packed;
+    bool ok = true;
+    while (ok) {
+        in.read(chunk.data(), chunk.size());
+        const SIZE_T length = static_cast<SIZE_T>(in.gcount());
+        if (length == 0) break;
+
+        SIZE_T needed = 0;
+        if (!Compress(compressor, chunk.data(), length, NULL, 0, &needed) &&
+            GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+            ok = false;
+            break;
+        }
+        packed.resize(needed);
+        SIZE_T packedLength = 0;
+        if (!Compress(compressor, chunk.data(), length, packed.data(), packed.size(), &packedLength)) {
+            ok = false;
+            break;
+        }
+
+        const uint32_t sizes[2] = { static_cast<uint32_t>(length), static_cast<uint32_t>(packedLength) };
+        out.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+        out.write(packed.data(), packedLength);
+        ok = out.good();
+    }
+    CloseCompressor(compressor);
+
+    storedBytes = static_cast<unsigned long long>(out.tellp());
+    out.close();
+    return ok && !in.bad();
+}
+
+// Expands a .bcz file written by compressFile()
+inline bool decompressFile(const std::string& input, const std::string& output) {
+    std::ifstream in(input, std::ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[sizeof(COMPRESSED_SEGMENT_MAGIC)];
+    uint32_t algorithm = 0;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, COMPRESSED_SEGMENT_MAGIC, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(&algorithm), sizeof(algorithm))) {
+        return false;
+    }
+
+    DECOMPRESSOR_HANDLE decompressor;
+    if (!CreateDecompressor(algorithm, NULL, &decompressor)) return false;
+
+    std::ofstream out(output, std::ios::binary | std::ios::trunc);
+    std::vector<char> packed, chunk;
+    uint32_t sizes[2];
+    bool ok = out.is_open();
+    while (ok && in.read(reinterpret_cast<char*>(sizes), sizeof(sizes))) {
+        // Sizes come from the file: a corrupt header fails instead of allocating
+        if (sizes[0] > COMPRESSION_CHUNK_BYTES || sizes[1] > COMPRESSION_MAX_PACKED_BYTES) {
+            ok = false;
+            break;
+        }
+        packed.resize(sizes[1]);
+        chunk.resize(sizes[0]);
+        SIZE_T length = 0;
+        if (!in.read(packed.data(), packed.size()) ||
+            !Decompress(decompressor, packed.data(), packed.size(), chunk.data(), chunk.size(), &length) ||
+            length != sizes[0]) {
+            ok = false;
+            break;
+        }
+        out.write(chunk.data(), length);
+        ok = out.good();
+    }
+    CloseDecompressor(decompressor);
+    return ok && in.eof() && in.gcount() == 0;
+}
+
+struct SegmentInfo {
+    unsigned long long index = 0;
+    std::string file;                // Stored file name, relative to the manifest's directory
+    long long firstTimestamp = 0;    // ms since epoch, 0 when the segment holds no events
+    long long lastTimestamp = 0;
+    unsigned long long events = 0;   // Written by this process (appended content excluded)
+    unsigned long long bytes = 0;    // Uncompressed size
+    unsigned long long storedBytes = 0;
+    bool compressed = false;
+};
+
+// Segment list kept next to the log; shared by the rotating consumer thread
+// and the compression thread
+class SegmentManifest {
+private:
+    std::string path;
+    std::vector<SegmentInfo> segments;
+    mutable std::mutex mutex;
+
+    bool saveLocked() const {
+        const std::string temporary = path + ".tmp";
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+
+        out << MANIFEST_HEADER << "\n";
+        for (const SegmentInfo& segment : segments) {
+            out << segment.index << "," << segment.file << "," << segment.firstTimestamp << ","
+                << segment.lastTimestamp << "," << segment.events << "," << segment.bytes << ","
+                << segment.storedBytes << "," << (segment.compressed ? 1 : 0) << "\n";
+        }
+        out.close();
+        if (out.fail()) return false;
+
+        // Readers see the old or the new manifest, never a partial one
+        return MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+    }
+
+public:
+    // Reads an existing manifest; a missing one is an empty list
+    bool load(const std::string& manifestPath) {
+        std::lock_guard<std::mutex> lock(mutex);
+        path = manifestPath;
+        segments.clear();
+
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) return !fileExists(path);
+
+        std::string line;
+        std::getline(in, line);  // Header
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+
+            std::istringstream fields(line);
+            std::string field;
+            std::vector<std::string> values;
+            while (std::getline(fields, field, ',')) values.push_back(field);
+            if (values.size() < 8) continue;
+
+            SegmentInfo segment;
+            segment.index = std::stoull(values[0]);
+            segment.file = values[1];
+            segment.firstTimestamp = std::stoll(values[2]);
+            segment.lastTimestamp = std::stoll(values[3]);
+            segment.events = std::stoull(values[4]);
+            segment.bytes = std::stoull(values[5]);
+            segment.storedBytes = std::stoull(values[6]);
+            segment.compressed = values[7] == "1";
+            segments.push_back(segment);
+        }
+        return true;
+    }
+
+    bool add(const SegmentInfo& segment) {
+        std::lock_guard<std::mutex> lock(mutex);
+        segments.push_back(segment);
+        return saveLocked();
+    }
+
+    bool markCompressed(unsigned long long index, const std::string& file, unsigned long long storedBytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (SegmentInfo& segment : segments) {
+            if (segment.index == index) {
+                segment.file = file;
+                segment.storedBytes = storedBytes;
+                segment.compressed = true;
+            }
+        }
+        return saveLocked();
+    }
+
+    // Segments whose event range intersects [fromMs, toMs]
+    std::vector<SegmentInfo> overlapping(long long fromMs, long long toMs) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<SegmentInfo> result;
+        for (const SegmentInfo& segment : segments) {
+            if (segment.events > 0 && segment.lastTimestamp >= fromMs && segment.firstTimestamp <= toMs) {
+                result.push_back(segment);
+            }
+        }
+        return result;
+    }
+
+    std::vector<SegmentInfo> getSegments() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return segments;
+    }
+
+    unsigned long long nextIndex() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        unsigned long long next = 0;
+        for (const SegmentInfo& segment : segments) {
+            if (segment.index >= next) next = segment.index + 1;
+        }
+        return next;
+    }
+
+    const std::string& getPath() const {
+        return path;
+    }
+};
+
+// Compresses closed segments one at a time on a background-priority thread
+// (lowered CPU and I/O priority), so it never competes with capture
+class SegmentCompressor {
+private:
+    struct Job {
+        unsigned long long index;
+        std::string path;
+    };
+
+    SegmentManifest* manifest;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Job> queue;
+    bool running;
+    std::atomic<unsigned long long> compressedCount;
+    std::atomic<unsigned long long> failedCount;
+
+    void compress(const Job& job) {
+        const std::string output = job.path + COMPRESSED_SEGMENT_EXTENSION;
+        unsigned long long storedBytes = 0;
+        if (!compressFile(job.path, output, storedBytes)) {
+            DeleteFileA(output.c_str());
+            failedCount.store(failedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+
+        // The manifest names the .bcz before the original disappears
+        manifest->markCompressed(job.index, fileNamePart(output), storedBytes);
+        DeleteFileA(job.path.c_str());
+        compressedCount.store(compressedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void threadProc() {
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this] { return !running || !queue.empty(); });
+            if (!running) break;  // Remaining segments are picked up by the next session
+
+            const Job job = queue.front();
+            queue.pop_front();
+            lock.unlock();
+            compress(job);
+            lock.lock();
+        }
+    }
+
+public:
+    SegmentCompressor() :
+        manifest(nullptr),
+        running(false),
+        compressedCount(0),
+        failedCount(0) {}
+
+    ~SegmentCompressor() {
+        stop();
+    }
+
+    SegmentCompressor(const SegmentCompressor&) = delete;
+    SegmentCompressor& operator=(const SegmentCompressor&) = delete;
+
+    void start(SegmentManifest* segmentManifest) {
+        manifest = segmentManifest;
+        running = true;
+        thread = std::thread(&SegmentCompressor::threadProc, this);
+    }
+
+    void enqueue(unsigned long long index, const std::string& path) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(Job{ index, path });
+        }
+        wake.notify_one();
+    }
+
+    // Finishes the segment in progress; queued ones stay uncompressed
+    void stop() {
+        if (!thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_one();
+        thread.join();
+        queue.clear();
+    }
+
+    unsigned long long getCompressedCount() const {
+        return compressedCount.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long getFailedCount() const {
+        return failedCount.load(std::memory_order_relaxed);
+    }
+};
+
+// Decides when the active log is due and turns it into a segment.
+// track(), isDue() and rotate() run on the thread that writes the log (its
+// pipeline lane, never the hook thread); the owner closes and reopens its
+// writer around rotate().
+class LogRotator {
+private:
+    RotationOptions options;
+    std::string activeFile;
+    std::string stem;
+    std::string extension;
+    SegmentManifest manifest;
+    SegmentCompressor compressor;
+    SegmentInfo current;
+    unsigned long long bytesAtSegmentStart;
+    long long nextBoundaryMs;
+    unsigned long long rotatedCount;
+
+    long long intervalMs() const {
+        return static_cast<long long>(options.intervalMinutes) * 60 * 1000;
+    }
+
+    long long boundaryAfter(long long timestampMs) const {
+        return (timestampMs / intervalMs() + 1) * intervalMs();
+    }
+
+    std::string segmentPath(unsigned long long index) const {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), ".%06llu", index);
+        return stem + suffix + extension;
+    }
+
+public:
+    LogRotator() :
+        bytesAtSegmentStart(0),
+        nextBoundaryMs(0),
+        rotatedCount(0) {}
+
+    LogRotator(const LogRotator&) = delete;
+    LogRotator& operator=(const LogRotator&) = delete;
+
+    // bytesWritten: the writer's byte counter at this point
+    bool open(const std::string& filename, const RotationOptions& rotationOptions, unsigned long long bytesWritten) {
+        options = rotationOptions;
+        if (!options.isEnabled()) return true;
+
+        activeFile = filename;
+        splitExtension(filename, stem, extension);
+        if (!manifest.load(stem + ".manifest.csv")) return false;
+
+        current = SegmentInfo();
+        bytesAtSegmentStart = bytesWritten;
+        nextBoundaryMs = 0;
+        rotatedCount = 0;
+
+        if (options.compress) {
+            compressor.start(&manifest);
+            // Segments a previous session closed but did not get to compress
+            const std::string directory = directoryPart(manifest.getPath());
+            for (const SegmentInfo& segment : manifest.getSegments()) {
+                if (!segment.compressed && fileExists(directory + segment.file)) {
+                    compressor.enqueue(segment.index, directory + segment.file);
+                }
+            }
+        }
+        return true;
+    }
+
+    bool isEnabled() const {
+        return options.isEnabled();
+    }
+
+    // True when the active file should be rotated before event is written
+    bool isDue(const BehavioralEvent& event, unsigned long long bytesWritten) const {
+        if (!options.isEnabled()) return false;
+        if (options.maxBytes > 0 && bytesWritten - bytesAtSegmentStart >= options.maxBytes) return true;
+        return options.intervalMinutes > 0 && nextBoundaryMs > 0 && event.timestamp >= nextBoundaryMs;
+    }
+
+    // Accounts an event written to the active file
+    void track(const BehavioralEvent& event) {
+        if (current.events == 0) current.firstTimestamp = event.timestamp;
+        current.lastTimestamp = event.timestamp;
+        current.events++;
+        if (options.intervalMinutes > 0 && nextBoundaryMs == 0) nextBoundaryMs = boundaryAfter(event.timestamp);
+    }
+
+    // The active file must be closed. Renames it to the next segment, records
+    // it in the manifest and queues it for compression.
+    bool rotate(unsigned long long bytesWritten) {
+        unsigned long long index = manifest.nextIndex();
+        while (fileExists(segmentPath(index)) || fileExists(segmentPath(index) + COMPRESSED_SEGMENT_EXTENSION)) {
+            index++;
+        }
+
+        const std::string path = segmentPath(index);
+        if (!MoveFileExA(activeFile.c_str(), path.c_str(), MOVEFILE_WRITE_THROUGH)) {
+            // Keep appending to the active file and try again one period later
+            std::cerr << "Failed to rotate " << activeFile << " to " << path << std::endl;
+            bytesAtSegmentStart = bytesWritten;
+            nextBoundaryMs = 0;
+            return false;
+        }
+
+        // The sparse time index travels with its log
+        const std::string activeIndex = activeFile + CAPTURE_INDEX_EXTENSION;
+        if (fileExists(activeIndex)) {
+            MoveFileExA(activeIndex.c_str(), (path + CAPTURE_INDEX_EXTENSION).c_str(), MOVEFILE_WRITE_THROUGH);
+        }
+
+        current.index = index;
+        current.file = fileNamePart(path);
+        current.bytes = bytesWritten - bytesAtSegmentStart;
+        current.storedBytes = current.bytes;
+        if (!manifest.add(current)) {
+            std::cerr << "Failed to update manifest: " << manifest.getPath() << std::endl;
+        }
+        if (options.compress) compressor.enqueue(index, path);
+
+        rotatedCount++;
+        current = SegmentInfo();
+        bytesAtSegmentStart = bytesWritten;
+        nextBoundaryMs = 0;
+        return true;
+    }
+
+    // Stops the compression thread; the active file is left in place
+    void close() {
+        compressor.stop();
+    }
+
+    const SegmentManifest& getManifest() const {
+        return manifest;
+    }
+
+    unsigned long long getRotatedCount() const {
+        return rotatedCount;
+    }
+
+    unsigned long long getCompressedCount() const {
+        return compressor.getCompressedCount();
+    }
+
+    unsigned long long getCompressionFailures() const {
+        return compressor.getFailedCount();
+    }
+};
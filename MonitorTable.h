@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BehavioralEvent.h"
+
+// Monitor geometry as the capture saw it, so rows can carry positions and
+// speeds that do not depend on the resolution and pixel density of the
+// screen they were recorded on. Built by DisplayGeometry, stored in binary
+// logs as a monitor table block, and used by the CSV formatter.
+
+// BehavioralEvent::monitor of a mouse record whose monitor is not known
+// (no table, outside every monitor, or a log written before monitors were
+// recorded)
+const uint8_t MONITOR_NONE = 0xFF;
+const size_t MAX_MONITORS = 64;
+
+const float MM_PER_INCH = 25.4f;
+const uint32_t DEFAULT_MONITOR_DPI = 96;
+
+struct MonitorInfo {
+    int32_t left, top;       // Virtual-screen coordinates, physical pixels
+    int32_t width, height;
+    uint32_t dpi;            // Physical pixels per inch
+    // Derived once per table so converting a record is only multiplies
+    float invWidth, invHeight;
+    float mmPerPixel;
+
+    bool contains(int32_t x, int32_t y) const {
+        return x >= left && y >= top && x - left < width && y - top < height;
+    }
+};
+
+// A mouse record in screen-independent units
+struct NormalizedMouse {
+    float x, y;       // 0 to 1 across the monitor, from its top left corner
+    float speedMmps;  // mouseSpeed converted to millimetres per second
+};
+
+struct MonitorTable {
+    uint32_t generation = 0;  // Bumped on every rebuild (display change)
+    std::vector<MonitorInfo> monitors;
+
+    // 0 for dpi falls back to DEFAULT_MONITOR_DPI
+    static MonitorInfo makeMonitor(int32_t left, int32_t top, int32_t width, int32_t height, uint32_t dpi) {
+        MonitorInfo monitor;
+        monitor.left = left;
+        monitor.top = top;
+        monitor.width = width > 0 ? width : 1;
+        monitor.height = height > 0 ? height : 1;
+        monitor.dpi = dpi > 0 ? dpi : DEFAULT_MONITOR_DPI;
+        monitor.invWidth = 1.0f / monitor.width;
+        monitor.invHeight = 1.0f / monitor.height;
+        monitor.mmPerPixel = MM_PER_INCH / monitor.dpi;
+        return monitor;
+    }
+
+    // Index of the monitor containing the point; a linear scan, there are
+    // only ever a handful
+    uint8_t find(int32_t x, int32_t y) const {
+        for (size_t i = 0; i < monitors.size(); i++) {
+            if (monitors[i].contains(x, y)) return static_cast<uint8_t>(i);
+        }
+        return MONITOR_NONE;
+    }
+
+    // False for key records, an unknown monitor, or a position outside the
+    // monitor (a record from before a display change)
+    bool normalize(const BehavioralEvent& event, NormalizedMouse& out) const {
+        if (event.type > MOUSE_WHEEL || event.monitor >= monitors.size()) return false;
+        const MonitorInfo& monitor = monitors[event.monitor];
+        if (!monitor.contains(event.x, event.y)) return false;
+        out.x = (event.x - monitor.left) * monitor.invWidth;
+        out.y = (event.y - monitor.top) * monitor.invHeight;
+        out.speedMmps = event.mouseSpeed * monitor.mmPerPixel;
+        return true;
+    }
+};
+
+// Where writers find the table in effect (DisplayGeometry during a capture)
+class MonitorTableSource {
+public:
+    virtual ~MonitorTableSource() {}
+    virtual const MonitorTable* getTable() const = 0;  // Null when there is none
+};
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BehavioralEvent.h"
+
+// How MOUSE_MOVE records are thinned before they are stored
+enum DecimationPolicy {
+    DECIMATE_NONE,        // Keep every move
+    DECIMATE_EVERY_NTH,   // Keep every everyNth move regardless of motion (the former fixed sampling)
+    DECIMATE_MAX_RATE,    // Keep at most maxRateHz moves per second
+    DECIMATE_DISTANCE,    // Keep a move once it is minDistancePx away from the last kept one
+    DECIMATE_TRAJECTORY   // Ramer-Douglas-Peucker over short windows, keeps the shape within tolerancePx
+};
+
+// Command-line name of a policy: none, nth, rate, distance, trajectory
+inline bool parseDecimationPolicy(const std::string& name, DecimationPolicy& policy) {
+    if (name == "none") policy = DECIMATE_NONE;
+    else if (name == "nth") policy = DECIMATE_EVERY_NTH;
+    else if (name == "rate") policy = DECIMATE_MAX_RATE;
+    else if (name == "distance") policy = DECIMATE_DISTANCE;
+    else if (name == "trajectory") policy = DECIMATE_TRAJECTORY;
+    else return false;
+    return true;
+}
+
+struct DecimationOptions {
+    DecimationPolicy policy = DECIMATE_TRAJECTORY;
+    int everyNth = 3;
+    int maxRateHz = 125;
+    double minDistancePx = 3.0;
+    double tolerancePx = 1.0;    // Max distance of a dropped point from the kept polyline
+    size_t windowPoints = 64;    // Trajectory window is simplified once it holds this many moves...
+    int windowMs = 100;          // ...or spans this long, and on any other event or idle
+};
+
+// Decimation stage between the capture callbacks and addEvent().
+// Runs on the single consumer thread (drainer, or hook thread in sync mode).
+// Non-move records always pass through, after any moves held back for the
+// current window, so ordering is preserved. The policies that hold a move
+// back (rate, distance) still emit the last point of a motion, so the
+// resting position is never lost. time_since_last of every emitted record is
+// re-based onto the previous emitted record.
+class MouseDecimator {
+private:
+    DecimationOptions options;
+    std::vector<BehavioralEvent> window;  // Trajectory: anchor (already emitted) + pending moves
+    bool windowHasAnchor;
+    std::vector<char> keep;
+    std::vector<std::pair<size_t, size_t>> segments;
+
+    BehavioralEvent held;   // Rate/distance: latest move not emitted yet
+    bool hasHeld;
+    BehavioralEvent lastKept;
+    bool hasLastKept;
+    int moveCounter;
+    unsigned long long droppedGap;  // time_since_last of dropped records not yet re-based
+
+    std::atomic<unsigned long long> keptMoves;
+    std::atomic<unsigned long long> droppedMoves;
+
+    static void increment(std::atomic<unsigned long long>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    static double distance(const BehavioralEvent& a, const BehavioralEvent& b) {
+        const double dx = static_cast<double>(b.x) - a.x;
+        const double dy = static_cast<double>(b.y) - a.y;
+        return std::sqrt(dx * dx + dy * dy);
+    }
+
+    // Distance from p to the segment a-b
+    static double segmentDistance(const BehavioralEvent& p, const BehavioralEvent& a, const BehavioralEvent& b) {
+        const double vx = static_cast<double>(b.x) - a.x;
+        const double vy = static_cast<double>(b.y) - a.y;
+        const double wx = static_cast<double>(p.x) - a.x;
+        const double wy = static_cast<double>(p.y) - a.y;
+        const double lengthSquared = vx * vx + vy * vy;
+        if (lengthSquared == 0.0) return std::sqrt(wx * wx + wy * wy);
+
+        double t = (wx * vx + wy * vy) / lengthSquared;
+        if (t < 0.0) t = 0.0;
+        if (t > 1.0) t = 1.0;
+        const double dx = wx - t * vx;
+        const double dy = wy - t * vy;
+        return std::sqrt(dx * dx + dy * dy);
+    }
+
+    template <typename Emit>
+    void emit(BehavioralEvent event, Emit& sink) {
+        const unsigned long long gap = droppedGap + event.timeSinceLast;
+        event.timeSinceLast = gap > (std::numeric_limits<uint32_t>::max)()
+            ? (std::numeric_limits<uint32_t>::max)() : static_cast<uint32_t>(gap);
+        droppedGap = 0;
+        sink(event);
+    }
+
+    template <typename Emit>
+    void emitMove(const BehavioralEvent& event, Emit& sink) {
+        increment(keptMoves);
+        lastKept = event;
+        hasLastKept = true;
+        emit(event, sink);
+    }
+
+    void dropMove(const BehavioralEvent& event) {
+        increment(droppedMoves);
+        droppedGap += event.timeSinceLast;
+    }
+
+    // Iterative RDP over window[0..n), marks the points to keep
+    void simplifyWindow() {
+        const size_t n = window.size();
+        keep.assign(n, 0);
+        keep[0] = 1;
+        keep[n - 1] = 1;
+
+        segments.clear();
+        segments.push_back(std::make_pair(static_cast<size_t>(0), n - 1));
+        while (!segments.empty()) {
+            const size_t first = segments.back().first;
+            const size_t last = segments.back().second;
+            segments.pop_back();
+
+            double farthest = 0.0;
+            size_t index = first;
+            for (size_t i = first + 1; i < last; i++) {
+                const double d = segmentDistance(window[i], window[first], window[last]);
+                if (d > farthest) {
+                    farthest = d;
+                    index = i;
+                }
+            }
+            if (farthest > options.tolerancePx) {
+                keep[index] = 1;
+                segments.push_back(std::make_pair(first, index));
+                segments.push_back(std::make_pair(index, last));
+            }
+        }
+    }
+
+    // Emits the kept points of the window; its last point becomes the next anchor
+    template <typename Emit>
+    void flushWindow(Emit& sink) {
+        const size_t start = windowHasAnchor ? 1 : 0;
+        if (window.size() <= start) return;
+
+        simplifyWindow();
+        for (size_t i = start; i < window.size(); i++) {
+            if (keep[i]) emitMove(window[i], sink);
+            else dropMove(window[i]);
+        }
+
+        const BehavioralEvent anchor = window.back();
+        window.clear();
+        window.push_back(anchor);
+        windowHasAnchor = true;
+    }
+
+    template <typename Emit>
+    void flushHeld(Emit& sink) {
+        if (!hasHeld) return;
+        hasHeld = false;
+        emitMove(held, sink);
+    }
+
+    // Holds a move that did not pass the filter; it is only emitted if it
+    // turns out to be the last of the motion
+    void holdMove(const BehavioralEvent& event) {
+        if (hasHeld) dropMove(held);
+        held = event;
+        hasHeld = true;
+    }
+
+    // A kept move supersedes the held one
+    template <typename Emit>
+    void keepMove(const BehavioralEvent& event, Emit& sink) {
+        if (hasHeld) {
+            dropMove(held);
+            hasHeld = false;
+        }
+        emitMove(event, sink);
+    }
+
+    template <typename Emit>
+    void processMove(const BehavioralEvent& event, Emit& sink) {
+        switch (options.policy) {
+        case DECIMATE_NONE:
+            emitMove(event, sink);
+            break;
+
+        case DECIMATE_EVERY_NTH:
+            if (++moveCounter % options.everyNth == 0) emitMove(event, sink);
+            else dropMove(event);
+            break;
+
+        case DECIMATE_MAX_RATE: {
+            const long long minIntervalMs = options.maxRateHz > 0 ? 1000 / options.maxRateHz : 0;
+            if (!hasLastKept || event.timestamp - lastKept.timestamp >= minIntervalMs) {
+                keepMove(event, sink);
+            }
+            else {
+                holdMove(event);
+            }
+            break;
+        }
+
+        case DECIMATE_DISTANCE:
+            if (!hasLastKept || distance(lastKept, event) >= options.minDistancePx) {
+                keepMove(event, sink);
+            }
+            else {
+                holdMove(event);
+            }
+            break;
+
+        case DECIMATE_TRAJECTORY: {
+            window.push_back(event);
+            const size_t start = windowHasAnchor ? 1 : 0;
+            const long long span = event.timestamp - window[start].timestamp;
+            if (window.size() - start >= options.windowPoints || span >= options.windowMs) {
+                flushWindow(sink);
+            }
+            break;
+        }
+        }
+    }
+
+public:
+    MouseDecimator() :
+        windowHasAnchor(false),
+        hasHeld(false),
+        hasLastKept(false),
+        moveCounter(0),
+        droppedGap(0),
+        keptMoves(0),
+        droppedMoves(0) {
+        configure(DecimationOptions());
+    }
+
+    // Caller must flush() first when switching while events are pending
+    void configure(const DecimationOptions& decimationOptions) {
+        options = decimationOptions;
+        if (options.everyNth < 1) options.everyNth = 1;
+        if (options.windowPoints < 3) options.windowPoints = 3;
+        window.clear();
+        window.reserve(options.windowPoints + 1);
+        keep.reserve(options.windowPoints + 1);
+        segments.reserve(options.windowPoints + 1);
+        windowHasAnchor = false;
+        moveCounter = 0;
+    }
+
+    const DecimationOptions& getOptions() const {
+        return options;
+    }
+
+    // Passes event (and any moves it releases) to emit(const BehavioralEvent&)
+    template <typename Emit>
+    void process(const BehavioralEvent& event, Emit&& sink) {
+        if (event.type == MOUSE_MOVE) {
+            processMove(event, sink);
+            return;
+        }
+
+        flush(sink);
+        emit(event, sink);
+    }
+
+    // Releases held-back moves once the pointer has rested for windowMs
+    // (rate/distance) or the trajectory window is older than windowMs
+    template <typename Emit>
+    void flushIdle(long long nowMs, Emit&& sink) {
+        if (hasHeld && nowMs - held.timestamp >= options.windowMs) {
+            flushHeld(sink);
+        }
+        const size_t start = windowHasAnchor ? 1 : 0;
+        if (window.size() > start && nowMs - window[start].timestamp >= options.windowMs) {
+            flushWindow(sink);
+        }
+    }
+
+    // Releases everything pending
+    template <typename Emit>
+    void flush(Emit&& sink) {
+        flushHeld(sink);
+        flushWindow(sink);
+    }
+
+    std::string describe() const {
+        switch (options.policy) {
+        case DECIMATE_NONE:
+            return "none";
+        case DECIMATE_EVERY_NTH:
+            return "1/" + std::to_string(options.everyNth);
+        case DECIMATE_MAX_RATE:
+            return "max " + std::to_string(options.maxRateHz) + " Hz";
+        case DECIMATE_DISTANCE:
+            return "min distance " + std::to_string(options.minDistancePx) + " px";
+        case DECIMATE_TRAJECTORY:
+            return "trajectory (RDP, " + std::to_string(options.tolerancePx) + " px tolerance, "
+                + std::to_string(options.windowPoints) + " points / " + std::to_string(options.windowMs) + " ms windows)";
+        }
+        return "unknown";
+    }
+
+    unsigned long long getKeptMoves() const {
+        return keptMoves.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long getDroppedMoves() const {
+        return droppedMoves.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "BehavioralEvent.h"
+#include "ColumnarStats.h"
+
+const uint8_t KINEMATICS_HAS_ACCEL = 0x01;
+const uint8_t KINEMATICS_HAS_JERK = 0x02;
+const uint8_t KINEMATICS_HAS_CURVATURE = 0x04;
+
+// One step of the resampled cursor trajectory, ending at the move that
+// completed it
+struct KinematicSample {
+    double distance;   // px since the previous sample
+    double speed;      // px/s
+    double accel;      // d speed / dt, px/s^2 (signed)
+    double jerk;       // d accel / dt, px/s^3 (signed)
+    double heading;    // Direction of the step, atan2(dy, dx) in screen coordinates (y down)
+    double curvature;  // |heading change| per px since the previous heading, rad/px
+    uint8_t flags;     // KINEMATICS_HAS_*: which derivatives exist (they need earlier samples in the stroke)
+};
+
+// Kinematics stage at the head of the consumer pipeline.
+// The hook only stores a move's raw position and QPC time (moveTimeUs);
+// this stage turns a whole drained block into motion at once:
+//  1. gathers the block's moves into columns (position, microseconds since
+//     the previous move),
+//  2. computes the move-to-move speed of every move and writes it into
+//     mouseSpeed (px/s), before any other stage sees the record,
+//  3. when samples are enabled, picks the resampled trajectory (a sample
+//     once sampleMs have passed since the previous one, restarting after a
+//     pause longer than strokeGapMs),
+//  4. derives distance, speed, heading, acceleration, jerk and curvature
+//     of every sample for the feature extractor.
+// Steps 2 and 4 are branch-free loops over the columns: the speed kernel
+// has an AVX2 version, the others are left to the compiler's vectorizer.
+// Trajectory state carries over between blocks, so where the drainer
+// happens to split the stream does not change any result. Consumer thread
+// only (the hook thread in sync mode, one record per block).
+class KinematicsStage {
+private:
+    // moveTimeUs is 32 bits and wraps every ~71 minutes; longer gaps fall
+    // back to the millisecond timestamps
+    static const long long MOVE_TIME_WRAP_GUARD_MS = 3600000;
+
+    int sampleUs;
+    int strokeGapUs;
+    bool samplesEnabled;
+    SimdLevel simdLevel;
+
+    // Last move seen (column 0 of the next block)
+    bool hasMove;
+    int32_t lastX, lastY;
+    uint32_t lastTimeUs;
+    long long lastTimestamp;
+
+    // Start of the sample being accumulated, and the derivative chain of
+    // the current stroke
+    bool hasAnchor;
+    int32_t anchorX, anchorY;
+    double anchorElapsedUs;
+    bool hasSpeed, hasAccel, hasHeading;
+    double lastSpeed, lastAccel, lastHeading;
+
+    // Block columns; index 0 of the move and sample columns holds the
+    // carried state, so kernels can always look one element back
+    std::vector<uint32_t> moveRecord;
+    std::vector<int32_t> moveX, moveY;
+    std::vector<double> moveDtUs;
+    std::vector<float> moveSpeed;
+
+    std::vector<uint32_t> sampleRecord;
+    std::vector<double> sampleDx, sampleDy, sampleDt;  // dt in seconds
+    std::vector<uint8_t> sampleLinked;  // Previous sample is in the same stroke and has a speed
+    std::vector<double> sampleDistance, sampleSpeed, sampleHeading, sampleAccel;
+    std::vector<uint8_t> sampleHasAccel;
+
+    std::vector<KinematicSample> samples;
+    std::vector<int32_t> recordSample;  // Per block record: index into samples, -1 without one
+
+    std::atomic<unsigned long long> blocks;
+    std::atomic<unsigned long long> moves;
+
+    static void increment(std::atomic<unsigned long long>& counter, unsigned long long amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    static void scalarSpeeds(const int32_t* x, const int32_t* y, const double* dtUs, float* speed,
+        size_t begin, size_t n) {
+        for (size_t i = begin; i < n; i++) {
+            const double dx = static_cast<double>(x[i]) - x[i - 1];
+            const double dy = static_cast<double>(y[i]) - y[i - 1];
+            speed[i] = dtUs[i] > 0.0 ? static_cast<float>(std::sqrt(dx * dx + dy * dy) * 1000000.0 / dtUs[i]) : 0.0f;
+        }
+    }
+
+#if defined(BC_HAVE_X86_SIMD)
+    // speed[i] = |p[i] - p[i-1]| / dt[i] for i in [1, n), 0 where dt is 0
+    BC_TARGET_AVX2 static size_t avx2Speeds(const int32_t* x, const int32_t* y, const double* dtUs, float* speed, size_t n) {
+        const __m256d scale = _mm256_set1_pd(1000000.0);
+        const __m256d zero = _mm256_setzero_pd();
+        size_t i = 1;
+        for (; i + 4 <= n; i += 4) {
+            const __m256d dx = _mm256_sub_pd(
+                _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i))),
+                _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i - 1))));
+            const __m256d dy = _mm256_sub_pd(
+                _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i))),
+                _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i - 1))));
+            const __m256d dt = _mm256_loadu_pd(dtUs + i);
+            const __m256d distance = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+            const __m256d value = _mm256_div_pd(_mm256_mul_pd(distance, scale), dt);
+            const __m256d moving = _mm256_cmp_pd(dt, zero, _CMP_GT_OQ);  // Masks the inf/NaN of dt == 0
+            _mm_storeu_ps(speed + i, _mm256_cvtpd_ps(_mm256_and_pd(moving, value)));
+        }
+        return i;
+    }
+#endif
+
+    void computeSpeeds(size_t n) {
+        size_t done = 1;
+#if defined(BC_HAVE_X86_SIMD)
+        if (simdLevel == SIMD_AVX2) done = avx2Speeds(moveX.data(), moveY.data(), moveDtUs.data(), moveSpeed.data(), n);
+#endif
+        scalarSpeeds(moveX.data(), moveY.data(), moveDtUs.data(), moveSpeed.data(), done, n);
+    }
+
+    // Step 1: the block's moves as columns
+    size_t gatherMoves(const BehavioralEvent* events, size_t count) {
+        moveRecord.resize(count + 1);
+        moveX.resize(count + 1);
+        moveY.resize(count + 1);
+        moveDtUs.resize(count + 1);
+        moveSpeed.resize(count + 1);
+
+        moveX[0] = lastX;
+        moveY[0] = lastY;
+        size_t n = 1;
+        for (size_t i = 0; i < count; i++) {
+            const BehavioralEvent& event = events[i];
+            if (event.type != MOUSE_MOVE) continue;
+            if (!hasMove) {
+                // First move of the capture: nothing to measure from, speed 0
+                hasMove = true;
+                lastX = moveX[0] = event.x;
+                lastY = moveY[0] = event.y;
+                lastTimeUs = event.moveTimeUs;
+                lastTimestamp = event.timestamp;
+            }
+            moveRecord[n] = static_cast<uint32_t>(i);
+            moveX[n] = event.x;
+            moveY[n] = event.y;
+            moveDtUs[n] = event.timestamp - lastTimestamp > MOVE_TIME_WRAP_GUARD_MS
+                ? static_cast<double>(event.timestamp - lastTimestamp) * 1000.0
+                : static_cast<double>(static_cast<uint32_t>(event.moveTimeUs - lastTimeUs));
+            lastX = event.x;
+            lastY = event.y;
+            lastTimeUs = event.moveTimeUs;
+            lastTimestamp = event.timestamp;
+            n++;
+        }
+        return n;
+    }
+
+    void breakChain() {
+        hasSpeed = false;
+        hasAccel = false;
+        hasHeading = false;
+    }
+
+    // Step 3: one sample per completed interval; returns the columns used,
+    // strokeAfter is set when a new stroke began after the last sample
+    size_t selectSamples(size_t moveCount, bool& strokeAfter) {
+        sampleRecord.resize(moveCount);
+        sampleDx.resize(moveCount);
+        sampleDy.resize(moveCount);
+        sampleDt.resize(moveCount);
+        sampleLinked.resize(moveCount);
+
+        size_t s = 1;
+        bool chainBroken = false;  // A stroke started since the last sample
+        for (size_t k = 1; k < moveCount; k++) {
+            if (!hasAnchor || anchorElapsedUs + moveDtUs[k] > strokeGapUs) {
+                hasAnchor = true;
+                chainBroken = true;
+                anchorX = moveX[k];
+                anchorY = moveY[k];
+                anchorElapsedUs = 0.0;
+                continue;
+            }
+            anchorElapsedUs += moveDtUs[k];
+            if (anchorElapsedUs < sampleUs) continue;  // Wait until the interval is long enough
+
+            sampleRecord[s] = moveRecord[k];
+            sampleDx[s] = static_cast<double>(moveX[k]) - anchorX;
+            sampleDy[s] = static_cast<double>(moveY[k]) - anchorY;
+            sampleDt[s] = anchorElapsedUs / 1000000.0;
+            sampleLinked[s] = !chainBroken && (s > 1 || hasSpeed);
+            chainBroken = false;
+            s++;
+            anchorX = moveX[k];
+            anchorY = moveY[k];
+            anchorElapsedUs = 0.0;
+        }
+        strokeAfter = chainBroken;
+        return s;
+    }
+
+    // Step 4; also leaves the chain state for the next block
+    void deriveSamples(size_t s, bool strokeAfter) {
+        sampleDistance.resize(s);
+        sampleSpeed.resize(s);
+        sampleHeading.resize(s);
+        sampleAccel.resize(s);
+        sampleHasAccel.resize(s);
+        sampleSpeed[0] = lastSpeed;
+        sampleAccel[0] = lastAccel;
+        sampleHasAccel[0] = hasAccel;
+
+        for (size_t j = 1; j < s; j++) {
+            sampleDistance[j] = std::sqrt(sampleDx[j] * sampleDx[j] + sampleDy[j] * sampleDy[j]);
+            sampleSpeed[j] = sampleDistance[j] / sampleDt[j];
+        }
+        for (size_t j = 1; j < s; j++) {
+            sampleHeading[j] = std::atan2(sampleDy[j], sampleDx[j]);
+        }
+        for (size_t j = 1; j < s; j++) {
+            sampleAccel[j] = (sampleSpeed[j] - sampleSpeed[j - 1]) / sampleDt[j];
+            sampleHasAccel[j] = sampleLinked[j];
+        }
+
+        samples.resize(s - 1);
+        for (size_t j = 1; j < s; j++) {
+            KinematicSample& sample = samples[j - 1];
+            sample.distance = sampleDistance[j];
+            sample.speed = sampleSpeed[j];
+            sample.accel = sampleAccel[j];
+            sample.jerk = (sampleAccel[j] - sampleAccel[j - 1]) / sampleDt[j];
+            sample.heading = sampleHeading[j];
+            sample.curvature = 0.0;
+            sample.flags = 0;
+            if (sampleHasAccel[j]) sample.flags |= KINEMATICS_HAS_ACCEL;
+            if (sampleHasAccel[j] && sampleHasAccel[j - 1]) sample.flags |= KINEMATICS_HAS_JERK;
+
+            // A step without distance has no heading; curvature is measured
+            // against the last step of the stroke that had one
+            if (!sampleLinked[j]) hasHeading = false;
+            if (sample.distance > 0.0) {
+                if (hasHeading) {
+                    sample.curvature = std::fabs(wrapAngle(sample.heading - lastHeading)) / sample.distance;
+                    sample.flags |= KINEMATICS_HAS_CURVATURE;
+                }
+                lastHeading = sample.heading;
+                hasHeading = true;
+            }
+            recordSample[sampleRecord[j]] = static_cast<int32_t>(j - 1);
+        }
+
+        if (s > 1) {
+            lastSpeed = sampleSpeed[s - 1];
+            lastAccel = sampleAccel[s - 1];
+            hasSpeed = true;
+            hasAccel = sampleHasAccel[s - 1] != 0;
+        }
+        if (strokeAfter) breakChain();
+    }
+
+    static double wrapAngle(double angle) {
+        const double pi = 3.14159265358979323846;
+        while (angle > pi) angle -= 2.0 * pi;
+        while (angle < -pi) angle += 2.0 * pi;
+        return angle;
+    }
+
+public:
+    KinematicsStage() :
+        sampleUs(10000),
+        strokeGapUs(250000),
+        samplesEnabled(false),
+        simdLevel(detectSimdLevel()),
+        blocks(0),
+        moves(0) {
+        reset();
+    }
+
+    // Resampling interval and stroke gap of the feature extractor; without
+    // samples only mouseSpeed is filled in
+    void configure(int sampleMs, int strokeGapMs, bool computeSamples) {
+        sampleUs = (sampleMs < 1 ? 1 : sampleMs) * 1000;
+        strokeGapUs = (strokeGapMs < 0 ? 0 : strokeGapMs) * 1000;
+        samplesEnabled = computeSamples;
+        reset();
+    }
+
+    // Forgets the trajectory (start of a capture)
+    void reset() {
+        hasMove = false;
+        lastX = lastY = 0;
+        lastTimeUs = 0;
+        lastTimestamp = 0;
+        hasAnchor = false;
+        anchorX = anchorY = 0;
+        anchorElapsedUs = 0.0;
+        lastSpeed = lastAccel = lastHeading = 0.0;
+        breakChain();
+        samples.clear();
+        recordSample.clear();
+    }
+
+    // Replaces moveTimeUs with mouseSpeed in every MOUSE_MOVE of the block
+    // and derives its samples, valid until the next call
+    void process(BehavioralEvent* events, size_t count) {
+        recordSample.assign(count, -1);
+        samples.clear();
+
+        const size_t n = gatherMoves(events, count);
+        if (n == 1) return;
+        computeSpeeds(n);
+        for (size_t k = 1; k < n; k++) {
+            events[moveRecord[k]].mouseSpeed = moveSpeed[k];
+        }
+        increment(blocks, 1);
+        increment(moves, n - 1);
+
+        if (!samplesEnabled) return;
+        bool strokeAfter = false;
+        const size_t s = selectSamples(n, strokeAfter);
+        deriveSamples(s, strokeAfter);
+    }
+
+    // Sample completed by record i of the last block, or null
+    const KinematicSample* sampleFor(size_t i) const {
+        if (i >= recordSample.size() || recordSample[i] < 0) return nullptr;
+        return &samples[recordSample[i]];
+    }
+
+    SimdLevel getSimdLevel() const {
+        return simdLevel;
+    }
+
+    unsigned long long getBlocks() const {
+        return blocks.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long getMoves() const {
+        return moves.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,661 @@
+#pragma once
+
+// Include before <windows.h> (or anything that includes it), otherwise the
+// legacy winsock.h pulled in by windows.h conflicts with winsock2.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <compressapi.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BehavioralEvent.h"
+#include "BinaryLog.h"
+#include "EventSink.h"
+
+#pragma comment(lib, "Ws2_32.lib")
+#pragma comment(lib, "Cabinet.lib")
+
+// Streams events to a central collector (CaptureCollector) over one
+// persistent TCP connection.
+//
+// The consumer thread only encodes: every batchEvents events (or after
+// batchIntervalMs) the batch becomes .bclog blocks, an app dictionary for
+// the apps it uses, the monitor table and one events block, and is queued. A sender
+// thread compresses each batch (XPRESS+Huffman) and sends it. Batches are
+// self-contained, so any frame can be replayed later.
+//
+// Every frame sent carries a sequence number and stays in memory until the
+// collector acknowledges it, after writing it out. When the connection
+// drops, the unacknowledged frames are sent again after reconnecting, ahead
+// of anything spooled since; the collector skips sequence numbers it has
+// already written, so a frame is neither lost nor appended twice. At most
+// NETWORK_MAX_UNACKED_FRAMES are in flight; beyond that the sender waits
+// for acknowledgements. Frames still unacknowledged at close() go to the
+// front of the spool. Only a crash of the agent loses them.
+//
+// While the collector is unreachable frames go to a local spool file, up to
+// maxSpoolBytes (newer frames are dropped beyond that); after reconnecting
+// the spool is sent first, so the collector receives frames in order. A
+// spool left by a previous run is sent on the next connection.
+//
+// Wire format (little-endian):
+//   hello  "BCN1", uint16 version, uint16 name length, uint64 stream ID
+//          (random per agent run), computer name
+//   reply  uint64 last sequence number the collector wrote for the stream,
+//          0 if it does not know it
+//   frame  uint64 sequence number (from 1), uint32 uncompressed size,
+//          uint32 compressed size, compressed bytes
+//   ack    uint64 sequence number, sent by the collector per frame
+// The spool file holds frames without the sequence number; they get one
+// when they are sent.
+
+const char NETWORK_HELLO_MAGIC[4] = { 'B', 'C', 'N', '1' };
+const uint16_t NETWORK_PROTOCOL_VERSION = 2;
+const uint32_t NETWORK_MAX_FRAME_BYTES = 64 * 1024 * 1024;
+const size_t NETWORK_HELLO_SIZE = 16;         // Before the computer name
+const size_t NETWORK_FRAME_HEADER_SIZE = 8;   // Sizes, as spooled
+const size_t NETWORK_SEQUENCE_SIZE = 8;       // Precedes the sizes on the wire
+const size_t NETWORK_MAX_UNACKED_FRAMES = 64;
+
+struct NetworkOptions {
+    std::string host;                  // Collector host name or address, empty = off
+    unsigned short port = 9570;
+    size_t batchEvents = 1024;         // Events per frame
+    int batchIntervalMs = 1000;        // A partial batch is sent after this long
+    size_t queueBatches = 64;          // Batches waiting for the sender; more are dropped
+    std::string spoolFile;             // Empty: <log name>.spool
+    unsigned long long maxSpoolBytes = 64ull * 1024 * 1024;
+    int reconnectIntervalMs = 5000;
+    int socketTimeoutMs = 5000;        // Connect and send timeout
+
+    bool isEnabled() const {
+        return !host.empty();
+    }
+};
+
+// Buffer-mode XPRESS+Huffman, one handle reused for every frame
+class FrameCompressor {
+private:
+    COMPRESSOR_HANDLE compressor;
+
+public:
+    FrameCompressor() : compressor(NULL) {}
+
+    ~FrameCompressor() {
+        if (compressor) CloseCompressor(compressor);
+    }
+
+    FrameCompressor(const FrameCompressor&) = delete;
+    FrameCompressor& operator=(const FrameCompressor&) = delete;
+
+    // Appends a whole frame (header and compressed payload) to frame
+    bool compress(const std::vector<uint8_t>& payload, std::vector<uint8_t>& frame) {
+        if (!compressor && !CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, NULL, &compressor)) {
+            compressor = NULL;
+            return false;
+        }
+        SIZE_T needed = 0;
+        if (!Compress(compressor, payload.data(), payload.size(), NULL, 0, &needed) &&
+            GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+            return false;
+        }
+
+        const size_t start = frame.size();
+        frame.resize(start + NETWORK_FRAME_HEADER_SIZE + needed);
+        SIZE_T packed = 0;
+        if (!Compress(compressor, payload.data(), payload.size(),
+                frame.data() + start + NETWORK_FRAME_HEADER_SIZE, needed, &packed)) {
+            frame.resize(start);
+            return false;
+        }
+        frame.resize(start + NETWORK_FRAME_HEADER_SIZE + packed);
+        const uint32_t sizes[2] = { static_cast<uint32_t>(payload.size()), static_cast<uint32_t>(packed) };
+        for (int i = 0; i < 2; i++) {
+            for (int b = 0; b < 4; b++) frame[start + i * 4 + b] = static_cast<uint8_t>(sizes[i] >> (8 * b));
+        }
+        return true;
+    }
+};
+
+// Collector side of FrameCompressor
+class FrameDecompressor {
+private:
+    DECOMPRESSOR_HANDLE decompressor;
+
+public:
+    FrameDecompressor() : decompressor(NULL) {}
+
+    ~FrameDecompressor() {
+        if (decompressor) CloseDecompressor(decompressor);
+    }
+
+    FrameDecompressor(const FrameDecompressor&) = delete;
+    FrameDecompressor& operator=(const FrameDecompressor&) = delete;
+
+    bool decompress(const uint8_t* packed, size_t packedSize, size_t originalSize, std::vector<uint8_t>& payload) {
+        if (!decompressor && !CreateDecompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, NULL, &decompressor)) {
+            decompressor = NULL;
+            return false;
+        }
+        payload.resize(originalSize);
+        SIZE_T length = 0;
+        return Decompress(decompressor, packed, packedSize, payload.data(), payload.size(), &length) &&
+            length == originalSize;
+    }
+};
+
+// Blocking helpers for a connected socket
+inline bool sendAll(SOCKET socket, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        const int chunk = static_cast<int>(std::min<size_t>(size, 1 << 20));
+        const int sent = send(socket, reinterpret_cast<const char*>(data), chunk, 0);
+        if (sent <= 0) return false;
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+inline bool receiveAll(SOCKET socket, uint8_t* data, size_t size) {
+    while (size > 0) {
+        const int chunk = static_cast<int>(std::min<size_t>(size, 1 << 20));
+        const int received = recv(socket, reinterpret_cast<char*>(data), chunk, 0);
+        if (received <= 0) return false;
+        data += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+class NetworkSink : public EventSink {
+private:
+    NetworkOptions options;
+    std::string spoolPath;
+    std::string computerName;
+
+    // Consumer thread
+    std::vector<BehavioralEvent> pending;
+    std::vector<uint16_t> pendingApps;      // Apps used by pending, with their names
+    std::vector<std::string> pendingAppNames;
+    std::vector<bool> appPending;           // Indexed by app ID
+    std::vector<uint8_t> block;
+    std::chrono::steady_clock::time_point batchStarted;
+    const MonitorTableSource* monitors;
+
+    // Shared with the sender thread
+    std::mutex queueMutex;
+    std::condition_variable wake;
+    std::deque<std::vector<uint8_t>> queue;  // Uncompressed batches
+    bool running;
+    std::thread sender;
+
+    // Sender thread
+    SOCKET connection;
+    FrameCompressor compressor;
+    std::fstream spool;
+    unsigned long long spoolBytes;
+    unsigned long long spoolSent;  // Bytes of the spool already delivered
+    std::chrono::steady_clock::time_point nextConnectAttempt;
+
+    // Sent, waiting for the collector's acknowledgement, oldest first
+    struct UnackedFrame {
+        uint64_t sequence;
+        std::vector<uint8_t> frame;
+    };
+    std::deque<UnackedFrame> unacked;
+    uint64_t streamId;
+    uint64_t nextSequence;
+
+    std::atomic<unsigned long long> sentFrames;
+    std::atomic<unsigned long long> sentBytes;      // On the wire
+    std::atomic<unsigned long long> encodedBytes;   // Before compression
+    std::atomic<unsigned long long> spooledFrames;
+    std::atomic<unsigned long long> droppedFrames;
+    std::atomic<unsigned long long> droppedEvents;
+    std::atomic<unsigned long long> resentFrames;
+    std::atomic<unsigned long long> connectCount;
+    std::atomic<bool> connected;
+    bool winsockStarted;
+
+    static void bump(std::atomic<unsigned long long>& counter, unsigned long long amount = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    void encodeBatch() {
+        std::vector<uint8_t> payload;
+        block.clear();
+        BinaryCodec::putVarint(block, pendingApps.size());
+        for (size_t i = 0; i < pendingApps.size(); i++) {
+            const std::string& name = pendingAppNames[i];
+            BinaryCodec::putVarint(block, pendingApps[i]);
+            BinaryCodec::putVarint(block, name.size());
+            block.insert(block.end(), name.begin(), name.end());
+        }
+        appendBlock(payload, BLOCK_APP_DICTIONARY);
+
+        // Every frame carries the table, a few bytes per monitor
+        if (const MonitorTable* table = monitors ? monitors->getTable() : nullptr) {
+            block.clear();
+            BinaryCodec::encodeMonitorTable(*table, block);
+            appendBlock(payload, BLOCK_MONITOR_TABLE);
+        }
+
+        block.clear();
+        BinaryCodec::encodeEvents(pending, block);
+        appendBlock(payload, BLOCK_EVENTS_MONITORS);
+
+        bool queued = false;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (queue.size() < options.queueBatches) {
+                queue.push_back(std::move(payload));
+                queued = true;
+            }
+        }
+        if (queued) {
+            wake.notify_one();
+        }
+        else {
+            bump(droppedFrames);
+            bump(droppedEvents, pending.size());
+        }
+
+        for (uint16_t id : pendingApps) appPending[id] = false;
+        pendingApps.clear();
+        pendingAppNames.clear();
+        pending.clear();
+    }
+
+    void appendBlock(std::vector<uint8_t>& payload, BinaryBlockType type) {
+        uint8_t header[BINARY_BLOCK_HEADER_SIZE];
+        BinaryCodec::putBlockHeader(header, type, block.size());
+        payload.insert(payload.end(), header, header + sizeof(header));
+        payload.insert(payload.end(), block.begin(), block.end());
+    }
+
+    bool connectToCollector() {
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(options.host.c_str(), std::to_string(options.port).c_str(), &hints, &addresses) != 0) {
+            return false;
+        }
+
+        for (addrinfo* address = addresses; address && connection == INVALID_SOCKET; address = address->ai_next) {
+            SOCKET candidate = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (candidate == INVALID_SOCKET) continue;
+
+            // Non-blocking connect so an unreachable collector costs at most the timeout
+            u_long nonBlocking = 1;
+            ioctlsocket(candidate, FIONBIO, &nonBlocking);
+            bool ok = connect(candidate, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0 ||
+                WSAGetLastError() == WSAEWOULDBLOCK;
+            if (ok) {
+                fd_set writable, failed;
+                FD_ZERO(&writable);
+                FD_ZERO(&failed);
+                FD_SET(candidate, &writable);
+                FD_SET(candidate, &failed);
+                timeval timeout = { options.socketTimeoutMs / 1000, (options.socketTimeoutMs % 1000) * 1000 };
+                ok = select(0, NULL, &writable, &failed, &timeout) == 1 && FD_ISSET(candidate, &writable);
+            }
+            if (!ok) {
+                closesocket(candidate);
+                continue;
+            }
+
+            nonBlocking = 0;
+            ioctlsocket(candidate, FIONBIO, &nonBlocking);
+            const DWORD timeoutMs = static_cast<DWORD>(options.socketTimeoutMs);
+            setsockopt(candidate, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeoutMs), sizeof(timeoutMs));
+            setsockopt(candidate, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeoutMs), sizeof(timeoutMs));
+            const BOOL keepAlive = TRUE;
+            setsockopt(candidate, SOL_SOCKET, SO_KEEPALIVE, reinterpret_cast<const char*>(&keepAlive), sizeof(keepAlive));
+            connection = candidate;
+        }
+        freeaddrinfo(addresses);
+        if (connection == INVALID_SOCKET) return false;
+
+        std::vector<uint8_t> hello(NETWORK_HELLO_MAGIC, NETWORK_HELLO_MAGIC + sizeof(NETWORK_HELLO_MAGIC));
+        BinaryCodec::putUint16(hello, NETWORK_PROTOCOL_VERSION);
+        BinaryCodec::putUint16(hello, static_cast<uint16_t>(computerName.size()));
+        BinaryCodec::putUint64(hello, streamId);
+        hello.insert(hello.end(), computerName.begin(), computerName.end());
+        uint8_t reply[NETWORK_SEQUENCE_SIZE];
+        if (!sendAll(connection, hello.data(), hello.size()) || !receiveAll(connection, reply, sizeof(reply))) {
+            disconnect();
+            return false;
+        }
+        connected.store(true, std::memory_order_relaxed);
+        bump(connectCount);
+
+        // What the collector wrote before the link dropped is done; the rest goes again
+        acknowledge(BinaryCodec::readUint64(reply));
+        for (const UnackedFrame& entry : unacked) {
+            if (!sendSequenced(entry.sequence, entry.frame)) {
+                disconnect();
+                return false;
+            }
+            bump(resentFrames);
+        }
+        return true;
+    }
+
+    void disconnect() {
+        if (connection != INVALID_SOCKET) {
+            closesocket(connection);
+            connection = INVALID_SOCKET;
+        }
+        connected.store(false, std::memory_order_relaxed);
+        nextConnectAttempt = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.reconnectIntervalMs);
+    }
+
+    bool sendSequenced(uint64_t sequence, const std::vector<uint8_t>& frame) {
+        std::vector<uint8_t> prefix;
+        BinaryCodec::putUint64(prefix, sequence);
+        if (!sendAll(connection, prefix.data(), prefix.size()) || !sendAll(connection, frame.data(), frame.size())) {
+            return false;
+        }
+        bump(sentFrames);
+        bump(sentBytes, prefix.size() + frame.size());
+        return true;
+    }
+
+    void acknowledge(uint64_t sequence) {
+        while (!unacked.empty() && unacked.front().sequence <= sequence) unacked.pop_front();
+    }
+
+    // Reads the acknowledgements that arrived, waiting up to timeoutMs for
+    // the first one; false when the connection failed
+    bool receiveAcks(int timeoutMs) {
+        for (;;) {
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(connection, &readable);
+            timeval timeout = { timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+            const int ready = select(0, &readable, NULL, NULL, &timeout);
+            if (ready < 0) return false;
+            if (ready == 0) return timeoutMs == 0;
+
+            uint8_t ack[NETWORK_SEQUENCE_SIZE];
+            if (!receiveAll(connection, ack, sizeof(ack))) return false;
+            acknowledge(BinaryCodec::readUint64(ack));
+            timeoutMs = 0;
+        }
+    }
+
+    // Sends a frame and keeps it until it is acknowledged; false (frame not
+    // taken) when the connection dropped or the collector stopped answering
+    bool sendFrame(const std::vector<uint8_t>& frame) {
+        if (!receiveAcks(0) ||
+            (unacked.size() >= NETWORK_MAX_UNACKED_FRAMES && !receiveAcks(options.socketTimeoutMs)) ||
+            unacked.size() >= NETWORK_MAX_UNACKED_FRAMES) {
+            disconnect();
+            return false;
+        }
+        // Taken from here on: if the send fails the frame goes again after reconnecting
+        unacked.push_back({ nextSequence++, frame });
+        if (!sendSequenced(unacked.back().sequence, frame)) disconnect();
+        return true;
+    }
+
+    void spoolFrame(const std::vector<uint8_t>& frame) {
+        if (!spool.is_open() || spoolBytes + frame.size() > options.maxSpoolBytes) {
+            bump(droppedFrames);
+            return;
+        }
+        spool.clear();
+        spool.seekp(0, std::ios::end);
+        spool.write(reinterpret_cast<const char*>(frame.data()), frame.size());
+        spool.flush();
+        spoolBytes += frame.size();
+        bump(spooledFrames);
+    }
+
+    // Sends spooled frames in order; false when the connection dropped
+    bool drainSpool() {
+        std::vector<uint8_t> frame;
+        while (spoolSent < spoolBytes) {
+            uint8_t header[NETWORK_FRAME_HEADER_SIZE];
+            spool.clear();
+            spool.seekg(static_cast<std::streamoff>(spoolSent));
+            if (!spool.read(reinterpret_cast<char*>(header), sizeof(header))) break;
+            const uint32_t packed = BinaryCodec::readUint32(header + 4);
+            if (packed > NETWORK_MAX_FRAME_BYTES || spoolBytes - spoolSent - sizeof(header) < packed) break;
+            frame.assign(header, header + sizeof(header));
+            frame.resize(sizeof(header) + packed);
+            if (!spool.read(reinterpret_cast<char*>(frame.data() + sizeof(header)), packed)) break;
+            if (!sendFrame(frame)) return false;
+            spoolSent += frame.size();
+            if (connection == INVALID_SOCKET) return false;
+        }
+
+        // Delivered (or the rest is unreadable): start over with an empty spool
+        spool.close();
+        spool.open(spoolPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        spoolBytes = 0;
+        spoolSent = 0;
+        return true;
+    }
+
+    // Drops the delivered front of the spool so the next run does not resend
+    // it, and puts unacknowledged frames in front of what is left
+    void compactSpool() {
+        std::vector<char> rest(static_cast<size_t>(spoolBytes - spoolSent));
+        spool.clear();
+        spool.seekg(static_cast<std::streamoff>(spoolSent));
+        if (!rest.empty() && !spool.read(rest.data(), rest.size())) rest.clear();
+        spool.close();
+        spool.open(spoolPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        spoolBytes = 0;
+        for (const UnackedFrame& entry : unacked) {
+            spool.write(reinterpret_cast<const char*>(entry.frame.data()), entry.frame.size());
+            spoolBytes += entry.frame.size();
+        }
+        unacked.clear();
+        spool.write(rest.data(), rest.size());
+        spool.flush();
+        spoolBytes += rest.size();
+        spoolSent = 0;
+    }
+
+    void senderThreadProc() {
+        std::vector<uint8_t> payload, frame;
+        std::unique_lock<std::mutex> lock(queueMutex);
+        for (;;) {
+            if (queue.empty() && running) {
+                // Wakes up to retry the connection while frames are spooled
+                // or waiting to be sent again
+                if (spoolBytes > spoolSent || (connection == INVALID_SOCKET && !unacked.empty())) {
+                    wake.wait_for(lock, std::chrono::milliseconds(options.reconnectIntervalMs));
+                }
+                else {
+                    wake.wait(lock);
+                }
+            }
+            const bool stopping = !running;
+            const bool haveBatch = !queue.empty();
+            if (haveBatch) {
+                payload = std::move(queue.front());
+                queue.pop_front();
+            }
+            lock.unlock();
+
+            // Once stopping, an unreachable collector must not delay the exit:
+            // what is left goes to the spool for the next run
+            if (connection == INVALID_SOCKET && !stopping && std::chrono::steady_clock::now() >= nextConnectAttempt) {
+                if (!connectToCollector()) disconnect();
+            }
+            bool online = connection != INVALID_SOCKET && (spoolBytes == spoolSent || drainSpool());
+
+            if (haveBatch) {
+                bump(encodedBytes, payload.size());
+                frame.clear();
+                if (!compressor.compress(payload, frame)) {
+                    bump(droppedFrames);
+                }
+                else if (!online || !sendFrame(frame)) {
+                    spoolFrame(frame);
+                }
+            }
+
+            lock.lock();
+            if (stopping && queue.empty()) break;
+        }
+        lock.unlock();
+        // Gives the collector a moment to confirm the last frames, so the
+        // next run does not send them again
+        while (connection != INVALID_SOCKET && !unacked.empty()) {
+            if (!receiveAcks(options.socketTimeoutMs)) break;
+        }
+        disconnect();
+    }
+
+public:
+    NetworkSink() :
+        monitors(nullptr),
+        running(false),
+        connection(INVALID_SOCKET),
+        spoolBytes(0),
+        spoolSent(0),
+        streamId(0),
+        nextSequence(1),
+        sentFrames(0),
+        sentBytes(0),
+        encodedBytes(0),
+        spooledFrames(0),
+        droppedFrames(0),
+        droppedEvents(0),
+        resentFrames(0),
+        connectCount(0),
+        connected(false),
+        winsockStarted(false) {}
+
+    ~NetworkSink() {
+        close();
+    }
+
+    NetworkSink(const NetworkSink&) = delete;
+    NetworkSink& operator=(const NetworkSink&) = delete;
+
+    // Optional: monitor geometry sent with every frame
+    void setMonitorSource(const MonitorTableSource* source) {
+        monitors = source;
+    }
+
+    // Starts the sender thread; the connection itself is made (and retried)
+    // in the background, so an offline collector does not fail the open
+    bool open(const NetworkOptions& networkOptions, const std::string& logFilename) {
+        options = networkOptions;
+        if (options.batchEvents == 0) options.batchEvents = 1;
+        if (options.queueBatches == 0) options.queueBatches = 1;
+
+        WSADATA wsaData;
+        if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) return false;
+        winsockStarted = true;
+
+        char name[MAX_COMPUTERNAME_LENGTH + 1];
+        DWORD nameLength = sizeof(name);
+        computerName = GetComputerNameA(name, &nameLength) ? std::string(name, nameLength) : "unknown";
+
+        spoolPath = options.spoolFile.empty() ? logFilename + ".spool" : options.spoolFile;
+        spool.open(spoolPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::app);
+        spool.close();  // Created if missing; reopened without app so reads can seek
+        spool.open(spoolPath, std::ios::in | std::ios::out | std::ios::binary);
+        if (!spool.is_open()) {
+            WSACleanup();
+            winsockStarted = false;
+            return false;
+        }
+        spool.seekg(0, std::ios::end);
+        spoolBytes = static_cast<unsigned long long>(spool.tellg());
+        spoolSent = 0;
+
+        // Distinguishes this run's sequence numbers from an earlier run's
+        LARGE_INTEGER ticks;
+        QueryPerformanceCounter(&ticks);
+        streamId = (static_cast<uint64_t>(GetCurrentProcessId()) << 32) ^ static_cast<uint64_t>(ticks.QuadPart) ^
+            static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+        nextSequence = 1;
+        unacked.clear();
+
+        pending.reserve(options.batchEvents);
+        batchStarted = std::chrono::steady_clock::now();
+        nextConnectAttempt = batchStarted;
+        running = true;
+        sender = std::thread(&NetworkSink::senderThreadProc, this);
+        return true;
+    }
+
+    bool isOpen() const {
+        return sender.joinable();
+    }
+
+    void write(const BehavioralEvent& event, const std::string& appName) override {
+        if (pending.empty()) batchStarted = std::chrono::steady_clock::now();
+        pending.push_back(event);
+        if (event.appId >= appPending.size()) appPending.resize(event.appId + 1, false);
+        if (!appPending[event.appId]) {
+            appPending[event.appId] = true;
+            pendingApps.push_back(event.appId);
+            pendingAppNames.push_back(appName);
+        }
+        if (pending.size() >= options.batchEvents) encodeBatch();
+    }
+
+    void flushIfDue() override {
+        if (!pending.empty() &&
+            std::chrono::steady_clock::now() - batchStarted >= std::chrono::milliseconds(options.batchIntervalMs)) {
+            encodeBatch();
+        }
+    }
+
+    void flushAll() override {
+        if (!pending.empty()) encodeBatch();
+    }
+
+    // Sends what is left; frames that cannot be delivered stay in the spool
+    void close() override {
+        if (!sender.joinable()) return;
+        if (!pending.empty()) encodeBatch();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            running = false;
+        }
+        wake.notify_one();
+        sender.join();
+
+        if (spoolSent > 0 || !unacked.empty()) compactSpool();
+        spool.close();
+        if (winsockStarted) {
+            WSACleanup();
+            winsockStarted = false;
+        }
+    }
+
+    unsigned long long getBytesWritten() const override {
+        return sentBytes.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long getSentFrames() const { return sentFrames.load(std::memory_order_relaxed); }
+    unsigned long long getEncodedBytes() const { return encodedBytes.load(std::memory_order_relaxed); }
+    unsigned long long getSpooledFrames() const { return spooledFrames.load(std::memory_order_relaxed); }
+    unsigned long long getDroppedFrames() const { return droppedFrames.load(std::memory_order_relaxed); }
+    unsigned long long getDroppedEvents() const { return droppedEvents.load(std::memory_order_relaxed); }
+    unsigned long long getResentFrames() const { return resentFrames.load(std::memory_order_relaxed); }
+    unsigned long long getConnectCount() const { return connectCount.load(std::memory_order_relaxed); }
+    bool isConnected() const { return connected.load(std::memory_order_relaxed); }
+};
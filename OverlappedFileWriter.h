@@ -0,0 +1,210 @@
+#pragma once
+
+#include <windows.h>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+// When a partially filled block is handed to the disk
+enum FlushPolicy {
+    FLUSH_ON_STOP,      // Only full blocks are written until close()
+    FLUSH_EVERY_BYTES,  // Submit the current block once flushBytes are pending
+    FLUSH_EVERY_MS      // Submit the current block once its oldest data is flushIntervalMs old
+};
+
+struct OverlappedWriterOptions {
+    size_t blockSize = 1 << 20;  // Bytes per buffer, rounded up to the page size
+    FlushPolicy flushPolicy = FLUSH_EVERY_MS;
+    size_t flushBytes = 64 * 1024;
+    int flushIntervalMs = 1000;
+};
+
+// Append-only file writer built on WriteFile with FILE_FLAG_OVERLAPPED.
+// Data is copied into one of two page-aligned blocks; a full block is
+// submitted asynchronously and the producer switches to the other block,
+// so appending only waits if the disk is an entire block behind.
+// Note that NTFS may still complete file-extending writes synchronously.
+class OverlappedFileWriter {
+private:
+    static const int BLOCK_COUNT = 2;
+
+    struct Block {
+        char* data;
+        size_t used;
+        bool inFlight;
+        OVERLAPPED overlapped;
+    };
+
+    HANDLE file;
+    Block blocks[BLOCK_COUNT];
+    int active;
+    unsigned long long nextOffset;  // File offset of the active block's first byte
+    size_t blockSize;
+    OverlappedWriterOptions options;
+    std::chrono::steady_clock::time_point pendingSince;
+    bool writeFailed;
+
+    static size_t roundUpToPageSize(size_t size) {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        const size_t page = info.dwPageSize;
+        return ((size + page - 1) / page) * page;
+    }
+
+    // Waits for an in-flight block and makes it reusable
+    void completeBlock(Block& block) {
+        if (!block.inFlight) return;
+
+        DWORD transferred = 0;
+        if (!GetOverlappedResult(file, &block.overlapped, &transferred, TRUE) || transferred != block.used) {
+            writeFailed = true;
+        }
+        block.inFlight = false;
+        block.used = 0;
+    }
+
+    // Hands the active block to the OS and switches to the other one
+    void submitActive() {
+        Block& block = blocks[active];
+        if (block.used == 0) return;
+
+        HANDLE event = block.overlapped.hEvent;
+        ZeroMemory(&block.overlapped, sizeof(block.overlapped));
+        block.overlapped.hEvent = event;
+        block.overlapped.Offset = static_cast<DWORD>(nextOffset & 0xFFFFFFFF);
+        block.overlapped.OffsetHigh = static_cast<DWORD>(nextOffset >> 32);
+
+        if (WriteFile(file, block.data, static_cast<DWORD>(block.used), NULL, &block.overlapped) ||
+            GetLastError() == ERROR_IO_PENDING) {
+            block.inFlight = true;  // Completed or pending, either way reaped in completeBlock()
+            nextOffset += block.used;
+        }
+        else {
+            // The block is lost; the next one goes to the same offset so the file has no hole
+            writeFailed = true;
+            block.used = 0;
+        }
+
+        active = (active + 1) % BLOCK_COUNT;
+        completeBlock(blocks[active]);  // Only waits if the disk is a full block behind
+    }
+
+    void releaseBlocks() {
+        for (int i = 0; i < BLOCK_COUNT; i++) {
+            if (blocks[i].data) VirtualFree(blocks[i].data, 0, MEM_RELEASE);
+            if (blocks[i].overlapped.hEvent) CloseHandle(blocks[i].overlapped.hEvent);
+            blocks[i].data = NULL;
+            blocks[i].overlapped.hEvent = NULL;
+        }
+    }
+
+public:
+    OverlappedFileWriter() :
+        file(INVALID_HANDLE_VALUE),
+        active(0),
+        nextOffset(0),
+        blockSize(0),
+        writeFailed(false) {
+        ZeroMemory(blocks, sizeof(blocks));
+    }
+
+    ~OverlappedFileWriter() {
+        close();
+    }
+
+    OverlappedFileWriter(const OverlappedFileWriter&) = delete;
+    OverlappedFileWriter& operator=(const OverlappedFileWriter&) = delete;
+
+    bool open(const std::string& filename, const OverlappedWriterOptions& writerOptions) {
+        options = writerOptions;
+        file = CreateFileA(filename.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            close();
+            return false;
+        }
+        nextOffset = static_cast<unsigned long long>(size.QuadPart);  // Append after existing data
+
+        blockSize = roundUpToPageSize(options.blockSize > 0 ? options.blockSize : 1);
+        for (int i = 0; i < BLOCK_COUNT; i++) {
+            blocks[i].data = static_cast<char*>(VirtualAlloc(NULL, blockSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+            blocks[i].overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+            if (blocks[i].data == NULL || blocks[i].overlapped.hEvent == NULL) {
+                close();
+                return false;
+            }
+        }
+        active = 0;
+        writeFailed = false;
+        return true;
+    }
+
+    void write(const char* data, size_t size) {
+        while (size > 0) {
+            Block& block = blocks[active];
+            if (block.used == 0) pendingSince = std::chrono::steady_clock::now();
+
+            size_t chunk = blockSize - block.used;
+            if (chunk > size) chunk = size;
+            memcpy(block.data + block.used, data, chunk);
+            block.used += chunk;
+            data += chunk;
+            size -= chunk;
+
+            if (block.used == blockSize) submitActive();
+        }
+
+        if (options.flushPolicy == FLUSH_EVERY_BYTES && blocks[active].used >= options.flushBytes) {
+            submitActive();
+        }
+        else {
+            flushIfDue();
+        }
+    }
+
+    // Submits the partial block when the FLUSH_EVERY_MS interval has elapsed
+    void flushIfDue() {
+        if (options.flushPolicy != FLUSH_EVERY_MS || blocks[active].used == 0) return;
+
+        auto age = std::chrono::steady_clock::now() - pendingSince;
+        if (age >= std::chrono::milliseconds(options.flushIntervalMs)) {
+            submitActive();
+        }
+    }
+
+    // Submits whatever is buffered without waiting for it to complete
+    void flush() {
+        if (file != INVALID_HANDLE_VALUE) submitActive();
+    }
+
+    void close() {
+        if (file != INVALID_HANDLE_VALUE && blocks[0].data != NULL) {
+            submitActive();
+            for (int i = 0; i < BLOCK_COUNT; i++) {
+                completeBlock(blocks[i]);
+            }
+            FlushFileBuffers(file);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+        }
+        releaseBlocks();
+    }
+
+    bool isOpen() const {
+        return file != INVALID_HANDLE_VALUE;
+    }
+
+    // Logical file size including data not yet submitted
+    unsigned long long size() const {
+        return nextOffset + blocks[active].used;
+    }
+
+    bool hasFailed() const {
+        return writeFailed;
+    }
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <windows.h>
+#include <tlhelp32.h>
+#include <vector>
+
+// How the context thread counts running processes
+enum ProcessCountProvider {
+    PROCESS_COUNT_NTQUERY,  // One NtQuerySystemInformation call into a reused buffer
+    PROCESS_COUNT_TOOLHELP, // CreateToolhelp32Snapshot walk (fallback)
+    PROCESS_COUNT_NONE      // Not counted, always 0 (session agents, CaptureService counts)
+};
+
+// Counts running processes, excluding the current one.
+// The NtQuerySystemInformation provider asks the kernel for the process list
+// in a single call and only walks the entry offsets, avoiding the snapshot
+// section and per-entry Process32Next calls of the Toolhelp provider.
+class ProcessCounter {
+private:
+    typedef LONG(NTAPI* NtQuerySystemInformationFn)(ULONG, PVOID, ULONG, PULONG);
+
+    static const ULONG SYSTEM_PROCESS_INFORMATION_CLASS = 5;
+    static const LONG STATUS_INFO_LENGTH_MISMATCH_CODE = static_cast<LONG>(0xC0000004L);
+    static const size_t BUFFER_SLACK = 64 * 1024;  // Room for processes started between calls
+
+    ProcessCountProvider provider;
+    NtQuerySystemInformationFn ntQuerySystemInformation;
+    std::vector<unsigned char> buffer;
+
+    int countWithSnapshot() {
+        HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+        if (snapshot == INVALID_HANDLE_VALUE) return 0;
+
+        PROCESSENTRY32 processEntry;
+        processEntry.dwSize = sizeof(PROCESSENTRY32);
+
+        int count = 0;
+        if (Process32First(snapshot, &processEntry)) {
+            do {
+                count++;
+            } while (Process32Next(snapshot, &processEntry));
+        }
+
+        CloseHandle(snapshot);
+        return count > 0 ? count - 1 : 0;  // Exclude current process
+    }
+
+    // Returns -1 if the query fails so the caller can fall back
+    int countWithNtQuery() {
+        for (int attempt = 0; attempt < 4; attempt++) {
+            ULONG needed = 0;
+            LONG status = ntQuerySystemInformation(SYSTEM_PROCESS_INFORMATION_CLASS,
+                buffer.data(), static_cast<ULONG>(buffer.size()), &needed);
+
+            if (status == STATUS_INFO_LENGTH_MISMATCH_CODE) {
+                buffer.resize(needed + BUFFER_SLACK);
+                continue;
+            }
+            if (status < 0) return -1;
+
+            // Entries start with ULONG NextEntryOffset; 0 marks the last one
+            int count = 0;
+            size_t offset = 0;
+            while (true) {
+                count++;
+                ULONG next = *reinterpret_cast<const ULONG*>(buffer.data() + offset);
+                if (next == 0 || offset + next >= buffer.size()) break;
+                offset += next;
+            }
+            return count > 0 ? count - 1 : 0;  // Exclude current process
+        }
+        return -1;
+    }
+
+public:
+    ProcessCounter() :
+        provider(PROCESS_COUNT_TOOLHELP),
+        ntQuerySystemInformation(NULL) {}
+
+    // Selects the provider; NtQuery falls back to Toolhelp if ntdll lacks the export
+    ProcessCountProvider init(ProcessCountProvider requested) {
+        provider = requested;
+        if (provider == PROCESS_COUNT_NTQUERY) {
+            HMODULE ntdll = GetModuleHandleW(L"ntdll.dll");
+            ntQuerySystemInformation = ntdll
+                ? reinterpret_cast<NtQuerySystemInformationFn>(GetProcAddress(ntdll, "NtQuerySystemInformation"))
+                : NULL;
+            if (ntQuerySystemInformation == NULL) {
+                provider = PROCESS_COUNT_TOOLHELP;
+            }
+            else if (buffer.empty()) {
+                buffer.resize(256 * 1024);
+            }
+        }
+        return provider;
+    }
+
+    int count() {
+        if (provider == PROCESS_COUNT_NONE) return 0;
+        if (provider == PROCESS_COUNT_NTQUERY) {
+            int result = countWithNtQuery();
+            if (result >= 0) return result;
+        }
+        return countWithSnapshot();
+    }
+
+    ProcessCountProvider getProvider() const {
+        return provider;
+    }
+};
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Receives decoded raw input on the reader thread; onRawBatchEnd() follows
+// the last record of one GetRawInputBuffer() read. Raw input carries no
+// time of its own, so the records of a batch are spread evenly over the
+// time since the previous batch, at most MAX_RECORD_SPACING_US apart and
+// ending at the QPC time the batch was retrieved.
+class RawInputSink {
+public:
+    virtual ~RawInputSink() {}
+    virtual void onRawMouse(const RAWMOUSE& mouse, long long qpcTicks) = 0;
+    virtual void onRawKeyboard(const RAWKEYBOARD& keyboard, long long qpcTicks) = 0;
+    virtual void onRawBatchEnd(long long qpcTicks) = 0;
+};
+
+// Raw Input (WM_INPUT) reader running on its own thread.
+// Mouse and keyboard are registered with RIDEV_INPUTSINK on a message-only
+// window, so input is delivered while another application has the focus.
+// The thread sleeps in MsgWaitForMultipleObjectsEx until raw input arrives,
+// then drains everything pending with GetRawInputBuffer() instead of
+// retrieving one WM_INPUT message at a time.
+class RawInputReader {
+private:
+    static const UINT INITIAL_BUFFER_BYTES = 16 * 1024;
+    static const long long MAX_RECORD_SPACING_US = 8000;  // 125 Hz, the slowest common USB polling rate
+
+    RawInputSink* sink;
+    HWND window;
+    std::thread thread;
+    std::atomic<DWORD> threadId;
+    std::atomic<int> startState;  // 0 = starting, 1 = running, -1 = failed
+    std::vector<uint64_t> buffer;  // 8-byte aligned, as GetRawInputBuffer requires
+    size_t dataOffset;    // RAWINPUTHEADER to RAWMOUSE/RAWKEYBOARD in buffered reads
+    size_t blockAlign;    // Alignment of consecutive buffered records
+    unsigned long long batchCount;
+    unsigned long long recordCount;
+    long long lastBatchTicks;    // 0 before the first batch
+    long long maxSpacingTicks;
+
+    static const char* windowClassName() {
+        return "BehavioralCaptureRawInput";
+    }
+
+    // A 32-bit process on 64-bit Windows gets 64-bit headers from
+    // GetRawInputBuffer (but not from GetRawInputData)
+    void detectBufferLayout() {
+        BOOL wow64 = FALSE;
+        if (sizeof(void*) == 4) IsWow64Process(GetCurrentProcess(), &wow64);
+        dataOffset = sizeof(RAWINPUTHEADER) + (wow64 ? 8 : 0);
+        blockAlign = (sizeof(void*) == 8 || wow64) ? 8 : sizeof(DWORD);
+    }
+
+    void dispatch(DWORD type, const BYTE* data, long long qpcTicks) {
+        if (type == RIM_TYPEMOUSE) {
+            sink->onRawMouse(*reinterpret_cast<const RAWMOUSE*>(data), qpcTicks);
+        }
+        else if (type == RIM_TYPEKEYBOARD) {
+            sink->onRawKeyboard(*reinterpret_cast<const RAWKEYBOARD*>(data), qpcTicks);
+        }
+    }
+
+    // QPC ticks between consecutive records of a batch of count retrieved at now
+    long long recordSpacing(long long now, UINT count) const {
+        if (lastBatchTicks == 0) return maxSpacingTicks;
+        const long long spacing = (now - lastBatchTicks) / count;
+        return spacing < maxSpacingTicks ? spacing : maxSpacingTicks;
+    }
+
+    // Reads until the raw input queue is empty; returns false on a hard error
+    bool drainBuffer() {
+        for (;;) {
+            UINT size = static_cast<UINT>(buffer.size() * sizeof(uint64_t));
+            PRAWINPUT first = reinterpret_cast<PRAWINPUT>(buffer.data());
+            UINT count = GetRawInputBuffer(first, &size, sizeof(RAWINPUTHEADER));
+            if (count == static_cast<UINT>(-1)) {
+                if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) return false;
+                buffer.resize(buffer.size() * 2);
+                continue;
+            }
+            if (count == 0) return true;
+
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            const long long spacing = recordSpacing(now.QuadPart, count);
+
+            const BYTE* block = reinterpret_cast<const BYTE*>(buffer.data());
+            for (UINT i = 0; i < count; i++) {
+                const RAWINPUTHEADER* header = reinterpret_cast<const RAWINPUTHEADER*>(block);
+                dispatch(header->dwType, block + dataOffset, now.QuadPart - (count - 1 - i) * spacing);
+                block += (header->dwSize + blockAlign - 1) & ~(blockAlign - 1);
+            }
+            lastBatchTicks = now.QuadPart;
+            sink->onRawBatchEnd(now.QuadPart);
+            batchCount++;
+            recordCount += count;
+        }
+    }
+
+    // WM_INPUT that was dispatched before the buffer read picked it up
+    void handleInputMessage(HRAWINPUT handle) {
+        alignas(8) BYTE data[sizeof(RAWINPUT) + 16];
+        UINT size = sizeof(data);
+        if (GetRawInputData(handle, RID_INPUT, data, &size, sizeof(RAWINPUTHEADER)) == static_cast<UINT>(-1)) {
+            return;
+        }
+
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        const RAWINPUT* input = reinterpret_cast<const RAWINPUT*>(data);
+        dispatch(input->header.dwType, data + sizeof(RAWINPUTHEADER), now.QuadPart);
+        lastBatchTicks = now.QuadPart;
+        sink->onRawBatchEnd(now.QuadPart);
+        batchCount++;
+        recordCount++;
+    }
+
+    static LRESULT CALLBACK WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+        if (message == WM_NCCREATE) {
+            CREATESTRUCTA* create = reinterpret_cast<CREATESTRUCTA*>(lParam);
+            SetWindowLongPtrA(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(create->lpCreateParams));
+        }
+        else if (message == WM_INPUT) {
+            RawInputReader* reader = reinterpret_cast<RawInputReader*>(GetWindowLongPtrA(hwnd, GWLP_USERDATA));
+            if (reader) reader->handleInputMessage(reinterpret_cast<HRAWINPUT>(lParam));
+        }
+        return DefWindowProcA(hwnd, message, wParam, lParam);
+    }
+
+    bool createWindowAndRegister() {
+        HINSTANCE module = GetModuleHandleA(NULL);
+        WNDCLASSEXA windowClass;
+        ZeroMemory(&windowClass, sizeof(windowClass));
+        windowClass.cbSize = sizeof(windowClass);
+        windowClass.lpfnWndProc = WindowProc;
+        windowClass.hInstance = module;
+        windowClass.lpszClassName = windowClassName();
+        RegisterClassExA(&windowClass);  // Fails harmlessly if already registered
+
+        window = CreateWindowExA(0, windowClassName(), "", 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, module, this);
+        if (window == NULL) return false;
+
+        RAWINPUTDEVICE devices[2];
+        devices[0].usUsagePage = 0x01;  // Generic desktop
+        devices[0].usUsage = 0x02;      // Mouse
+        devices[0].dwFlags = RIDEV_INPUTSINK;
+        devices[0].hwndTarget = window;
+        devices[1].usUsagePage = 0x01;
+        devices[1].usUsage = 0x06;      // Keyboard
+        devices[1].dwFlags = RIDEV_INPUTSINK;
+        devices[1].hwndTarget = window;
+        if (!RegisterRawInputDevices(devices, 2, sizeof(RAWINPUTDEVICE))) {
+            DestroyWindow(window);
+            window = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    void unregister() {
+        RAWINPUTDEVICE devices[2];
+        devices[0].usUsagePage = 0x01;
+        devices[0].usUsage = 0x02;
+        devices[0].dwFlags = RIDEV_REMOVE;
+        devices[0].hwndTarget = NULL;
+        devices[1].usUsagePage = 0x01;
+        devices[1].usUsage = 0x06;
+        devices[1].dwFlags = RIDEV_REMOVE;
+        devices[1].hwndTarget = NULL;
+        RegisterRawInputDevices(devices, 2, sizeof(RAWINPUTDEVICE));
+        DestroyWindow(window);
+        window = NULL;
+    }
+
+    void threadProc() {
+        threadId = GetCurrentThreadId();
+        if (!createWindowAndRegister()) {
+            startState = -1;
+            return;
+        }
+        startState = 1;
+
+        bool running = true;
+        while (running) {
+            MsgWaitForMultipleObjectsEx(0, NULL, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+            if (!drainBuffer()) break;
+
+            MSG msg;
+            while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+                if (msg.message == WM_QUIT) {
+                    running = false;
+                    break;
+                }
+                DispatchMessage(&msg);
+            }
+        }
+
+        unregister();
+    }
+
+public:
+    RawInputReader() :
+        sink(nullptr),
+        window(NULL),
+        threadId(0),
+        startState(0),
+        dataOffset(sizeof(RAWINPUTHEADER)),
+        blockAlign(sizeof(void*)),
+        batchCount(0),
+        recordCount(0),
+        lastBatchTicks(0),
+        maxSpacingTicks(0) {}
+
+    ~RawInputReader() {
+        stop();
+    }
+
+    RawInputReader(const RawInputReader&) = delete;
+    RawInputReader& operator=(const RawInputReader&) = delete;
+
+    // Starts the reader thread; returns once registration succeeded or failed
+    bool start(RawInputSink* inputSink) {
+        sink = inputSink;
+        buffer.assign(INITIAL_BUFFER_BYTES / sizeof(uint64_t), 0);
+        detectBufferLayout();
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        maxSpacingTicks = frequency.QuadPart * MAX_RECORD_SPACING_US / 1000000;
+        lastBatchTicks = 0;
+        startState = 0;
+
+        thread = std::thread(&RawInputReader::threadProc, this);
+        while (startState == 0) {
+            Sleep(1);
+        }
+        if (startState < 0) {
+            thread.join();
+            return false;
+        }
+        return true;
+    }
+
+    void stop() {
+        if (!thread.joinable()) return;
+        PostThreadMessageA(threadId, WM_QUIT, 0, 0);
+        thread.join();
+    }
+
+    bool isRunning() const {
+        return thread.joinable();
+    }
+
+    // Only meaningful once the reader thread has been stopped
+    unsigned long long getBatchCount() const { return batchCount; }
+    unsigned long long getRecordCount() const { return recordCount; }
+};
@@ -0,0 +1,559 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BehavioralEvent.h"
+#include "MonitorTable.h"
+#include "EventJournal.h"
+#include "EventSink.h"
+
+// Shared-memory rings between per-session capture agents and CaptureService.
+//
+// On a terminal server every interactive session runs one lightweight agent
+// (BehavioralCapture --agent): input capture, the ring and the drainer as
+// usual, but no event log and no process counting. Its one sink copies
+// records into a pagefile-backed ring the agent creates as
+// Local\BehavioralCaptureSessionRing; the service, in session 0, opens each
+// session's ring as Session\<id>\BehavioralCaptureSessionRing, counts
+// processes once for the machine and writes a single binary log for all
+// sessions (see CaptureService).
+//
+// Ring layout:
+//   header page  SessionRingHeader, padded to SESSION_RING_HEADER_BYTES
+//   slots        capacitySlots 32-byte slots, a power of two
+//
+// Slots use the journal's encoding: BehavioralEvent as stored in memory,
+// app names in-band before the first event of an app (JOURNAL_SLOT_APP_NAME,
+// appId = ID, x = length, then the name bytes) and the monitor table before
+// the first event recorded with it (JOURNAL_SLOT_MONITOR_TABLE). Every
+// agent starts with a SESSION_SLOT_RESET slot, after which the reader
+// forgets the names and table of an earlier agent in the same ring; the
+// agent starts over the same way when a restarted service opens the ring
+// (readerEpoch), which skips the records it could no longer name.
+//
+// One producer (the agent's sink lane), one consumer (the service). An
+// event and the name and table slots it needs are published together with
+// a release store of writePos, or dropped and counted when the ring lacks
+// room, so the agent never waits for the service. The service frees slots
+// with a release store of readPos.
+//
+// Next to the ring the agent creates an auto-reset event,
+// Local\BehavioralCaptureSessionRingData, and sets it when it publishes into
+// a ring the service had emptied, so an idle service sleeps on the events
+// of all sessions instead of polling. Both sides fence between their own
+// position store and their load of the other's, so either the agent sees
+// the ring was empty and signals, or the service's next drain sees the
+// record.
+
+const char SESSION_RING_MAGIC[8] = { 'B', 'C', 'R', 'I', 'N', 'G', '\0', '\0' };
+const uint32_t SESSION_RING_VERSION = 1;
+const size_t SESSION_RING_HEADER_BYTES = 4096;
+const char* const SESSION_RING_NAME = "BehavioralCaptureSessionRing";
+const char* const SESSION_RING_EVENT_NAME = "BehavioralCaptureSessionRingData";
+const uint8_t SESSION_SLOT_RESET = 0xFD;
+
+struct SessionRingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotBytes;                      // JOURNAL_SLOT_BYTES
+    uint64_t capacitySlots;                  // Power of two
+    std::atomic<uint32_t> agentPid;          // Process writing the ring, 0 after it closed it
+    alignas(64) std::atomic<uint64_t> writePos;        // Agent: slots published
+    std::atomic<uint64_t> droppedRecords;              // Agent: events that did not fit
+    alignas(64) std::atomic<uint64_t> readPos;         // Service: slots consumed
+    std::atomic<uint32_t> readerEpoch;                 // Service: bumped on every open
+};
+
+static_assert(sizeof(SessionRingHeader) <= SESSION_RING_HEADER_BYTES, "Session ring header must fit its page");
+
+struct SessionRingOptions {
+    bool enabled = false;           // Agent mode: records go to CaptureService instead of a local log
+    size_t capacitySlots = 65536;   // 2 MB of slots, rounded up to a power of two
+};
+
+// Agent side: a pipeline sink that publishes records into the session's ring
+class SessionRingWriter : public EventSink {
+private:
+    HANDLE mapping;
+    HANDLE dataEvent;               // Set when the service may be waiting for data
+    uint8_t* view;
+    SessionRingHeader* header;
+    uint64_t capacity;
+    const MonitorTableSource* monitors;
+    uint32_t monitorsWritten;       // Generation of the last table published, 0 = none since open()
+    std::vector<bool> appWritten;   // App IDs already named in the ring
+    bool resetPending;
+    uint32_t readerEpoch;           // Of the reader the names and table went to
+    std::vector<uint8_t> message;   // Slots of the record being published
+    std::atomic<unsigned long long> bytesWritten;
+    std::atomic<unsigned long long> droppedRecords;
+    std::string name;
+    std::string error;
+
+    bool fail(const std::string& text) {
+        error = text;
+        return false;
+    }
+
+    uint8_t* slot(uint64_t index) {
+        return view + SESSION_RING_HEADER_BYTES + (index & (capacity - 1)) * JOURNAL_SLOT_BYTES;
+    }
+
+    static bool isProcessRunning(DWORD pid) {
+        HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+        if (process == NULL) return false;
+        DWORD exitCode = 0;
+        const bool running = GetExitCodeProcess(process, &exitCode) && exitCode == STILL_ACTIVE;
+        CloseHandle(process);
+        return running;
+    }
+
+    void appendSlot(const BehavioralEvent& entry) {
+        const size_t at = message.size();
+        message.resize(at + JOURNAL_SLOT_BYTES);
+        memcpy(&message[at], &entry, JOURNAL_SLOT_BYTES);
+    }
+
+    void appendAppName(uint16_t id, const std::string& appName) {
+        const size_t length = appName.size() < JOURNAL_MAX_APP_NAME ? appName.size() : JOURNAL_MAX_APP_NAME;
+        BehavioralEvent entry = {};
+        entry.type = JOURNAL_SLOT_APP_NAME;
+        entry.appId = id;
+        entry.x = static_cast<int32_t>(length);
+        appendSlot(entry);
+
+        const size_t at = message.size();
+        message.resize(at + (length + JOURNAL_SLOT_BYTES - 1) / JOURNAL_SLOT_BYTES * JOURNAL_SLOT_BYTES, 0);
+        memcpy(&message[at], appName.data(), length);
+    }
+
+    void appendMonitorTable(const MonitorTable& table) {
+        BehavioralEvent entry = {};
+        entry.type = JOURNAL_SLOT_MONITOR_TABLE;
+        entry.x = static_cast<int32_t>(table.monitors.size());
+        entry.y = static_cast<int32_t>(table.generation);
+        appendSlot(entry);
+        for (const MonitorInfo& monitor : table.monitors) {
+            const size_t at = message.size();
+            message.resize(at + JOURNAL_SLOT_BYTES, 0);
+            memcpy(&message[at], &monitor, sizeof(MonitorInfo));
+        }
+    }
+
+    bool appNamed(uint16_t id) const {
+        return id < appWritten.size() && appWritten[id];
+    }
+
+public:
+    SessionRingWriter() :
+        mapping(NULL),
+        dataEvent(NULL),
+        view(nullptr),
+        header(nullptr),
+        capacity(0),
+        monitors(nullptr),
+        monitorsWritten(0),
+        resetPending(false),
+        readerEpoch(0),
+        bytesWritten(0),
+        droppedRecords(0) {}
+
+    ~SessionRingWriter() {
+        close();
+    }
+
+    SessionRingWriter(const SessionRingWriter&) = delete;
+    SessionRingWriter& operator=(const SessionRingWriter&) = delete;
+
+    // Optional: monitor geometry the service records next to the events
+    void setMonitorSource(const MonitorTableSource* source) {
+        monitors = source;
+    }
+
+    // Creates the session's ring, or continues in the one the service kept
+    // open for an earlier agent (keeping that ring's capacity). Fails while
+    // another agent is writing it.
+    bool open(const SessionRingOptions& options) {
+        close();
+        uint64_t slots = 1;
+        while (slots < options.capacitySlots) slots <<= 1;
+        const uint64_t size = SESSION_RING_HEADER_BYTES + slots * JOURNAL_SLOT_BYTES;
+
+        name = std::string("Local\\") + SESSION_RING_NAME;
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+            static_cast<DWORD>(size >> 32), static_cast<DWORD>(size & 0xFFFFFFFF), name.c_str());
+        if (mapping == NULL) return fail("Cannot create " + name);
+        const bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+
+        view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+        if (view == nullptr) {
+            close();
+            return fail("Cannot map " + name);
+        }
+
+        SessionRingHeader* existing = reinterpret_cast<SessionRingHeader*>(view);
+        if (existed && memcmp(existing->magic, SESSION_RING_MAGIC, sizeof(SESSION_RING_MAGIC)) == 0 &&
+            existing->version == SESSION_RING_VERSION) {
+            const DWORD previous = existing->agentPid.load(std::memory_order_acquire);
+            if (previous != 0 && previous != GetCurrentProcessId() && isProcessRunning(previous)) {
+                close();
+                return fail("Another capture agent (pid " + std::to_string(previous) + ") is writing " + name);
+            }
+            header = existing;
+        }
+        else {
+            memset(view, 0, SESSION_RING_HEADER_BYTES);
+            header = new (view) SessionRingHeader();
+            memcpy(header->magic, SESSION_RING_MAGIC, sizeof(SESSION_RING_MAGIC));
+            header->version = SESSION_RING_VERSION;
+            header->slotBytes = static_cast<uint32_t>(JOURNAL_SLOT_BYTES);
+            header->capacitySlots = slots;
+            header->writePos.store(0, std::memory_order_relaxed);
+            header->droppedRecords.store(0, std::memory_order_relaxed);
+            header->readPos.store(0, std::memory_order_relaxed);
+            header->readerEpoch.store(0, std::memory_order_relaxed);
+        }
+        capacity = header->capacitySlots;
+        header->agentPid.store(GetCurrentProcessId(), std::memory_order_release);
+
+        // Without it the service falls back to polling this ring
+        dataEvent = CreateEventA(NULL, FALSE, FALSE, (std::string("Local\\") + SESSION_RING_EVENT_NAME).c_str());
+
+        monitorsWritten = 0;
+        appWritten.clear();
+        resetPending = true;
+        readerEpoch = header->readerEpoch.load(std::memory_order_acquire);
+        bytesWritten = 0;
+        droppedRecords = 0;
+        error.clear();
+        return true;
+    }
+
+    void write(const BehavioralEvent& event, const std::string& appName) override {
+        if (!header) return;
+        const uint32_t epoch = header->readerEpoch.load(std::memory_order_acquire);
+        if (epoch != readerEpoch) {
+            readerEpoch = epoch;
+            monitorsWritten = 0;
+            appWritten.clear();
+            resetPending = true;
+        }
+        message.clear();
+        if (resetPending) {
+            BehavioralEvent reset = {};
+            reset.type = SESSION_SLOT_RESET;
+            appendSlot(reset);
+        }
+        const MonitorTable* table = monitors ? monitors->getTable() : nullptr;
+        const bool newTable = table && table->generation != monitorsWritten;
+        if (newTable) appendMonitorTable(*table);
+        const bool newApp = !appNamed(event.appId);
+        if (newApp) appendAppName(event.appId, appName);
+        appendSlot(event);
+
+        const uint64_t slots = message.size() / JOURNAL_SLOT_BYTES;
+        const uint64_t writePos = header->writePos.load(std::memory_order_relaxed);
+        const uint64_t used = writePos - header->readPos.load(std::memory_order_acquire);
+        if (used > capacity || capacity - used < slots) {
+            // The table and name go out again with the next record that fits
+            header->droppedRecords.store(header->droppedRecords.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+            droppedRecords.store(droppedRecords.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        for (uint64_t i = 0; i < slots; i++) {
+            memcpy(slot(writePos + i), &message[static_cast<size_t>(i) * JOURNAL_SLOT_BYTES], JOURNAL_SLOT_BYTES);
+        }
+        header->writePos.store(writePos + slots, std::memory_order_release);
+        // The service stopped at writePos if it consumed everything before this record
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (dataEvent && header->readPos.load(std::memory_order_relaxed) == writePos) SetEvent(dataEvent);
+
+        resetPending = false;
+        if (newTable) monitorsWritten = table->generation;
+        if (newApp) {
+            if (event.appId >= appWritten.size()) appWritten.resize(event.appId + 1, false);
+            appWritten[event.appId] = true;
+        }
+        bytesWritten.store(bytesWritten.load(std::memory_order_relaxed) + message.size(), std::memory_order_relaxed);
+    }
+
+    // Records are visible to the service as soon as write() returns
+    void flushIfDue() override {}
+
+    void flushAll() override {}
+
+    // The mapping lives on while the service has it open
+    void close() override {
+        if (header) {
+            header->agentPid.store(0, std::memory_order_release);
+            header = nullptr;
+        }
+        if (view) {
+            UnmapViewOfFile(view);
+            view = nullptr;
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+            mapping = NULL;
+        }
+        if (dataEvent) {
+            CloseHandle(dataEvent);
+            dataEvent = NULL;
+        }
+        capacity = 0;
+    }
+
+    bool isOpen() const {
+        return header != nullptr;
+    }
+
+    // Bytes published into the ring since open()
+    unsigned long long getBytesWritten() const override {
+        return bytesWritten.load(std::memory_order_relaxed);
+    }
+
+    // Since open(); kept after close()
+    unsigned long long getDroppedRecords() const {
+        return droppedRecords.load(std::memory_order_relaxed);
+    }
+
+    uint64_t getCapacity() const {
+        return capacity;
+    }
+
+    const std::string& getName() const {
+        return name;
+    }
+
+    const std::string& getError() const {
+        return error;
+    }
+};
+
+// Service side: drains one session's ring. Also the MonitorTableSource of
+// that session's events for the writer.
+class SessionRingReader : public MonitorTableSource {
+private:
+    HANDLE mapping;
+    HANDLE dataEvent;
+    uint8_t* view;
+    SessionRingHeader* header;
+    uint64_t capacity;
+    std::unordered_map<uint16_t, std::string> appNames;
+    MonitorTable monitorTable;
+    bool hasMonitorTable;
+    unsigned long long resets;
+    std::string error;
+    const std::string unknownApp = "Unknown";
+
+    bool fail(const std::string& text) {
+        error = text;
+        return false;
+    }
+
+    const uint8_t* slot(uint64_t index) const {
+        return view + SESSION_RING_HEADER_BYTES + (index & (capacity - 1)) * JOURNAL_SLOT_BYTES;
+    }
+
+    // Continuation slots may wrap around the end of the ring
+    void copySlots(uint64_t first, void* target, size_t length) const {
+        uint8_t* out = static_cast<uint8_t*>(target);
+        for (size_t done = 0; done < length; first++) {
+            const size_t chunk = length - done < JOURNAL_SLOT_BYTES ? length - done : JOURNAL_SLOT_BYTES;
+            memcpy(out + done, slot(first), chunk);
+            done += chunk;
+        }
+    }
+
+public:
+    SessionRingReader() :
+        mapping(NULL),
+        dataEvent(NULL),
+        view(nullptr),
+        header(nullptr),
+        capacity(0),
+        hasMonitorTable(false),
+        resets(0) {}
+
+    ~SessionRingReader() {
+        close();
+    }
+
+    SessionRingReader(const SessionRingReader&) = delete;
+    SessionRingReader& operator=(const SessionRingReader&) = delete;
+
+    // False while no agent in the session has created its ring. The agent
+    // is not trusted: the header is checked against the mapping's size.
+    // A ring an earlier service already read from is skipped to its newest
+    // record, as the names of the backlog went to that service.
+    bool open(uint32_t sessionId) {
+        close();
+        const std::string name = "Session\\" + std::to_string(sessionId) + "\\" + SESSION_RING_NAME;
+        mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+        if (mapping == NULL) return fail("No agent ring in session " + std::to_string(sessionId));
+
+        view = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+        MEMORY_BASIC_INFORMATION region;
+        if (view == nullptr || VirtualQuery(view, &region, sizeof(region)) == 0 ||
+            region.RegionSize < SESSION_RING_HEADER_BYTES) {
+            close();
+            return fail("Cannot map " + name);
+        }
+        SessionRingHeader* candidate = reinterpret_cast<SessionRingHeader*>(view);
+        const uint64_t slots = candidate->capacitySlots;
+        if (memcmp(candidate->magic, SESSION_RING_MAGIC, sizeof(SESSION_RING_MAGIC)) != 0 ||
+            candidate->version != SESSION_RING_VERSION || candidate->slotBytes != JOURNAL_SLOT_BYTES ||
+            slots == 0 || (slots & (slots - 1)) != 0 ||
+            slots > (region.RegionSize - SESSION_RING_HEADER_BYTES) / JOURNAL_SLOT_BYTES) {
+            close();
+            return fail("Not a session ring: " + name);
+        }
+        header = candidate;
+        capacity = slots;
+        if (header->readPos.load(std::memory_order_relaxed) != 0) {
+            header->readPos.store(header->writePos.load(std::memory_order_acquire), std::memory_order_release);
+        }
+        header->readerEpoch.store(header->readerEpoch.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        dataEvent = OpenEventA(SYNCHRONIZE, FALSE,
+            ("Session\\" + std::to_string(sessionId) + "\\" + SESSION_RING_EVENT_NAME).c_str());
+        return true;
+    }
+
+    // Decodes up to maxRecords published events, calls emit(event, appName)
+    // for each and frees their slots; returns the number of events. The
+    // agent's app IDs and monitor table (getTable()) are those of its ring.
+    template <typename Emit>
+    size_t drain(size_t maxRecords, Emit emit) {
+        if (!header) return 0;
+        uint64_t pos = header->readPos.load(std::memory_order_relaxed);
+        const uint64_t end = header->writePos.load(std::memory_order_acquire);
+        if (end - pos > capacity) {
+            fail("Session ring positions out of range, skipped to the newest record");
+            header->readPos.store(end, std::memory_order_release);
+            return 0;
+        }
+
+        size_t count = 0;
+        while (pos < end && count < maxRecords) {
+            BehavioralEvent entry;
+            memcpy(&entry, slot(pos), JOURNAL_SLOT_BYTES);
+            if (entry.type == JOURNAL_SLOT_APP_NAME) {
+                const size_t length = static_cast<uint32_t>(entry.x);
+                const uint64_t slots = (length + JOURNAL_SLOT_BYTES - 1) / JOURNAL_SLOT_BYTES;
+                if (length > JOURNAL_MAX_APP_NAME || end - pos < 1 + slots) {
+                    fail("Corrupt app name in session ring");
+                    pos = end;
+                    break;
+                }
+                std::string appName(length, '\0');
+                if (length > 0) copySlots(pos + 1, &appName[0], length);
+                appNames[entry.appId] = appName;
+                pos += 1 + slots;
+                continue;
+            }
+            if (entry.type == JOURNAL_SLOT_MONITOR_TABLE) {
+                const uint64_t monitorCount = static_cast<uint32_t>(entry.x);
+                if (monitorCount > MAX_MONITORS || end - pos < 1 + monitorCount) {
+                    fail("Corrupt monitor table in session ring");
+                    pos = end;
+                    break;
+                }
+                monitorTable.generation = static_cast<uint32_t>(entry.y);
+                monitorTable.monitors.resize(static_cast<size_t>(monitorCount));
+                for (uint64_t i = 0; i < monitorCount; i++) {
+                    memcpy(&monitorTable.monitors[static_cast<size_t>(i)], slot(pos + 1 + i), sizeof(MonitorInfo));
+                }
+                hasMonitorTable = true;
+                pos += 1 + monitorCount;
+                continue;
+            }
+            pos++;
+            if (entry.type == SESSION_SLOT_RESET) {
+                appNames.clear();
+                hasMonitorTable = false;
+                resets++;
+                continue;
+            }
+            emit(entry, appName(entry.appId));
+            count++;
+        }
+        header->readPos.store(pos, std::memory_order_release);
+        // Ordered before the next drain's load of writePos, see the data event
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return count;
+    }
+
+    void close() {
+        header = nullptr;
+        if (view) {
+            UnmapViewOfFile(view);
+            view = nullptr;
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+            mapping = NULL;
+        }
+        if (dataEvent) {
+            CloseHandle(dataEvent);
+            dataEvent = NULL;
+        }
+        capacity = 0;
+        appNames.clear();
+        hasMonitorTable = false;
+    }
+
+    bool isOpen() const {
+        return header != nullptr;
+    }
+
+    const std::string& appName(uint16_t id) const {
+        auto it = appNames.find(id);
+        return it != appNames.end() ? it->second : unknownApp;
+    }
+
+    // The table of the events drained last, null before the agent sent one
+    const MonitorTable* getTable() const override {
+        return hasMonitorTable ? &monitorTable : nullptr;
+    }
+
+    // Signaled when the agent publishes into the emptied ring; NULL when the
+    // agent did not create one, and the ring has to be polled
+    HANDLE getDataEvent() const {
+        return dataEvent;
+    }
+
+    // 0 while no agent is attached
+    DWORD getAgentPid() const {
+        return header ? header->agentPid.load(std::memory_order_acquire) : 0;
+    }
+
+    // Agent starts seen in the ring; app IDs are only stable between two
+    unsigned long long getResets() const {
+        return resets;
+    }
+
+    // Counted by the ring's agents since it was created
+    unsigned long long getDroppedRecords() const {
+        return header ? header->droppedRecords.load(std::memory_order_relaxed) : 0;
+    }
+
+    uint64_t getPendingSlots() const {
+        return header ? header->writePos.load(std::memory_order_acquire) - header->readPos.load(std::memory_order_relaxed) : 0;
+    }
+
+    uint64_t getCapacity() const {
+        return capacity;
+    }
+
+    const std::string& getError() const {
+        return error;
+    }
+};
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BehavioralEvent.h"
+#include "AppInternTable.h"
+#include "CaptureTelemetry.h"
+#include "EventSink.h"
+
+// Fan-out from the consumer thread to every registered EventSink.
+//
+// Events are collected into batches of batchEvents (or whatever arrived
+// within batchIntervalMs). A sealed batch is immutable and shared: each
+// sink's lane queues a reference to it, so one copy serves every sink and
+// is freed when the last lane is done. Each lane has its own worker thread
+// and a bounded queue; when a sink falls behind, its queue fills and new
+// batches are dropped for that sink only, so a slow disk or a stalled
+// network never holds up the other sinks, the consumer or the hooks.
+//
+// With enabled = false every sink is written inline on the consumer thread
+// and nothing is ever dropped (the behavior before the pipeline), except
+// for sinks added with ownLane, which keep their worker thread regardless;
+// their queue is lossless then, publishing waits for room instead of
+// dropping the batch.
+//
+// While the capture is idle (suspend()), a lane writes out everything its
+// sink buffers once and then sleeps until the next batch instead of
+// waking every IDLE_FLUSH_CHECK_MS.
+
+struct PipelineOptions {
+    bool enabled = true;
+    size_t batchEvents = 256;
+    int batchIntervalMs = 100;   // A partial batch is published after this long
+    size_t queueBatches = 256;   // Per sink
+};
+
+struct SinkBatch {
+    std::vector<BehavioralEvent> events;
+    long long sealedTicks;  // QPC, for the lag measurement
+};
+
+// Counters of one sink, see SinkPipeline::getLaneStats()
+struct SinkLaneStats {
+    std::string name;
+    unsigned long long writtenEvents = 0;
+    unsigned long long droppedBatches = 0;  // Queue full
+    unsigned long long droppedEvents = 0;
+    size_t queueDepth = 0;                  // Batches waiting now
+    size_t queueHighWater = 0;
+    uint64_t maxLagNs = 0;                  // Longest time from sealing a batch to its last write
+};
+
+class SinkPipeline {
+private:
+    struct Lane {
+        EventSink* sink;
+        std::string name;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable space;  // Lossless lanes: a batch left the queue
+        std::deque<std::shared_ptr<const SinkBatch>> queue;
+        size_t queueHighWater;
+        bool running;
+        bool suspended;     // Capture idle: no timed flush checks
+        bool idleFlushed;   // flushAll() done for the current idle period
+        bool lossless;      // ownLane on a disabled pipeline: publish() waits, never drops
+        std::thread thread;
+
+        std::atomic<unsigned long long> writtenEvents;
+        std::atomic<unsigned long long> droppedBatches;
+        std::atomic<unsigned long long> droppedEvents;
+        std::atomic<uint64_t> maxLagNs;
+
+        Lane(EventSink* laneSink, const std::string& laneName) :
+            sink(laneSink),
+            name(laneName),
+            queueHighWater(0),
+            running(true),
+            suspended(false),
+            idleFlushed(false),
+            lossless(false),
+            writtenEvents(0),
+            droppedBatches(0),
+            droppedEvents(0),
+            maxLagNs(0) {}
+    };
+
+    PipelineOptions options;
+    const AppInternTable* appNames;
+    std::vector<std::unique_ptr<Lane>> lanes;
+    size_t threadedLanes;
+    std::vector<BehavioralEvent> current;  // Consumer thread
+    std::chrono::steady_clock::time_point currentStarted;
+    QpcClock clock;
+    const int IDLE_FLUSH_CHECK_MS = 50;  // How often an idle lane lets its sink flush
+
+    static void bump(std::atomic<unsigned long long>& counter, unsigned long long amount = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    void laneThreadProc(Lane& lane) {
+        std::unique_lock<std::mutex> lock(lane.mutex);
+        for (;;) {
+            if (lane.queue.empty()) {
+                if (!lane.running) break;
+                if (lane.suspended) {
+                    if (!lane.idleFlushed) {
+                        lane.idleFlushed = true;
+                        lock.unlock();
+                        lane.sink->flushAll();
+                        lock.lock();
+                        continue;
+                    }
+                    lane.wake.wait(lock);
+                    continue;
+                }
+                lane.wake.wait_for(lock, std::chrono::milliseconds(IDLE_FLUSH_CHECK_MS));
+                if (lane.queue.empty()) {
+                    lock.unlock();
+                    lane.sink->flushIfDue();
+                    lock.lock();
+                    continue;
+                }
+            }
+
+            std::shared_ptr<const SinkBatch> batch = std::move(lane.queue.front());
+            lane.queue.pop_front();
+            lock.unlock();
+            if (lane.lossless) lane.space.notify_one();
+
+            for (const BehavioralEvent& event : batch->events) {
+                lane.sink->write(event, appNames->name(event.appId));
+            }
+            bump(lane.writtenEvents, batch->events.size());
+            const uint64_t lag = clock.toNs(QpcClock::now() - batch->sealedTicks);
+            if (lag > lane.maxLagNs.load(std::memory_order_relaxed)) lane.maxLagNs.store(lag, std::memory_order_relaxed);
+            batch.reset();  // Drop this lane's reference before waiting again
+
+            lock.lock();
+        }
+    }
+
+    void publish() {
+        if (current.empty()) return;
+        std::shared_ptr<SinkBatch> sealed = std::make_shared<SinkBatch>();
+        sealed->events.swap(current);
+        sealed->sealedTicks = QpcClock::now();
+        const std::shared_ptr<const SinkBatch> batch = std::move(sealed);
+        current.reserve(options.batchEvents);
+
+        for (auto& lane : lanes) {
+            if (!lane->thread.joinable()) continue;
+            bool queued = false;
+            {
+                std::unique_lock<std::mutex> lock(lane->mutex);
+                if (lane->lossless) {
+                    lane->space.wait(lock, [&] { return lane->queue.size() < options.queueBatches || !lane->running; });
+                }
+                if (lane->queue.size() < options.queueBatches) {
+                    lane->queue.push_back(batch);
+                    if (lane->queue.size() > lane->queueHighWater) lane->queueHighWater = lane->queue.size();
+                    queued = true;
+                }
+            }
+            if (queued) {
+                lane->wake.notify_one();
+            }
+            else {
+                bump(lane->droppedBatches);
+                bump(lane->droppedEvents, batch->events.size());
+            }
+        }
+    }
+
+    void setSuspended(bool suspended) {
+        for (auto& lane : lanes) {
+            if (!lane->thread.joinable()) continue;
+            {
+                std::lock_guard<std::mutex> lock(lane->mutex);
+                lane->suspended = suspended;
+                lane->idleFlushed = false;
+            }
+            lane->wake.notify_one();
+        }
+    }
+
+public:
+    SinkPipeline() : appNames(nullptr), threadedLanes(0) {}
+
+    ~SinkPipeline() {
+        stop();
+    }
+
+    SinkPipeline(const SinkPipeline&) = delete;
+    SinkPipeline& operator=(const SinkPipeline&) = delete;
+
+    // Forgets the sinks of a previous run; names resolve app IDs for the sinks
+    void start(const PipelineOptions& pipelineOptions, const AppInternTable& names) {
+        stop();
+        lanes.clear();
+        threadedLanes = 0;
+        options = pipelineOptions;
+        if (options.batchEvents == 0) options.batchEvents = 1;
+        if (options.queueBatches == 0) options.queueBatches = 1;
+        appNames = &names;
+        current.clear();
+        current.reserve(options.batchEvents);
+    }
+
+    // The sink must stay open until stop() returns. ownLane gives it a
+    // worker thread even with the pipeline disabled, for sinks whose
+    // occasional slow write must not run on the consumer thread.
+    void addSink(EventSink* sink, const std::string& name, bool ownLane = false) {
+        lanes.emplace_back(new Lane(sink, name));
+        Lane& lane = *lanes.back();
+        if (options.enabled || ownLane) {
+            lane.lossless = !options.enabled;
+            lane.thread = std::thread(&SinkPipeline::laneThreadProc, this, std::ref(lane));
+            threadedLanes++;
+        }
+    }
+
+    bool hasSinks() const {
+        return !lanes.empty();
+    }
+
+    // Consumer thread only
+    void push(const BehavioralEvent& event) {
+        if (threadedLanes < lanes.size()) {
+            const std::string& appName = appNames->name(event.appId);
+            for (auto& lane : lanes) {
+                if (lane->thread.joinable()) continue;
+                lane->sink->write(event, appName);
+                bump(lane->writtenEvents);
+            }
+        }
+        if (threadedLanes == 0) return;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (current.empty()) currentStarted = now;
+        current.push_back(event);
+        // A steady stream publishes here; after its last record flushIfDue()
+        // does (the drainer, or the context thread in sync mode)
+        if (current.size() >= options.batchEvents ||
+            now - currentStarted >= std::chrono::milliseconds(options.batchIntervalMs)) {
+            publish();
+        }
+    }
+
+    // Consumer thread (or the context thread in sync mode, under the lock the
+    // consumer holds), while idle: publishes a partial batch that has waited
+    // long enough
+    void flushIfDue() {
+        for (auto& lane : lanes) {
+            if (!lane->thread.joinable()) lane->sink->flushIfDue();
+        }
+        if (!current.empty() &&
+            std::chrono::steady_clock::now() - currentStarted >= std::chrono::milliseconds(options.batchIntervalMs)) {
+            publish();
+        }
+    }
+
+    // Consumer thread, when the capture goes idle: publishes the partial
+    // batch and lets every sink write out what it buffers, after which the
+    // lanes stop waking up until resume() or the next batch
+    void suspend() {
+        for (auto& lane : lanes) {
+            if (!lane->thread.joinable()) lane->sink->flushAll();
+        }
+        publish();
+        setSuspended(true);
+    }
+
+    // Consumer thread, on the first input after an idle period
+    void resume() {
+        setSuspended(false);
+    }
+
+    // Publishes what is left and waits until every lane has written its
+    // queue; the sinks themselves are closed by their owner afterwards
+    void stop() {
+        publish();
+        for (auto& lane : lanes) {
+            if (!lane->thread.joinable()) continue;
+            {
+                std::lock_guard<std::mutex> lock(lane->mutex);
+                lane->running = false;
+            }
+            lane->wake.notify_one();
+            lane->thread.join();
+        }
+    }
+
+    bool isThreaded() const {
+        return options.enabled;
+    }
+
+    std::vector<SinkLaneStats> getLaneStats() {
+        std::vector<SinkLaneStats> result;
+        for (auto& lane : lanes) {
+            SinkLaneStats stats;
+            stats.name = lane->name;
+            stats.writtenEvents = lane->writtenEvents.load(std::memory_order_relaxed);
+            stats.droppedBatches = lane->droppedBatches.load(std::memory_order_relaxed);
+            stats.droppedEvents = lane->droppedEvents.load(std::memory_order_relaxed);
+            stats.maxLagNs = lane->maxLagNs.load(std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(lane->mutex);
+                stats.queueDepth = lane->queue.size();
+                stats.queueHighWater = lane->queueHighWater;
+            }
+            result.push_back(stats);
+        }
+        return result;
+    }
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+// Lock-free single-producer/single-consumer ring buffer.
+// The producer (hook thread) only ever advances head and the consumer
+// (drainer thread) only ever advances tail, so neither side takes a lock
+// or waits on the other. A full ring drops the new record instead of
+// blocking the producer.
+template <typename T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable<T>::value, "Ring records must be trivially copyable");
+
+private:
+    static const size_t CACHE_LINE = 64;
+
+    // Producer and consumer indices live on separate cache lines to avoid false sharing
+    alignas(CACHE_LINE) std::atomic<size_t> head;  // Next slot to write (producer)
+    alignas(CACHE_LINE) std::atomic<size_t> tail;  // Next slot to read (consumer)
+
+    // Counters written by the producer only, readable from any thread
+    alignas(CACHE_LINE) std::atomic<size_t> highWater;
+    std::atomic<unsigned long long> dropped;
+
+    alignas(CACHE_LINE) std::unique_ptr<T[]> slots;
+    size_t capacity;
+    size_t mask;
+
+    static size_t roundUpToPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+public:
+    explicit SpscRing(size_t requestedCapacity) :
+        head(0),
+        tail(0),
+        highWater(0),
+        dropped(0),
+        capacity(roundUpToPowerOfTwo(requestedCapacity)) {
+        mask = capacity - 1;
+        slots.reset(new T[capacity]);  // Preallocated up front, never resized
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer side: copy one record in, or count it as dropped if the ring is full
+    bool tryPush(const T& item) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t t = tail.load(std::memory_order_acquire);
+        if (h - t >= capacity) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        slots[h & mask] = item;
+        head.store(h + 1, std::memory_order_release);
+
+        const size_t depth = h + 1 - t;
+        if (depth > highWater.load(std::memory_order_relaxed)) {
+            highWater.store(depth, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Consumer side: move up to maxCount records into out, returns the number copied
+    size_t popBatch(T* out, size_t maxCount) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        const size_t h = head.load(std::memory_order_acquire);
+        size_t count = h - t;
+        if (count > maxCount) count = maxCount;
+
+        for (size_t i = 0; i < count; i++) {
+            out[i] = slots[(t + i) & mask];
+        }
+        tail.store(t + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t size() const {
+        const size_t t = tail.load(std::memory_order_acquire);
+        return head.load(std::memory_order_acquire) - t;
+    }
+
+    size_t getCapacity() const { return capacity; }
+    size_t getHighWaterMark() const { return highWater.load(std::memory_order_relaxed); }
+    unsigned long long getDroppedCount() const { return dropped.load(std::memory_order_relaxed); }
+};
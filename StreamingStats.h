@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+// Welford running mean/variance with min/max; O(1) per sample, numerically
+// stable for long windows
+class RunningStats {
+private:
+    uint64_t count;
+    double mean;
+    double m2;
+    double minValue;
+    double maxValue;
+
+public:
+    RunningStats() {
+        reset();
+    }
+
+    void reset() {
+        count = 0;
+        mean = 0.0;
+        m2 = 0.0;
+        minValue = std::numeric_limits<double>::infinity();
+        maxValue = -std::numeric_limits<double>::infinity();
+    }
+
+    void add(double value) {
+        count++;
+        const double delta = value - mean;
+        mean += delta / static_cast<double>(count);
+        m2 += delta * (value - mean);
+        if (value < minValue) minValue = value;
+        if (value > maxValue) maxValue = value;
+    }
+
+    uint64_t getCount() const { return count; }
+    double getMean() const { return count > 0 ? mean : 0.0; }
+    double getVariance() const { return count > 1 ? m2 / static_cast<double>(count - 1) : 0.0; }
+    double getStdDev() const { return std::sqrt(getVariance()); }
+    double getMin() const { return count > 0 ? minValue : 0.0; }
+    double getMax() const { return count > 0 ? maxValue : 0.0; }
+};
+
+// Fixed-memory quantile sketch with relative error guarantees (the DDSketch
+// bucketing): a value v > 0 goes to bucket ceil(log(v) / log(gamma)), so
+// any quantile is within RELATIVE_ACCURACY of the true value. Negative
+// values go to a mirrored set of buckets by magnitude (key flight times
+// are negative when keys overlap). Values within MIN_VALUE of 0 are counted
+// separately, values beyond the top bucket are clamped into it.
+class QuantileSketch {
+public:
+    static const int BUCKET_COUNT = 512;
+    static constexpr double RELATIVE_ACCURACY = 0.02;
+    static constexpr double MIN_VALUE = 0.01;  // Up to ~8e6 with 512 buckets
+
+private:
+    // Buckets of one sign, indexed by magnitude
+    struct Side {
+        uint32_t buckets[BUCKET_COUNT];
+        uint64_t count;
+        int lowest;   // Range of used buckets, so reset() and queries stay cheap
+        int highest;
+
+        void reset() {
+            if (highest >= lowest) {
+                memset(buckets + lowest, 0, sizeof(uint32_t) * (highest - lowest + 1));
+            }
+            count = 0;
+            lowest = BUCKET_COUNT;
+            highest = -1;
+        }
+
+        void add(int bucket) {
+            buckets[bucket]++;
+            count++;
+            if (bucket < lowest) lowest = bucket;
+            if (bucket > highest) highest = bucket;
+        }
+    };
+
+    Side positive;
+    Side negative;
+    uint64_t zeroCount;  // Samples within MIN_VALUE of 0 (and NaN)
+    uint64_t count;
+
+    static double gamma() {
+        return (1.0 + RELATIVE_ACCURACY) / (1.0 - RELATIVE_ACCURACY);
+    }
+
+    static double logGamma() {
+        static const double value = std::log(gamma());
+        return value;
+    }
+
+    static int indexOffset() {
+        static const int value = static_cast<int>(std::ceil(std::log(MIN_VALUE) / logGamma()));
+        return value;
+    }
+
+    static int bucketOf(double magnitude) {
+        int bucket = static_cast<int>(std::ceil(std::log(magnitude) / logGamma())) - indexOffset();
+        if (bucket < 0) bucket = 0;
+        if (bucket >= BUCKET_COUNT) bucket = BUCKET_COUNT - 1;
+        return bucket;
+    }
+
+    // Representative magnitude of a bucket, the midpoint in relative terms
+    static double bucketValue(int bucket) {
+        const int index = bucket + indexOffset();
+        return 2.0 * std::exp(index * logGamma()) / (1.0 + gamma());
+    }
+
+public:
+    QuantileSketch() :
+        zeroCount(0),
+        count(0) {
+        memset(&positive, 0, sizeof(positive));
+        memset(&negative, 0, sizeof(negative));
+        positive.reset();
+        negative.reset();
+    }
+
+    void reset() {
+        positive.reset();
+        negative.reset();
+        zeroCount = 0;
+        count = 0;
+    }
+
+    void add(double value) {
+        count++;
+        if (value >= MIN_VALUE) positive.add(bucketOf(value));
+        else if (value <= -MIN_VALUE) negative.add(bucketOf(-value));
+        else zeroCount++;  // Also catches NaN
+    }
+
+    // fraction in [0, 1]; returns 0 when empty
+    double quantile(double fraction) const {
+        if (count == 0) return 0.0;
+
+        const uint64_t rank = static_cast<uint64_t>(fraction * static_cast<double>(count - 1));
+        uint64_t seen = 0;
+        if (rank < negative.count) {
+            // Most negative first: the largest magnitudes
+            for (int i = negative.highest; i >= negative.lowest; i--) {
+                seen += negative.buckets[i];
+                if (seen > rank) return -bucketValue(i);
+            }
+        }
+        seen = negative.count + zeroCount;
+        if (rank < seen) return 0.0;
+
+        for (int i = positive.lowest; i <= positive.highest; i++) {
+            seen += positive.buckets[i];
+            if (seen > rank) return bucketValue(i);
+        }
+        return positive.highest >= 0 ? bucketValue(positive.highest) : 0.0;
+    }
+
+    uint64_t getCount() const { return count; }
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+#include "BehavioralEvent.h"
+
+struct WheelCoalescingOptions {
+    bool enabled = true;
+    int windowMs = 100;  // A burst ends once a message is this far from its first one
+};
+
+// Wheel coalescing stage between the decimator and addEvent().
+// Smooth-scrolling mice and touchpads send dozens of small MOUSE_WHEEL
+// messages per gesture. Consecutive wheel records in the same direction,
+// application and window are merged into the first one, with wheelDelta
+// summed (a burst also ends before the sum would overflow). Any other
+// record ends the burst first, so ordering is preserved, and
+// time_since_last of the next emitted record is re-based onto the merged
+// record. Runs on the single consumer thread.
+class WheelCoalescer {
+private:
+    WheelCoalescingOptions options;
+    BehavioralEvent burst;  // Merged record not emitted yet
+    bool hasBurst;
+    unsigned long long mergedGap;  // time_since_last of merged records not yet re-based
+
+    std::atomic<unsigned long long> mergedMessages;  // Wheel records folded into an earlier one
+    std::atomic<unsigned long long> emittedBursts;
+
+    static void increment(std::atomic<unsigned long long>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    bool extendsBurst(const BehavioralEvent& event) const {
+        if (!hasBurst || event.appId != burst.appId) return false;
+        if (event.timestamp - burst.timestamp >= options.windowMs) return false;
+        if ((event.wheelDelta < 0) != (burst.wheelDelta < 0)) return false;
+        const int sum = burst.wheelDelta + event.wheelDelta;
+        return std::abs(sum) <= (std::numeric_limits<int16_t>::max)();
+    }
+
+    // Adds the time of records merged since the previous emitted one
+    void rebase(BehavioralEvent& event) {
+        const unsigned long long gap = mergedGap + event.timeSinceLast;
+        event.timeSinceLast = gap > (std::numeric_limits<uint32_t>::max)()
+            ? (std::numeric_limits<uint32_t>::max)() : static_cast<uint32_t>(gap);
+        mergedGap = 0;
+    }
+
+    template <typename Emit>
+    void flushBurst(Emit& sink) {
+        if (!hasBurst) return;
+        hasBurst = false;
+        increment(emittedBursts);
+        sink(burst);
+    }
+
+public:
+    WheelCoalescer() :
+        hasBurst(false),
+        mergedGap(0),
+        mergedMessages(0),
+        emittedBursts(0) {}
+
+    // Caller must flush() first when switching while a burst is pending
+    void configure(const WheelCoalescingOptions& coalescingOptions) {
+        options = coalescingOptions;
+        if (options.windowMs < 1) options.windowMs = 1;
+    }
+
+    template <typename Emit>
+    void process(const BehavioralEvent& event, Emit&& sink) {
+        if (!options.enabled) {
+            sink(event);
+            return;
+        }
+        if (event.type != MOUSE_WHEEL) {
+            flushBurst(sink);
+            BehavioralEvent rebased = event;
+            rebase(rebased);
+            sink(rebased);
+            return;
+        }
+
+        if (extendsBurst(event)) {
+            burst.wheelDelta = static_cast<int16_t>(burst.wheelDelta + event.wheelDelta);
+            mergedGap += event.timeSinceLast;
+            increment(mergedMessages);
+            return;
+        }
+        flushBurst(sink);
+        burst = event;
+        rebase(burst);
+        hasBurst = true;
+    }
+
+    // Drainer idle pass: a burst whose window has passed cannot grow any more
+    template <typename Emit>
+    void flushIdle(long long nowMs, Emit&& sink) {
+        if (hasBurst && nowMs - burst.timestamp >= options.windowMs) {
+            flushBurst(sink);
+        }
+    }
+
+    template <typename Emit>
+    void flush(Emit&& sink) {
+        flushBurst(sink);
+    }
+
+    std::string describe() const {
+        if (!options.enabled) return "off";
+        return std::to_string(options.windowMs) + " ms bursts";
+    }
+
+    unsigned long long getMergedMessages() const {
+        return mergedMessages.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long getEmittedBursts() const {
+        return emittedBursts.load(std::memory_order_relaxed);
+    }
+};